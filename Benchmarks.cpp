@@ -0,0 +1,599 @@
+#include "Pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__has_include)
+#if __has_include(<memory_resource>) && __cplusplus >= 201703L
+#include <memory_resource>
+#define SMART_POOL_BENCHMARK_PMR 1
+#endif
+#endif
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Settings of a benchmark run, filled from command line
+///////////////////////////////////////////////////////////////////////////////////////
+struct BenchmarkSettings
+{
+	/// Passes that are run before measurement and thrown away
+	int mWarmupCount { 1 };
+	/// Measured passes, samples of every pass are merged
+	int mRepetitionCount { 5 };
+	/// Spawn/return pairs per churn pass
+	int mChurnOpCount { 200000 };
+	/// Live objects during churn
+	int mLiveCount { 4096 };
+	/// Records of iteration benchmark
+	int mIterationCapacity { 1 << 18 };
+	/// Passes over the container per iteration repetition
+	int mIterationPassCount { 20 };
+	/// Only benchmarks whose names contain this string are run
+	string mFilter;
+	/// Path of JSON report, none when empty
+	string mJsonPath;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Result of a single benchmark: distribution of time per operation
+///////////////////////////////////////////////////////////////////////////////////////
+struct BenchmarkResult
+{
+	string mName;
+	size_t mSampleCount { 0 };
+	double mMean { 0 };
+	double mP50 { 0 };
+	double mP99 { 0 };
+	double mP999 { 0 };
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Collects samples of time per operation and turns them into percentiles
+///////////////////////////////////////////////////////////////////////////////////////
+class SampleRecorder
+{
+public:
+	void Reserve(size_t count)
+	{
+		mSamples.reserve(count);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Records time of 'opCount' operations measured from 'start' to now
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Record(chrono::steady_clock::time_point start, size_t opCount)
+	{
+		const auto time = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+		mSamples.push_back(time / static_cast<double>(opCount));
+	}
+
+	BenchmarkResult Summarize(const string &name)
+	{
+		BenchmarkResult result;
+		result.mName = name;
+		result.mSampleCount = mSamples.size();
+		if (mSamples.empty())
+		{
+			return result;
+		}
+		sort(mSamples.begin(), mSamples.end());
+		double sum = 0;
+		for (double sample : mSamples)
+		{
+			sum += sample;
+		}
+		result.mMean = sum / mSamples.size();
+		result.mP50 = Percentile(0.5);
+		result.mP99 = Percentile(0.99);
+		result.mP999 = Percentile(0.999);
+		return result;
+	}
+private:
+	double Percentile(double fraction) const
+	{
+		const auto index = static_cast<size_t>(fraction * (mSamples.size() - 1) + 0.5);
+		return mSamples[index];
+	}
+
+	vector<double> mSamples;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Object of given size, touched on construction so allocation is not optimized away
+///////////////////////////////////////////////////////////////////////////////////////
+template<size_t Size>
+struct Object
+{
+	static_assert(Size >= sizeof(float) * 2, "Object must hold at least two floats");
+
+	float mValue;
+	float mVelocity;
+	char mPayload[Size - sizeof(float) * 2];
+
+	Object() : mValue(1.0f), mVelocity(0.5f)
+	{
+		mPayload[0] = 1;
+	}
+
+	void Update() noexcept
+	{
+		mValue += mVelocity;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Allocators under test. Each has Spawn and Return of Object<Size> and a Handle type.
+///////////////////////////////////////////////////////////////////////////////////////
+template<size_t Size>
+class PoolAllocatorUnderTest
+{
+public:
+	using Handle = PoolHandle<Object<Size>>;
+
+	static const char *GetName()
+	{
+		return "Pool";
+	}
+
+	explicit PoolAllocatorUnderTest(size_t capacity) : mPool(capacity) { }
+
+	Handle Spawn()
+	{
+		return mPool.Spawn();
+	}
+
+	void Return(const Handle &handle)
+	{
+		mPool.Return(handle);
+	}
+private:
+	Pool<Object<Size>> mPool;
+};
+
+template<size_t Size>
+class MallocAllocatorUnderTest
+{
+public:
+	using Handle = Object<Size> *;
+
+	static const char *GetName()
+	{
+		return "malloc";
+	}
+
+	explicit MallocAllocatorUnderTest(size_t) { }
+
+	Handle Spawn()
+	{
+		const auto memory = malloc(sizeof(Object<Size>));
+		if (!memory)
+		{
+			throw bad_alloc();
+		}
+		return new (memory) Object<Size>();
+	}
+
+	void Return(Handle object)
+	{
+		object->~Object<Size>();
+		free(object);
+	}
+};
+
+#if SMART_POOL_BENCHMARK_PMR
+template<size_t Size>
+class PmrAllocatorUnderTest
+{
+public:
+	using Handle = Object<Size> *;
+
+	static const char *GetName()
+	{
+		return "pmr::unsynchronized_pool_resource";
+	}
+
+	explicit PmrAllocatorUnderTest(size_t) { }
+
+	Handle Spawn()
+	{
+		return new (mResource.allocate(sizeof(Object<Size>), alignof(Object<Size>))) Object<Size>();
+	}
+
+	void Return(Handle object)
+	{
+		object->~Object<Size>();
+		mResource.deallocate(object, sizeof(Object<Size>), alignof(Object<Size>));
+	}
+private:
+	pmr::unsynchronized_pool_resource mResource;
+};
+
+template<size_t Size>
+class PoolResourceAllocatorUnderTest
+{
+public:
+	using Handle = Object<Size> *;
+
+	static const char *GetName()
+	{
+		return "PoolMemoryResource";
+	}
+
+	explicit PoolResourceAllocatorUnderTest(size_t) { }
+
+	Handle Spawn()
+	{
+		return new (mResource.allocate(sizeof(Object<Size>), alignof(Object<Size>))) Object<Size>();
+	}
+
+	void Return(Handle object)
+	{
+		object->~Object<Size>();
+		mResource.deallocate(object, sizeof(Object<Size>), alignof(Object<Size>));
+	}
+private:
+	PoolMemoryResource<> mResource;
+};
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Order in which live objects are returned and replaced
+///////////////////////////////////////////////////////////////////////////////////////
+enum class ChurnPattern
+{
+	/// The most recently spawned object is returned first
+	Lifo,
+	/// The oldest object is returned first
+	Fifo,
+	/// Random live object is returned
+	Random,
+	/// Bursts of random objects are returned, then the same count is spawned
+	Bursty
+};
+
+const char *GetPatternName(ChurnPattern pattern)
+{
+	switch (pattern)
+	{
+	case ChurnPattern::Lifo:
+		return "lifo";
+	case ChurnPattern::Fifo:
+		return "fifo";
+	case ChurnPattern::Random:
+		return "random";
+	case ChurnPattern::Bursty:
+		return "bursty";
+	}
+	return "unknown";
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Simple deterministic generator, so every run and every allocator gets the same
+/// sequence
+///////////////////////////////////////////////////////////////////////////////////////
+class XorShift
+{
+public:
+	uint32_t Next() noexcept
+	{
+		mState ^= mState << 13;
+		mState ^= mState >> 17;
+		mState ^= mState << 5;
+		return mState;
+	}
+private:
+	uint32_t mState { 2463534242u };
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Builds sequence of slots of live set to replace for 'pattern'. Sequence is built
+/// up front, so generator is not measured.
+///////////////////////////////////////////////////////////////////////////////////////
+vector<uint32_t> MakeChurnSequence(ChurnPattern pattern, int opCount, int liveCount)
+{
+	vector<uint32_t> sequence(opCount);
+	XorShift random;
+	for (int i = 0; i < opCount; ++i)
+	{
+		switch (pattern)
+		{
+		case ChurnPattern::Lifo:
+			sequence[i] = liveCount - 1;
+			break;
+		case ChurnPattern::Fifo:
+			sequence[i] = i % liveCount;
+			break;
+		case ChurnPattern::Random:
+		case ChurnPattern::Bursty:
+			sequence[i] = random.Next() % liveCount;
+			break;
+		}
+	}
+	return sequence;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Keeps 'liveCount' objects alive and replaces them in order of 'pattern'. One sample
+/// is a batch of spawn/return pairs, in bursty pattern it is a whole burst.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename Allocator>
+BenchmarkResult RunChurn(const string &name, ChurnPattern pattern, const BenchmarkSettings &settings)
+{
+	constexpr int batchSize = 32;
+	constexpr int burstSize = 512;
+	const auto sequence = MakeChurnSequence(pattern, settings.mChurnOpCount, settings.mLiveCount);
+	const int sampleOpCount = pattern == ChurnPattern::Bursty ? burstSize : batchSize;
+
+	SampleRecorder recorder;
+	recorder.Reserve(settings.mRepetitionCount * (settings.mChurnOpCount / sampleOpCount + 1));
+	for (int pass = 0; pass < settings.mWarmupCount + settings.mRepetitionCount; ++pass)
+	{
+		const bool measured = pass >= settings.mWarmupCount;
+		Allocator allocator(settings.mLiveCount);
+		vector<typename Allocator::Handle> handles;
+		handles.reserve(settings.mLiveCount);
+		for (int i = 0; i < settings.mLiveCount; ++i)
+		{
+			handles.push_back(allocator.Spawn());
+		}
+		for (int first = 0; first + sampleOpCount <= settings.mChurnOpCount; first += sampleOpCount)
+		{
+			const auto start = chrono::steady_clock::now();
+			if (pattern == ChurnPattern::Bursty)
+			{
+				// Burst may hit same slot twice, so freed slots are marked by position
+				for (int i = first; i < first + sampleOpCount; ++i)
+				{
+					auto &handle = handles[sequence[i]];
+					if (handle != typename Allocator::Handle())
+					{
+						allocator.Return(handle);
+						handle = typename Allocator::Handle();
+					}
+				}
+				for (int i = first; i < first + sampleOpCount; ++i)
+				{
+					auto &handle = handles[sequence[i]];
+					if (handle == typename Allocator::Handle())
+					{
+						handle = allocator.Spawn();
+					}
+				}
+			}
+			else
+			{
+				for (int i = first; i < first + sampleOpCount; ++i)
+				{
+					auto &handle = handles[sequence[i]];
+					allocator.Return(handle);
+					handle = allocator.Spawn();
+				}
+			}
+			if (measured)
+			{
+				recorder.Record(start, sampleOpCount);
+			}
+		}
+		for (const auto &handle : handles)
+		{
+			allocator.Return(handle);
+		}
+	}
+	return recorder.Summarize(name);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Runs every churn pattern of objects of 'Size' bytes for every allocator
+///////////////////////////////////////////////////////////////////////////////////////
+template<size_t Size, typename Report>
+void RunChurnBenchmarks(const BenchmarkSettings &settings, Report &&report)
+{
+	for (auto pattern : { ChurnPattern::Lifo, ChurnPattern::Fifo, ChurnPattern::Random, ChurnPattern::Bursty })
+	{
+		const auto prefix = string("churn/") + GetPatternName(pattern) + "/" + to_string(Size) + "B/";
+		report(prefix + PoolAllocatorUnderTest<Size>::GetName(), [&](const string &name)
+		{
+			return RunChurn<PoolAllocatorUnderTest<Size>>(name, pattern, settings);
+		});
+		report(prefix + MallocAllocatorUnderTest<Size>::GetName(), [&](const string &name)
+		{
+			return RunChurn<MallocAllocatorUnderTest<Size>>(name, pattern, settings);
+		});
+#if SMART_POOL_BENCHMARK_PMR
+		report(prefix + PmrAllocatorUnderTest<Size>::GetName(), [&](const string &name)
+		{
+			return RunChurn<PmrAllocatorUnderTest<Size>>(name, pattern, settings);
+		});
+		report(prefix + PoolResourceAllocatorUnderTest<Size>::GetName(), [&](const string &name)
+		{
+			return RunChurn<PoolResourceAllocatorUnderTest<Size>>(name, pattern, settings);
+		});
+#endif
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Measures 'pass' over container, one sample is one pass, time is per live object
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename Pass>
+BenchmarkResult RunIteration(const string &name, size_t liveCount, const BenchmarkSettings &settings, Pass &&pass)
+{
+	SampleRecorder recorder;
+	for (int i = 0; i < settings.mWarmupCount; ++i)
+	{
+		pass();
+	}
+	for (int i = 0; i < settings.mRepetitionCount * settings.mIterationPassCount; ++i)
+	{
+		const auto start = chrono::steady_clock::now();
+		pass();
+		recorder.Record(start, liveCount);
+	}
+	return recorder.Summarize(name);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Update of every live object at different occupancy levels: Pool, DensePool and
+/// std::vector holding live objects only
+///////////////////////////////////////////////////////////////////////////////////////
+template<size_t Size, typename Report>
+void RunIterationBenchmarks(const BenchmarkSettings &settings, Report &&report)
+{
+	const int capacity = settings.mIterationCapacity;
+	for (int occupancy : { 100, 50, 10, 1 })
+	{
+		const auto prefix = "iteration/" + to_string(occupancy) + "%/" + to_string(Size) + "B/";
+		const int stride = 100 / occupancy;
+
+		Pool<Object<Size>> pool(capacity);
+		DensePool<Object<Size>> densePool(capacity);
+		vector<PoolHandle<Object<Size>>> handles;
+		vector<PoolHandle<Object<Size>>> denseHandles;
+		for (int i = 0; i < capacity; ++i)
+		{
+			handles.push_back(pool.Spawn());
+			denseHandles.push_back(densePool.Spawn());
+		}
+		for (int i = 0; i < capacity; ++i)
+		{
+			if (i % stride != 0)
+			{
+				pool.Return(handles[i]);
+				densePool.Return(denseHandles[i]);
+			}
+		}
+		vector<Object<Size>> objects(pool.GetSpawnedCount());
+		const auto liveCount = pool.GetSpawnedCount();
+
+		report(prefix + "Pool::ForEach", [&](const string &name)
+		{
+			return RunIteration(name, liveCount, settings, [&]
+			{
+				pool.ForEach([](Object<Size> &object) { object.Update(); });
+			});
+		});
+		report(prefix + "DensePool", [&](const string &name)
+		{
+			return RunIteration(name, liveCount, settings, [&]
+			{
+				for (auto &object : densePool)
+				{
+					object.Update();
+				}
+			});
+		});
+		report(prefix + "vector", [&](const string &name)
+		{
+			return RunIteration(name, liveCount, settings, [&]
+			{
+				for (auto &object : objects)
+				{
+					object.Update();
+				}
+			});
+		});
+	}
+}
+
+void WriteJson(const string &path, const vector<BenchmarkResult> &results, const BenchmarkSettings &settings)
+{
+	ofstream file(path);
+	file << "{\n  \"settings\": {\"warmup\": " << settings.mWarmupCount
+		<< ", \"repetitions\": " << settings.mRepetitionCount
+		<< ", \"churnOps\": " << settings.mChurnOpCount
+		<< ", \"liveCount\": " << settings.mLiveCount
+		<< ", \"iterationCapacity\": " << settings.mIterationCapacity << "},\n";
+	file << "  \"unit\": \"ns/op\",\n  \"benchmarks\": [\n";
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const auto &result = results[i];
+		file << "    {\"name\": \"" << result.mName << "\", \"samples\": " << result.mSampleCount
+			<< ", \"mean\": " << result.mMean << ", \"p50\": " << result.mP50
+			<< ", \"p99\": " << result.mP99 << ", \"p999\": " << result.mP999 << "}"
+			<< (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	file << "  ]\n}\n";
+}
+
+void PrintUsage()
+{
+	cout << "Usage: Benchmarks [--filter <text>] [--json <path>] [--repetitions <n>] "
+		"[--warmup <n>] [--quick]" << endl;
+}
+
+int main(int argc, char **argv)
+{
+	BenchmarkSettings settings;
+	for (int i = 1; i < argc; ++i)
+	{
+		const string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (arg == "--filter" && hasValue)
+		{
+			settings.mFilter = argv[++i];
+		}
+		else if (arg == "--json" && hasValue)
+		{
+			settings.mJsonPath = argv[++i];
+		}
+		else if (arg == "--repetitions" && hasValue)
+		{
+			settings.mRepetitionCount = max(1, atoi(argv[++i]));
+		}
+		else if (arg == "--warmup" && hasValue)
+		{
+			settings.mWarmupCount = max(0, atoi(argv[++i]));
+		}
+		else if (arg == "--quick")
+		{
+			// Smoke run: every benchmark once with tiny sizes
+			settings.mWarmupCount = 0;
+			settings.mRepetitionCount = 1;
+			settings.mChurnOpCount = 4096;
+			settings.mLiveCount = 256;
+			settings.mIterationCapacity = 4096;
+			settings.mIterationPassCount = 2;
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	vector<BenchmarkResult> results;
+	cout << left << setw(64) << "Benchmark" << right << setw(12) << "mean" << setw(12) << "p50"
+		<< setw(12) << "p99" << setw(12) << "p999" << "  (ns/op)" << endl;
+	auto report = [&](const string &name, auto run)
+	{
+		if (!settings.mFilter.empty() && name.find(settings.mFilter) == string::npos)
+		{
+			return;
+		}
+		const auto result = run(name);
+		cout << left << setw(64) << result.mName << right << fixed << setprecision(2)
+			<< setw(12) << result.mMean << setw(12) << result.mP50
+			<< setw(12) << result.mP99 << setw(12) << result.mP999 << endl;
+		results.push_back(result);
+	};
+
+	RunChurnBenchmarks<16>(settings, report);
+	RunChurnBenchmarks<64>(settings, report);
+	RunChurnBenchmarks<256>(settings, report);
+	RunIterationBenchmarks<16>(settings, report);
+	RunIterationBenchmarks<64>(settings, report);
+	RunIterationBenchmarks<256>(settings, report);
+
+	if (!settings.mJsonPath.empty())
+	{
+		WriteJson(settings.mJsonPath, results, settings);
+	}
+	return 0;
+}
@@ -0,0 +1,186 @@
+/*
+Hardware performance counters for tests and benchmarks of SmartPool.
+
+Counters are read through perf_event_open on Linux. When the kernel refuses
+to open a counter (no PMU in virtual machine, perf_event_paranoid too high,
+other OS), that counter is reported as unavailable and everything else works
+as before.
+*/
+
+#ifndef SMART_POOL_PERF_COUNTERS_H
+#define SMART_POOL_PERF_COUNTERS_H
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Set of hardware counters for a measured scenario. Counters accumulate between
+/// Start and Stop calls, so scenario may be measured in several pieces.
+///////////////////////////////////////////////////////////////////////////////////////
+class PerfCounters final
+{
+public:
+	enum Counter
+	{
+		Instructions,
+		Cycles,
+		L1DataMisses,
+		LastLevelMisses,
+		DataTlbMisses,
+		BranchMisses,
+		CounterCount
+	};
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// @param enabled - when false, no counter is opened and Print does nothing
+	///////////////////////////////////////////////////////////////////////////////////////
+	explicit PerfCounters(bool enabled) : mEnabled(enabled)
+	{
+		for (auto &file : mFiles)
+		{
+			file = -1;
+		}
+#if defined(__linux__)
+		if (!mEnabled)
+		{
+			return;
+		}
+		const uint64_t read = PERF_COUNT_HW_CACHE_OP_READ << 8;
+		const uint64_t miss = PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+		Open(Instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+		Open(Cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+		Open(L1DataMisses, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | read | miss);
+		Open(LastLevelMisses, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | read | miss);
+		Open(DataTlbMisses, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | read | miss);
+		Open(BranchMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+	}
+
+	PerfCounters(const PerfCounters&) = delete;
+	PerfCounters& operator=(const PerfCounters&) = delete;
+
+	~PerfCounters()
+	{
+#if defined(__linux__)
+		for (int file : mFiles)
+		{
+			if (file >= 0)
+			{
+				close(file);
+			}
+		}
+#endif
+	}
+
+	void Start() noexcept
+	{
+		Control(true);
+	}
+
+	void Stop() noexcept
+	{
+		Control(false);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns true if 'counter' was opened
+	///////////////////////////////////////////////////////////////////////////////////////
+	bool IsAvailable(Counter counter) const noexcept
+	{
+		return mFiles[counter] >= 0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns accumulated value of 'counter', zero if counter is unavailable
+	///////////////////////////////////////////////////////////////////////////////////////
+	uint64_t Read(Counter counter) const noexcept
+	{
+		uint64_t value = 0;
+#if defined(__linux__)
+		if (mFiles[counter] >= 0 && read(mFiles[counter], &value, sizeof(value)) != sizeof(value))
+		{
+			value = 0;
+		}
+#endif
+		return value;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Prints every counter of scenario 'label' in a single line, unavailable counters
+	/// are printed as n/a. Prints nothing when counters were not enabled.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Print(std::ostream &stream, const char *label) const
+	{
+		if (!mEnabled)
+		{
+			return;
+		}
+		static const char *const names[CounterCount] =
+		{
+			"instructions", "cycles", "L1D misses", "LLC misses", "dTLB misses", "branch misses"
+		};
+		stream << "  " << label << " perf:";
+		for (int i = 0; i < CounterCount; ++i)
+		{
+			stream << (i == 0 ? " " : ", ") << names[i] << ": ";
+			if (IsAvailable(static_cast<Counter>(i)))
+			{
+				stream << Read(static_cast<Counter>(i));
+			}
+			else
+			{
+				stream << "n/a";
+			}
+		}
+		const auto cycles = Read(Cycles);
+		if (IsAvailable(Instructions) && cycles != 0)
+		{
+			stream << ", IPC: " << static_cast<double>(Read(Instructions)) / cycles;
+		}
+		stream << std::endl;
+	}
+private:
+#if defined(__linux__)
+	void Open(Counter counter, uint32_t type, uint64_t config) noexcept
+	{
+		perf_event_attr attributes;
+		memset(&attributes, 0, sizeof(attributes));
+		attributes.type = type;
+		attributes.size = sizeof(attributes);
+		attributes.config = config;
+		attributes.disabled = 1;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		// Calling thread on any CPU
+		mFiles[counter] = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+	}
+#endif
+
+	void Control(bool enable) noexcept
+	{
+#if defined(__linux__)
+		for (int file : mFiles)
+		{
+			if (file >= 0)
+			{
+				ioctl(file, enable ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, 0);
+			}
+		}
+#else
+		(void)enable;
+#endif
+	}
+
+	bool mEnabled;
+	int mFiles[CounterCount];
+};
+
+#endif
@@ -37,7 +37,8 @@ before. This additional info called "stamp". When you asks pool for a new
 object, pool marks it with unique "stamp" and gives you handle with index of a
 new object and "stamp" of an object. Now if you want to ensure, that handle
 "points" to same object as before, you just compare "stamps" - if they are same,
-then handle is correct.
+then handle is correct. Stamp is a generation of the record, which is incremented
+on every Spawn and Return of the record.
 
 Pool implementation is object-agnostic, so you can store any suitable object in
 it. It also may contain non-POD objects.
@@ -46,21 +47,24 @@ it. It also may contain non-POD objects.
 How it works:
 Firstly, pool allocates memory block with initial size = initialCapacity *
 recordSize, fills it with special marks, which indicates that memory piece is
-unused. Also pool creates list of indices of free memory blocks.
+unused. Records that were never used are handed out in order of their indices,
+so there is no need to register them anywhere.
 
 When user calls Spawn method, pool pops index of free memory block, constructs
 object in it using placement new, makes new stamp and returns handle to the
 user.
 
 When user calls Return methos, pool returns index of the object to "free list",
-marks object as free and calls destructor of the object.
+marks object as free and calls destructor of the object. Free list is intrusive:
+memory of destructed object holds index of next free record, so neither Spawn
+nor Return ever allocate memory.
 
 =============
 Notes:
 Your object should have constructor without arguments.
 Create pool with large enough capacity, because any Spawn method called on full
 pool will result in memory reallocation and memory movement, which is quite
-expensive operation
+expensive operation. Use SegmentedPoolTraits if objects must never be moved.
 
 =============
 Q&A:
@@ -95,381 +99,6577 @@ pool.Return(baz);
 #ifndef SMART_POOL_H
 #define SMART_POOL_H
 
+#include <atomic>
+#include <chrono>
 #include <cassert>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <iterator>
+#include <mutex>
 #include <new>
 #include <string.h>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <utility>
-#include <queue>
+#include <vector>
 
-// Use large enough in types to hold stamps and indices
-// uint64_t will overflows in about 370 years if you will increase it by 3 400 000 000 (3.4 GHz)
-// every second. In normal cases there is eternity needed to overflow uint64_t
+#if defined(__has_include)
+#if __has_include(<memory_resource>) && (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+#include <memory_resource>
+#define SMART_POOL_HAS_PMR 1
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <malloc.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// Index of a record inside of a pool
 using PoolIndex = uint64_t;
-using PoolStamp = uint64_t;
 
-enum EPoolStamp
-{
-	PoolStamp_NotConstructed,
-	PoolStamp_Free,
-	PoolStamp_Origin
+/// Marks end of free records list
+constexpr PoolIndex InvalidPoolIndex = ~PoolIndex(0);
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Smallest unsigned integer type that holds 'Bits' bits
+///////////////////////////////////////////////////////////////////////////////////////
+template<unsigned Bits>
+using PoolUInt = typename std::conditional<Bits <= 8, uint8_t,
+	typename std::conditional<Bits <= 16, uint16_t,
+	typename std::conditional<Bits <= 32, uint32_t, uint64_t>::type>::type>::type;
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Hints CPU to load cache line at 'address' ahead of use. Does nothing on compilers
+/// without prefetch intrinsic.
+///////////////////////////////////////////////////////////////////////////////////////
+inline void PoolPrefetch(const void *address) noexcept
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	_mm_prefetch(static_cast<const char *>(address), _MM_HINT_T0);
+#elif defined(__GNUC__) || defined(__clang__)
+	__builtin_prefetch(address);
+#else
+	(void)address;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// True when object of type 'T' may be moved to other address by copying its bytes and
+/// forgetting the source without calling its destructor. Pools then relocate objects 
+/// in bulk with memcpy (or realloc) instead of move constructor and destructor per 
+/// object. Holds for trivially copyable types; specialize it for types that are 
+/// trivially relocatable, but not trivially copyable, e.g. owners of heap memory 
+/// without pointers into themselves:
+///   template<> struct PoolTriviallyRelocatable<Mesh> : std::true_type { };
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename T>
+struct PoolTriviallyRelocatable : std::is_trivially_copyable<T>
+{
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Moves 'count' live objects from 'from' to uninitialized memory 'to' and ends their
+/// lifetime at 'from'. Ranges must not overlap.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename T>
+void PoolRelocate(T *to, T *from, size_t count, std::true_type) noexcept
+{
+	if (count != 0)
+	{
+		memcpy(static_cast<void *>(to), static_cast<const void *>(from), sizeof(T) * count);
+	}
+}
+
+template<typename T>
+void PoolRelocate(T *to, T *from, size_t count, std::false_type) noexcept
+{
+	static_assert(std::is_nothrow_move_constructible<T>::value,
+		"Objects must be nothrow move constructible or trivially relocatable");
+	for (size_t i = 0; i < count; ++i)
+	{
+		new (to + i) T(std::move(from[i]));
+		from[i].~T();
+	}
+}
+
+template<typename T>
+void PoolRelocate(T *to, T *from, size_t count) noexcept
+{
+	PoolRelocate(to, from, count, std::integral_constant<bool, PoolTriviallyRelocatable<T>::value>());
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// True when 'Allocator' has its own Reallocate
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename Allocator, typename = void>
+struct PoolHasReallocate : std::false_type
+{
+};
+
+template<typename Allocator>
+struct PoolHasReallocate<Allocator, decltype(void(std::declval<Allocator &>().Reallocate(
+	static_cast<void *>(nullptr), size_t(0), size_t(0), size_t(0))))> : std::true_type
+{
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Resizes block of 'oldBytes' bytes from 'allocator' to 'bytes' bytes, first bytes of
+/// the block are kept. 'ptr' may be null. Uses Reallocate of allocator when it has
+/// one, otherwise allocates new block, copies bytes and frees the old one.
+///
+/// Throws std::bad_alloc when unable to allocate memory, old block is kept then.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename Allocator>
+void *PoolReallocate(Allocator &allocator, void *ptr, size_t oldBytes, size_t bytes,
+	size_t alignment, std::true_type)
+{
+	return allocator.Reallocate(ptr, oldBytes, bytes, alignment);
+}
+
+template<typename Allocator>
+void *PoolReallocate(Allocator &allocator, void *ptr, size_t oldBytes, size_t bytes,
+	size_t alignment, std::false_type)
+{
+	const auto block = allocator.Allocate(bytes, alignment);
+	if (ptr)
+	{
+		memcpy(block, ptr, oldBytes < bytes ? oldBytes : bytes);
+		allocator.Deallocate(ptr, oldBytes, alignment);
+	}
+	return block;
+}
+
+template<typename Allocator>
+void *PoolReallocate(Allocator &allocator, void *ptr, size_t oldBytes, size_t bytes, size_t alignment)
+{
+	return PoolReallocate(allocator, ptr, oldBytes, bytes, alignment, PoolHasReallocate<Allocator>());
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Allocator of pool memory that calls malloc and free directly, aligned allocation
+/// functions for over-aligned blocks. Has no state, so calls are resolved at compile
+/// time and the pool carries nothing.
+///
+/// Every allocator of pool memory provides:
+///   void *Allocate(size_t bytes, size_t alignment) - returns block of 'bytes' bytes
+///     aligned to 'alignment', which is a power of two. Throws std::bad_alloc on
+///     failure.
+///   void Deallocate(void *ptr, size_t bytes, size_t alignment) - frees block returned
+///     by Allocate with the same 'bytes' and 'alignment'.
+/// and may provide Reallocate, see PoolReallocate. Pool keeps a copy of allocator in
+/// every part that owns memory, so stateful allocator should be a cheap handle to its
+/// state, such as PoolAllocatorRef.
+///////////////////////////////////////////////////////////////////////////////////////
+struct PoolHeapAllocator
+{
+	static void *Allocate(size_t bytes, size_t alignment)
+	{
+		assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+		void *memory;
+		if (alignment <= alignof(std::max_align_t))
+		{
+			memory = malloc(bytes);
+		}
+		else
+		{
+#if defined(_WIN32)
+			memory = _aligned_malloc(bytes, alignment);
+#else
+			if (posix_memalign(&memory, alignment, bytes) != 0)
+			{
+				memory = nullptr;
+			}
+#endif
+		}
+		if (!memory)
+		{
+			throw std::bad_alloc();
+		}
+		return memory;
+	}
+
+	static void Deallocate(void *ptr, size_t, size_t alignment) noexcept
+	{
+#if defined(_WIN32)
+		if (alignment > alignof(std::max_align_t))
+		{
+			_aligned_free(ptr);
+			return;
+		}
+#else
+		(void)alignment;
+#endif
+		free(ptr);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Blocks with fundamental alignment are resized by realloc, which may extend them in
+	/// place or move pages without copying.
+	///////////////////////////////////////////////////////////////////////////////////////
+	static void *Reallocate(void *ptr, size_t oldBytes, size_t bytes, size_t alignment)
+	{
+		if (alignment > alignof(std::max_align_t))
+		{
+			PoolHeapAllocator allocator;
+			return PoolReallocate(allocator, ptr, oldBytes, bytes, alignment, std::false_type());
+		}
+		const auto memory = realloc(ptr, bytes);
+		if (!memory)
+		{
+			throw std::bad_alloc();
+		}
+		return memory;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Allocator of pool memory that calls a pair of malloc-like functions, default one.
+/// Over-aligned block is cut from a larger one, pointer to the whole block is kept
+/// right before the returned block. When functions are malloc and free, blocks with
+/// fundamental alignment are resized by realloc.
+///////////////////////////////////////////////////////////////////////////////////////
+class PoolFunctionAllocator
+{
+public:
+	typedef void* (*MemoryAllocFunc)(size_t size);
+	typedef void (*MemoryFreeFunc)(void* ptr);
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// @param memoryAlloc Memory allocation function. malloc by default
+	/// @param memoryFree Memory deallocation function. free by default
+	///////////////////////////////////////////////////////////////////////////////////////
+	PoolFunctionAllocator(MemoryAllocFunc memoryAlloc = malloc, MemoryFreeFunc memoryFree = free) noexcept
+		: MemoryAlloc(memoryAlloc)
+		, MemoryFree(memoryFree)
+	{
+	}
+
+	void *Allocate(size_t bytes, size_t alignment)
+	{
+		assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+		const bool overAligned = alignment > alignof(std::max_align_t);
+		if (overAligned && bytes > ~size_t(0) - alignment)
+		{
+			throw std::bad_alloc();
+		}
+		const auto memory = MemoryAlloc(overAligned ? bytes + alignment : bytes);
+		if (!memory)
+		{
+			throw std::bad_alloc();
+		}
+		if (!overAligned)
+		{
+			return memory;
+		}
+		const auto block = reinterpret_cast<void **>(
+			(reinterpret_cast<uintptr_t>(memory) + alignment) & ~(alignment - 1));
+		block[-1] = memory;
+		return block;
+	}
+
+	void Deallocate(void *ptr, size_t, size_t alignment) noexcept
+	{
+		MemoryFree(alignment > alignof(std::max_align_t) ? reinterpret_cast<void **>(ptr)[-1] : ptr);
+	}
+
+	void *Reallocate(void *ptr, size_t oldBytes, size_t bytes, size_t alignment)
+	{
+		if (MemoryAlloc != &malloc || MemoryFree != &free || alignment > alignof(std::max_align_t))
+		{
+			return PoolReallocate(*this, ptr, oldBytes, bytes, alignment, std::false_type());
+		}
+		const auto memory = realloc(ptr, bytes);
+		if (!memory)
+		{
+			throw std::bad_alloc();
+		}
+		return memory;
+	}
+private:
+	MemoryAllocFunc MemoryAlloc;
+	MemoryFreeFunc MemoryFree;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Allocator of pool memory that refers to 'Source' object with Allocate and
+/// Deallocate, such as PoolMemoryArena or allocator of a NUMA node. Source must
+/// outlive every pool that uses it.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename Source>
+class PoolAllocatorRef
+{
+public:
+	PoolAllocatorRef(Source &source) noexcept : mSource(&source)
+	{
+	}
+
+	void *Allocate(size_t bytes, size_t alignment)
+	{
+		return mSource->Allocate(bytes, alignment);
+	}
+
+	void Deallocate(void *ptr, size_t bytes, size_t alignment) noexcept
+	{
+		mSource->Deallocate(ptr, bytes, alignment);
+	}
+
+	Source &GetSource() const noexcept
+	{
+		return *mSource;
+	}
+private:
+	Source *mSource;
+};
+
+template<bool... Values>
+struct PoolBoolPack;
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// True when every value in pack is true
+///////////////////////////////////////////////////////////////////////////////////////
+template<bool... Values>
+struct PoolAllOf : std::is_same<PoolBoolPack<true, Values...>, PoolBoolPack<Values..., true>>
+{
+};
+
+struct PoolTraits;
+
+template<typename T, typename Traits = PoolTraits>
+class Pool;
+
+template<typename T, typename StampType, typename LinkType, typename Allocator>
+class ContiguousPoolStorage;
+
+template<typename T, typename StampType, typename LinkType, typename Allocator, size_t ChunkSize>
+class SegmentedPoolStorage;
+
+template<typename T, typename StampType, typename LinkType, typename Allocator, size_t Alignment>
+class SplitPoolStorage;
+
+template<typename T, typename StampType, typename LinkType, typename Allocator, size_t MaxRecords, 
+	bool HugePages>
+class VirtualPoolStorage;
+
+template<typename T, size_t ChunkSize, typename Allocator>
+class ConcurrentPool;
+
+template<typename T, size_t ChunkSize, typename Allocator>
+class ConcurrentPoolCache;
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Growth policy that multiplies capacity by Numerator / Denominator, golden ratio by
+/// default. Every growth policy provides GetNextCapacity, which returns capacity to 
+/// grow to from 'capacity', and CapacityLimit, the largest capacity pool may reach.
+///////////////////////////////////////////////////////////////////////////////////////
+template<size_t Numerator = 1618, size_t Denominator = 1000>
+struct GeometricPoolGrowth
+{
+	static_assert(Denominator > 0 && Numerator > Denominator, "Grow factor must be greater than 1");
+
+	static constexpr size_t CapacityLimit = SIZE_MAX;
+
+	static size_t GetNextCapacity(size_t capacity) noexcept
+	{
+		// Rounded up, split to not overflow on large capacities
+		const size_t next = capacity / Denominator * Numerator 
+			+ (capacity % Denominator * Numerator + Denominator - 1) / Denominator;
+		return next > capacity ? next : capacity + 1;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Growth policy that adds 'Increment' records on every growth
+///////////////////////////////////////////////////////////////////////////////////////
+template<size_t Increment>
+struct FixedPoolGrowth
+{
+	static_assert(Increment > 0, "Increment must be positive");
+
+	static constexpr size_t CapacityLimit = SIZE_MAX;
+
+	static size_t GetNextCapacity(size_t capacity) noexcept
+	{
+		return capacity + Increment;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Growth policy that grows capacity to the next power of two
+///////////////////////////////////////////////////////////////////////////////////////
+struct PowerOfTwoPoolGrowth
+{
+	static constexpr size_t CapacityLimit = SIZE_MAX;
+
+	static size_t GetNextCapacity(size_t capacity) noexcept
+	{
+		size_t next = 1;
+		while (next <= capacity && next != 0)
+		{
+			next <<= 1;
+		}
+		return next != 0 ? next : SIZE_MAX;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Growth policy that grows as 'Base' policy up to 'Cap' records. When pool holds 
+/// 'Cap' records and all of them are busy, Spawn throws std::bad_alloc right away.
+///////////////////////////////////////////////////////////////////////////////////////
+template<size_t Cap, typename Base = GeometricPoolGrowth<>>
+struct CappedPoolGrowth
+{
+	static_assert(Cap > 0, "Cap must be positive");
+
+	static constexpr size_t CapacityLimit = Cap < Base::CapacityLimit ? Cap : Base::CapacityLimit;
+
+	static size_t GetNextCapacity(size_t capacity) noexcept
+	{
+		const size_t next = Base::GetNextCapacity(capacity);
+		return next < CapacityLimit ? next : CapacityLimit;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Order in which returned records are reused. Records that were never used are 
+/// handed out before returned ones, except for LowestIndex.
+///////////////////////////////////////////////////////////////////////////////////////
+enum class PoolReuse
+{
+	/// The oldest returned record first
+	Fifo,
+	/// The most recently returned record first, its memory is likely still in cache
+	Lifo,
+	/// Record with the lowest index first, keeps live objects packed at the front of
+	/// storage. Returned records are tracked by a bitmap instead of a list.
+	LowestIndex
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Default pool configuration. To change pool behaviour, derive from this struct and
+/// override required members, then pass your struct as second template argument of
+/// Pool.
+///////////////////////////////////////////////////////////////////////////////////////
+struct PoolTraits
+{
+	/// Storage of records. Contiguous storage keeps every record in a single memory
+	/// block, which is relocated on growth.
+	template<typename T, typename StampType, typename LinkType, typename Allocator>
+	using Storage = ContiguousPoolStorage<T, StampType, LinkType, Allocator>;
+
+	/// Allocator of pool memory, see PoolHeapAllocator. Pool is constructed with its 
+	/// copy, default one calls malloc and free or functions given to the constructor.
+	using Allocator = PoolFunctionAllocator;
+
+	/// Growth policy: GeometricPoolGrowth, FixedPoolGrowth, PowerOfTwoPoolGrowth or
+	/// CappedPoolGrowth. Storage may round capacity up (whole chunks or pages).
+	using Growth = GeometricPoolGrowth<>;
+
+	/// Order in which Pool reuses returned records
+	static constexpr PoolReuse Reuse = PoolReuse::Fifo;
+
+	/// Defer destruction and reuse of returned objects until no reader thread can see
+	/// them, see PoolEpochs. Needs storage with lock-free reads (VirtualPoolTraits).
+	static constexpr bool DeferredReturn = false;
+
+	/// Count of handle bits used for index of a record. Pool can hold up to
+	/// 2^IndexBits - 1 records.
+	static constexpr unsigned IndexBits = 32;
+
+	/// Count of handle bits used for stamp (generation) of a record. Every record can
+	/// be reused about 2^(StampBits - 1) times, then it is retired. IndexBits plus
+	/// StampBits must fit into 64 bits, handle is 4 bytes when they fit into 32 bits.
+	static constexpr unsigned StampBits = 32;
+
+	/// Collect PoolStats: counts of spawns, returns, growths and validations. When off,
+	/// counting code is not compiled in and pool has no extra members.
+	static constexpr bool CollectStats = false;
+
+	/// Count of handles that Resolve and ForEachHandle prefetch records ahead for. 
+	/// Zero disables prefetching.
+	static constexpr size_t PrefetchDistance = 32;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Pool configuration that keeps records in fixed-size chunks, which are never moved
+/// in memory. ChunkSize is count of records per chunk and must be power of two.
+///////////////////////////////////////////////////////////////////////////////////////
+template<size_t ChunkSize = 4096>
+struct SegmentedPoolTraits : PoolTraits
+{
+	template<typename T, typename StampType, typename LinkType, typename Allocator>
+	using Storage = SegmentedPoolStorage<T, StampType, LinkType, Allocator, ChunkSize>;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Pool configuration that keeps stamps in a dense array apart from objects, objects
+/// are aligned to 'Alignment' bytes (natural alignment when zero).
+///////////////////////////////////////////////////////////////////////////////////////
+template<size_t Alignment = 0>
+struct SplitPoolTraits : PoolTraits
+{
+	template<typename T, typename StampType, typename LinkType, typename Allocator>
+	using Storage = SplitPoolStorage<T, StampType, LinkType, Allocator, Alignment>;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Pool configuration that reserves address space for 'MaxRecords' records up front
+/// and commits memory on growth. Objects never move and growth copies nothing.
+/// 'HugePages' asks for transparent huge pages.
+///////////////////////////////////////////////////////////////////////////////////////
+template<size_t MaxRecords = (size_t(1) << 24), bool HugePages = false>
+struct VirtualPoolTraits : PoolTraits
+{
+	template<typename T, typename StampType, typename LinkType, typename Allocator>
+	using Storage = VirtualPoolStorage<T, StampType, LinkType, Allocator, MaxRecords, HugePages>;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Handle of an object in the pool: index of a record and stamp the record had when
+/// object was spawned. Both are packed into a single integer of IndexBits + StampBits
+/// bits, so handle with default 32/32 split is 8 bytes and 24/8 split is 4 bytes.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename T, unsigned IndexBits = PoolTraits::IndexBits, 
+	unsigned StampBits = PoolTraits::StampBits>
+class PoolHandle final
+{
+public:
+	static_assert(IndexBits > 0 && StampBits >= 2 && IndexBits + StampBits <= 64,
+		"Index and stamp must fit into 64 bits, stamp needs at least 2 bits");
+
+	using Bits = PoolUInt<IndexBits + StampBits>;
+	using Stamp = PoolUInt<StampBits>;
+
+	/// Stamp that no record ever has
+	static constexpr Stamp InvalidStamp = static_cast<Stamp>(~uint64_t(0) >> (64 - StampBits));
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Default contructor. Create "invalid" pool handle
+	///////////////////////////////////////////////////////////////////////////////////////
+	PoolHandle() : PoolHandle(0, InvalidStamp) { }
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns index of a record
+	///////////////////////////////////////////////////////////////////////////////////////
+	PoolIndex GetIndex() const noexcept
+	{
+		return static_cast<PoolIndex>(mBits & IndexMask);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns stamp of a record at the moment of object spawn
+	///////////////////////////////////////////////////////////////////////////////////////
+	Stamp GetStamp() const noexcept
+	{
+		return static_cast<Stamp>(mBits >> (IndexBits % 64));
+	}
+
+	bool operator==(const PoolHandle &other) const noexcept
+	{
+		return mBits == other.mBits;
+	}
+
+	bool operator!=(const PoolHandle &other) const noexcept
+	{
+		return mBits != other.mBits;
+	}
+private:
+	template<typename, typename>
+	friend class Pool;
+	template<typename, size_t, typename>
+	friend class ConcurrentPool;
+	template<typename, typename...>
+	friend class BasicSoaPool;
+	template<typename, typename...>
+	friend class BasicMultiPool;
+	template<typename, typename>
+	friend class DensePool;
+	template<typename, typename>
+	friend class HierarchyPool;
+
+	static constexpr Bits IndexMask = static_cast<Bits>(~uint64_t(0) >> (64 - IndexBits));
+
+	Bits mBits;
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Private constructor for pool needs
+	///////////////////////////////////////////////////////////////////////////////////////
+	PoolHandle(PoolIndex index, Stamp stamp)
+		: mBits(static_cast<Bits>((static_cast<Bits>(stamp) << (IndexBits % 64)) | index))
+	{
+		assert(index <= IndexMask);
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Value that one writer thread changes while other threads read it: loads are relaxed
+/// and stores are release. Only the writer may use increment and assignment, they are
+/// not atomic read-modify-write operations.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename T>
+class PoolAtomicValue final
+{
+public:
+	explicit PoolAtomicValue(T value = T()) noexcept : mValue(value) { }
+
+	PoolAtomicValue(const PoolAtomicValue &other) noexcept : mValue(other) { }
+
+	PoolAtomicValue &operator=(const PoolAtomicValue &other) noexcept
+	{
+		return *this = static_cast<T>(other);
+	}
+
+	PoolAtomicValue &operator=(T value) noexcept
+	{
+		mValue.store(value, std::memory_order_release);
+		return *this;
+	}
+
+	T operator++() noexcept
+	{
+		const auto value = static_cast<T>(mValue.load(std::memory_order_relaxed) + 1);
+		mValue.store(value, std::memory_order_release);
+		return value;
+	}
+
+	operator T() const noexcept
+	{
+		return mValue.load(std::memory_order_relaxed);
+	}
+private:
+	std::atomic<T> mValue;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// 'T' itself, or PoolAtomicValue<T> when the value is read by other threads
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename T, bool Shared>
+using PoolSharedValue = typename std::conditional<Shared, PoolAtomicValue<T>, T>::type;
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Returns true if record with 'stamp' holds constructed object. Stamp of a record is
+/// its generation: it is incremented on every Spawn and Return, so odd stamp means
+/// record is busy and even stamp means record is free.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename StampType>
+inline bool IsLivePoolStamp(StampType stamp) noexcept
+{
+	return (stamp & 1) != 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Internal class for holding user objects. Stores additional information along with 
+/// user's object. Storage of free record holds index of next free record instead of
+/// object, so free list does not need any memory besides records.
+///////////////////////////////////////////////////////////////////////////////////////
+template <typename T, typename StampType, typename LinkType>
+class PoolRecord final
+{
+public:
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Free record that has never been used
+	///////////////////////////////////////////////////////////////////////////////////////
+	PoolRecord() : mStamp(0) { }
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Object lifetime is controlled by the pool
+	///////////////////////////////////////////////////////////////////////////////////////
+	~PoolRecord() { }
+private:
+	template<typename, typename>
+	friend class Pool;
+	template<typename, typename, typename, typename>
+	friend class ContiguousPoolStorage;
+	template<typename, typename, typename, typename, size_t>
+	friend class SegmentedPoolStorage;
+	template<typename, typename, typename, typename, size_t, bool>
+	friend class VirtualPoolStorage;
+	StampType mStamp;
+	union
+	{
+		T mObject;
+		LinkType mNextFree;
+	};
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Use this class as base to be able to obtain pointer to parent pool in derived class
+///////////////////////////////////////////////////////////////////////////////////////
+template<class T, typename Traits = PoolTraits>
+class Poolable
+{
+public:
+	Pool<T, Traits>* ParentPool()
+	{
+		return mOwner;
+	}
+private:
+	friend class Pool<T, Traits>;
+	Pool<T, Traits>* mOwner { nullptr };
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Storage that keeps every record in a single contiguous memory block. Growth
+/// allocates new block and moves every live object into it, so addresses of objects
+/// change.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename T, typename StampType, typename LinkType, typename Allocator>
+class ContiguousPoolStorage final
+{
+public:
+	using Record = PoolRecord<T, StampType, LinkType>;
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Objects in this storage are relocated on growth
+	///////////////////////////////////////////////////////////////////////////////////////
+	static constexpr bool StableAddresses = false;
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Other threads can not read records while storage grows
+	///////////////////////////////////////////////////////////////////////////////////////
+	static constexpr bool LockFreeReads = false;
+
+	explicit ContiguousPoolStorage(const Allocator &allocator)
+		: mAllocator(allocator)
+	{
+	}
+
+	ContiguousPoolStorage(const ContiguousPoolStorage&) = delete;
+	ContiguousPoolStorage& operator=(const ContiguousPoolStorage&) = delete;
+
+	~ContiguousPoolStorage()
+	{
+		Release();
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Preallocates memory for 'capacity' records. Returns actual capacity.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t Reserve(size_t capacity)
+	{
+		return capacity > mCapacity ? Grow(capacity) : mCapacity;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Allocates new memory block of 'capacity' records and moves every live object into
+	/// it. Returns actual capacity.
+	///
+	/// Throws std::bad_alloc when unable to allocate memory.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t Grow(size_t capacity)
+	{
+		assert(capacity > mCapacity);
+		return Relocate(capacity);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Moves first 'capacity' records to a smaller memory block. Records at and above
+	/// 'capacity' must be free. Returns actual capacity.
+	///
+	/// Throws std::bad_alloc when unable to allocate memory.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t Shrink(size_t capacity)
+	{
+		assert(capacity < mCapacity);
+		if (capacity == 0)
+		{
+			Release();
+			return 0;
+		}
+		return Relocate(capacity);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Frees memory block. Objects must be destroyed by the pool before this call.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Release()
+	{
+		FreeRecords();
+		mRecords = nullptr;
+		mCapacity = 0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Takes ownership of 'capacity' records that live inside of file 'mapping' of
+	/// 'mappingSize' bytes. Mapping is unmapped on release or growth, growth moves 
+	/// records to memory from the allocator. Storage must be empty.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void AdoptMapping(Record *records, size_t capacity, void *mapping, size_t mappingSize) noexcept
+	{
+		assert(!mRecords);
+		mRecords = records;
+		mCapacity = capacity;
+		mMapping = mapping;
+		mMappingSize = mappingSize;
+	}
+
+	StampType &Stamp(PoolIndex index) const noexcept
+	{
+		assert(index < mCapacity);
+		return mRecords[index].mStamp;
+	}
+
+	T *Object(PoolIndex index) const noexcept
+	{
+		assert(index < mCapacity);
+		return &mRecords[index].mObject;
+	}
+
+	LinkType &NextFree(PoolIndex index) const noexcept
+	{
+		assert(index < mCapacity);
+		return mRecords[index].mNextFree;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Hints CPU to load record into cache, stamp and object share the record
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Prefetch(PoolIndex index) const noexcept
+	{
+		assert(index < mCapacity);
+		PoolPrefetch(mRecords + index);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Writes index of record that holds 'ptr' to 'index'. Returns false if pointer does
+	/// not belong to this storage.
+	///////////////////////////////////////////////////////////////////////////////////////
+	bool IndexOf(const T *ptr, PoolIndex &index) const noexcept
+	{
+		if (mCapacity == 0)
+		{
+			return false;
+		}
+		const auto p = reinterpret_cast<const char *>(ptr);
+		const auto first = reinterpret_cast<const char *>(&mRecords[0].mObject);
+		const auto last = reinterpret_cast<const char *>(&mRecords[mCapacity - 1].mObject);
+		if (p < first || p > last)
+		{
+			return false;
+		}
+		index = static_cast<PoolIndex>((p - first) / sizeof(Record));
+		return true;
+	}
+
+	Record *GetRecords() const noexcept
+	{
+		return mRecords;
+	}
+private:
+	using RelocateTag = std::integral_constant<bool, PoolTriviallyRelocatable<T>::value>;
+
+	size_t Relocate(size_t capacity)
+	{
+		return Relocate(capacity, RelocateTag());
+	}
+
+	size_t Relocate(size_t capacity, std::false_type)
+	{
+		const size_t sizeBytes = sizeof(Record) * capacity;
+		const size_t count = capacity < mCapacity ? capacity : mCapacity;
+		const auto records = static_cast<Record *>(mAllocator.Allocate(sizeBytes, alignof(Record)));
+		// Zero stamp marks free record that has never been used
+		memset(static_cast<void*>(records), 0, sizeBytes);
+		size_t i = 0;
+		try
+		{
+			for (; i < count; ++i)
+			{
+				auto &from = mRecords[i];
+				auto &to = records[i];
+				to.mStamp = from.mStamp;
+				if (IsLivePoolStamp(from.mStamp))
+				{
+					// Move constructor is used when it can not throw, copy constructor
+					// otherwise, so objects of old block survive an exception
+					new (&to.mObject) T(std::move_if_noexcept(from.mObject));
+					if (std::is_nothrow_move_constructible<T>::value)
+					{
+						from.mObject.~T();
+					}
+				}
+				else
+				{
+					// Free list may be non-empty when pool grows to fit a batch
+					to.mNextFree = from.mNextFree;
+				}
+			}
+		}
+		catch (...)
+		{
+			// Old block stays in use, copies made so far are dropped
+			for (size_t j = 0; j < i; ++j)
+			{
+				if (IsLivePoolStamp(records[j].mStamp))
+				{
+					records[j].mObject.~T();
+				}
+			}
+			mAllocator.Deallocate(records, sizeBytes, alignof(Record));
+			throw;
+		}
+		if (!std::is_nothrow_move_constructible<T>::value)
+		{
+			for (i = 0; i < count; ++i)
+			{
+				if (IsLivePoolStamp(mRecords[i].mStamp))
+				{
+					mRecords[i].mObject.~T();
+				}
+			}
+		}
+		FreeRecords();
+		mRecords = records;
+		mCapacity = capacity;
+		return mCapacity;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Relocates trivially relocatable records as raw bytes: stamps, objects and links of
+	/// free list at once. Block is resized by the allocator, realloc of default one may 
+	/// extend it in place or move pages without copying.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t Relocate(size_t capacity, std::true_type)
+	{
+		const size_t sizeBytes = sizeof(Record) * capacity;
+		const size_t count = capacity < mCapacity ? capacity : mCapacity;
+		Record *records;
+		if (!mMapping)
+		{
+			records = static_cast<Record *>(PoolReallocate(mAllocator, static_cast<void *>(mRecords),
+				sizeof(Record) * mCapacity, sizeBytes, alignof(Record)));
+		}
+		else
+		{
+			records = static_cast<Record *>(mAllocator.Allocate(sizeBytes, alignof(Record)));
+			if (count != 0)
+			{
+				memcpy(static_cast<void *>(records), static_cast<const void *>(mRecords), sizeof(Record) * count);
+			}
+			FreeRecords();
+		}
+		// Zero stamp marks free record that has never been used
+		memset(static_cast<void *>(records + count), 0, sizeof(Record) * (capacity - count));
+		mRecords = records;
+		mCapacity = capacity;
+		return mCapacity;
+	}
+
+	void FreeRecords() noexcept
+	{
+#if !defined(_WIN32)
+		if (mMapping)
+		{
+			munmap(mMapping, mMappingSize);
+			mMapping = nullptr;
+			mMappingSize = 0;
+			return;
+		}
+#endif
+		if (mRecords)
+		{
+			mAllocator.Deallocate(mRecords, sizeof(Record) * mCapacity, alignof(Record));
+		}
+	}
+
+	Record *mRecords { nullptr };
+	size_t mCapacity { 0 };
+	/// File mapping that holds records, when storage was restored from snapshot
+	void *mMapping { nullptr };
+	size_t mMappingSize { 0 };
+	Allocator mAllocator;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Storage that keeps records in fixed-size chunks. Chunks are allocated on demand and 
+/// never relocated, so growth costs one chunk allocation and pointers to objects stay
+/// valid for whole lifetime of the object. Record lookup is chunk index plus offset.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename T, typename StampType, typename LinkType, typename Allocator, size_t ChunkSize>
+class SegmentedPoolStorage final
+{
+public:
+	using Record = PoolRecord<T, StampType, LinkType>;
+
+	static_assert(ChunkSize > 0 && (ChunkSize & (ChunkSize - 1)) == 0,
+		"Chunk size must be power of two");
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Objects in this storage never change their addresses
+	///////////////////////////////////////////////////////////////////////////////////////
+	static constexpr bool StableAddresses = true;
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Other threads can not read records while storage grows: table of chunks is 
+	/// relocated
+	///////////////////////////////////////////////////////////////////////////////////////
+	static constexpr bool LockFreeReads = false;
+
+	explicit SegmentedPoolStorage(const Allocator &allocator)
+		: mAllocator(allocator)
+	{
+	}
+
+	SegmentedPoolStorage(const SegmentedPoolStorage&) = delete;
+	SegmentedPoolStorage& operator=(const SegmentedPoolStorage&) = delete;
+
+	~SegmentedPoolStorage()
+	{
+		Release();
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Allocates as many chunks as required to hold 'capacity' records. Returns actual
+	/// capacity, which is always multiple of ChunkSize.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t Reserve(size_t capacity)
+	{
+		while (mChunkCount * ChunkSize < capacity)
+		{
+			AddChunk();
+		}
+		return mChunkCount * ChunkSize;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Adds exactly one chunk, requested capacity is ignored - growth never costs more 
+	/// than one chunk allocation. Returns actual capacity.
+	///
+	/// Throws std::bad_alloc when unable to allocate memory.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t Grow(size_t)
+	{
+		AddChunk();
+		return mChunkCount * ChunkSize;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Frees whole chunks past 'capacity' records, records at and above 'capacity' must
+	/// be free. Returns actual capacity, which is 'capacity' rounded up to ChunkSize.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t Shrink(size_t capacity)
+	{
+		const size_t chunkCount = (capacity + ChunkSize - 1) / ChunkSize;
+		while (mChunkCount > chunkCount)
+		{
+			FreeChunk(mChunks[--mChunkCount]);
+		}
+		return mChunkCount * ChunkSize;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Frees every chunk. Objects must be destroyed by the pool before this call.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Release()
+	{
+		for (size_t i = 0; i < mChunkCount; ++i)
+		{
+			FreeChunk(mChunks[i]);
+		}
+		if (mChunks)
+		{
+			mAllocator.Deallocate(mChunks, sizeof(Record *) * mChunkTableSize, alignof(Record *));
+		}
+		mChunks = nullptr;
+		mChunkCount = 0;
+		mChunkTableSize = 0;
+	}
+
+	StampType &Stamp(PoolIndex index) const noexcept
+	{
+		return GetRecord(index).mStamp;
+	}
+
+	T *Object(PoolIndex index) const noexcept
+	{
+		return &GetRecord(index).mObject;
+	}
+
+	LinkType &NextFree(PoolIndex index) const noexcept
+	{
+		return GetRecord(index).mNextFree;
+	}
+
+	void Prefetch(PoolIndex index) const noexcept
+	{
+		PoolPrefetch(&GetRecord(index));
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Writes index of record that holds 'ptr' to 'index'. Returns false if pointer does
+	/// not belong to this storage. Complexity is O(chunk count).
+	///////////////////////////////////////////////////////////////////////////////////////
+	bool IndexOf(const T *ptr, PoolIndex &index) const noexcept
+	{
+		const auto p = reinterpret_cast<const char *>(ptr);
+		for (size_t i = 0; i < mChunkCount; ++i)
+		{
+			const auto first = reinterpret_cast<const char *>(&mChunks[i][0].mObject);
+			const auto last = reinterpret_cast<const char *>(&mChunks[i][ChunkSize - 1].mObject);
+			if (p >= first && p <= last)
+			{
+				index = static_cast<PoolIndex>(i * ChunkSize + (p - first) / sizeof(Record));
+				return true;
+			}
+		}
+		return false;
+	}
+private:
+	Record &GetRecord(PoolIndex index) const noexcept
+	{
+		assert(index < mChunkCount * ChunkSize);
+		return mChunks[index / ChunkSize][index % ChunkSize];
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Allocates new chunk, table of chunks grows twice when it is full. Only the table
+	/// of pointers is moved, records stay in place.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void AddChunk()
+	{
+		if (mChunkCount == mChunkTableSize)
+		{
+			const size_t tableSize = mChunkTableSize == 0 ? 16 : mChunkTableSize * 2;
+			mChunks = static_cast<Record **>(PoolReallocate(mAllocator, mChunks, 
+				sizeof(Record *) * mChunkTableSize, sizeof(Record *) * tableSize, alignof(Record *)));
+			mChunkTableSize = tableSize;
+		}
+		const size_t sizeBytes = sizeof(Record) * ChunkSize;
+		const auto chunk = static_cast<Record *>(mAllocator.Allocate(sizeBytes, alignof(Record)));
+		// Zero stamp marks free record that has never been used
+		memset(static_cast<void*>(chunk), 0, sizeBytes);
+		mChunks[mChunkCount++] = chunk;
+	}
+
+	void FreeChunk(Record *chunk) noexcept
+	{
+		mAllocator.Deallocate(chunk, sizeof(Record) * ChunkSize, alignof(Record));
+	}
+
+	Record **mChunks { nullptr };
+	size_t mChunkCount { 0 };
+	size_t mChunkTableSize { 0 };
+	Allocator mAllocator;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Storage that reserves address space for 'MaxRecords' records once and commits
+/// memory at its end on growth. Nothing is copied on growth and objects never move.
+/// Fresh pages are zeroed by the system, so new records need no initialization.
+/// With 'HugePages' the range is advised for transparent huge pages (Linux) and 
+/// committed in 2 MiB steps.
+///
+/// Allocator of the pool is not used: memory comes directly from mmap/mprotect 
+/// (VirtualAlloc on Windows).
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename T, typename StampType, typename LinkType, typename Allocator, size_t MaxRecords, 
+	bool HugePages>
+class VirtualPoolStorage final
+{
+public:
+	using Record = PoolRecord<T, StampType, LinkType>;
+
+	static_assert(MaxRecords > 0, "Max count of records must be positive");
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Objects in this storage never move
+	///////////////////////////////////////////////////////////////////////////////////////
+	static constexpr bool StableAddresses = true;
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Other threads can read records while storage grows, growth only commits memory
+	/// past existing records
+	///////////////////////////////////////////////////////////////////////////////////////
+	static constexpr bool LockFreeReads = true;
+
+	explicit VirtualPoolStorage(const Allocator &)
+	{
+	}
+
+	VirtualPoolStorage(const VirtualPoolStorage&) = delete;
+	VirtualPoolStorage& operator=(const VirtualPoolStorage&) = delete;
+
+	~VirtualPoolStorage()
+	{
+		Release();
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Commits memory for 'capacity' records. Returns actual capacity.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t Reserve(size_t capacity)
+	{
+		return capacity > mCapacity ? Grow(capacity) : mCapacity;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Commits memory for at least 'capacity' records, but not more than MaxRecords. 
+	/// Returns actual capacity, which is rounded up to whole commit steps.
+	///
+	/// Throws std::bad_alloc when address space can not be reserved, memory can not be
+	/// committed or MaxRecords records are already committed.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t Grow(size_t capacity)
+	{
+		assert(capacity > mCapacity);
+		if (mCapacity >= MaxRecords)
+		{
+			throw std::bad_alloc();
+		}
+		if (!mRecords)
+		{
+			ReserveAddressSpace();
+		}
+		if (capacity > MaxRecords)
+		{
+			capacity = MaxRecords;
+		}
+		const auto step = GetCommitStep();
+		auto committed = (sizeof(Record) * capacity + step - 1) / step * step;
+		if (committed > mReservedBytes)
+		{
+			committed = mReservedBytes;
+		}
+		const auto base = reinterpret_cast<char *>(mRecords);
+		if (!Commit(base + mCommittedBytes, committed - mCommittedBytes))
+		{
+			throw std::bad_alloc();
+		}
+		mCommittedBytes = committed;
+		mCapacity = LimitRecords(committed / sizeof(Record));
+		return mCapacity;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Decommits memory past 'capacity' records, records at and above 'capacity' must be
+	/// free. Address range stays reserved. Returns actual capacity, which is rounded up 
+	/// to whole commit steps.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t Shrink(size_t capacity)
+	{
+		assert(capacity < mCapacity);
+		const auto step = GetCommitStep();
+		const auto committed = (sizeof(Record) * capacity + step - 1) / step * step;
+		if (committed < mCommittedBytes)
+		{
+			Decommit(reinterpret_cast<char *>(mRecords) + committed, mCommittedBytes - committed);
+			mCommittedBytes = committed;
+			mCapacity = LimitRecords(committed / sizeof(Record));
+		}
+		return mCapacity;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Gives whole address range back to the system. Objects must be destroyed by the
+	/// pool before this call.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Release()
+	{
+		if (mRecords)
+		{
+#if defined(_WIN32)
+			VirtualFree(mRecords, 0, MEM_RELEASE);
+#else
+			munmap(mRecords, mReservedBytes);
+#endif
+		}
+		mRecords = nullptr;
+		mReservedBytes = 0;
+		mCommittedBytes = 0;
+		mCapacity = 0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Stamp and Object are called by reader threads while storage grows, capacity is
+	/// atomic, so checks of index do not race with growth
+	///////////////////////////////////////////////////////////////////////////////////////
+	StampType &Stamp(PoolIndex index) const noexcept
+	{
+		assert(index < mCapacity);
+		return mRecords[index].mStamp;
+	}
+
+	T *Object(PoolIndex index) const noexcept
+	{
+		assert(index < mCapacity);
+		return &mRecords[index].mObject;
+	}
+
+	LinkType &NextFree(PoolIndex index) const noexcept
+	{
+		assert(index < mCapacity);
+		return mRecords[index].mNextFree;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Hints CPU to load record into cache, stamp and object share the record
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Prefetch(PoolIndex index) const noexcept
+	{
+		assert(index < mCapacity);
+		PoolPrefetch(mRecords + index);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Writes index of record that holds 'ptr' to 'index'. Returns false if pointer does
+	/// not belong to this storage.
+	///////////////////////////////////////////////////////////////////////////////////////
+	bool IndexOf(const T *ptr, PoolIndex &index) const noexcept
+	{
+		if (mCapacity == 0)
+		{
+			return false;
+		}
+		const auto p = reinterpret_cast<const char *>(ptr);
+		const auto first = reinterpret_cast<const char *>(&mRecords[0].mObject);
+		const auto last = reinterpret_cast<const char *>(&mRecords[mCapacity - 1].mObject);
+		if (p < first || p > last)
+		{
+			return false;
+		}
+		index = static_cast<PoolIndex>((p - first) / sizeof(Record));
+		return true;
+	}
+
+	Record *GetRecords() const noexcept
+	{
+		return mRecords;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns count of bytes of committed memory
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetCommittedBytes() const noexcept
+	{
+		return mCommittedBytes;
+	}
+private:
+	/// Size of transparent huge page on x86-64 and AArch64 with 4 KiB base pages
+	static constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+	static size_t GetPageSize() noexcept
+	{
+#if defined(_WIN32)
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return static_cast<size_t>(info.dwPageSize);
+#else
+		return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+	}
+
+	static size_t GetCommitStep() noexcept
+	{
+		return HugePages ? HugePageSize : GetPageSize();
+	}
+
+	static size_t LimitRecords(size_t capacity) noexcept
+	{
+		return capacity < MaxRecords ? capacity : MaxRecords;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Reserves address range for MaxRecords records without committing memory
+	///////////////////////////////////////////////////////////////////////////////////////
+	void ReserveAddressSpace()
+	{
+		const auto step = GetCommitStep();
+		const auto bytes = (sizeof(Record) * MaxRecords + step - 1) / step * step;
+#if defined(_WIN32)
+		const auto memory = VirtualAlloc(nullptr, bytes, MEM_RESERVE, PAGE_NOACCESS);
+		if (!memory)
+		{
+			throw std::bad_alloc();
+		}
+#else
+		const auto memory = mmap(nullptr, bytes, PROT_NONE, 
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (memory == MAP_FAILED)
+		{
+			throw std::bad_alloc();
+		}
+#ifdef MADV_HUGEPAGE
+		if (HugePages)
+		{
+			// Only a hint, pool works with regular pages if it is ignored
+			madvise(memory, bytes, MADV_HUGEPAGE);
+		}
+#endif
+#endif
+		mRecords = static_cast<Record *>(memory);
+		mReservedBytes = bytes;
+	}
+
+	static bool Commit(void *memory, size_t bytes) noexcept
+	{
+		if (bytes == 0)
+		{
+			return true;
+		}
+#if defined(_WIN32)
+		return VirtualAlloc(memory, bytes, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+		return mprotect(memory, bytes, PROT_READ | PROT_WRITE) == 0;
+#endif
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Gives pages back to the system, they read as zeros when committed again
+	///////////////////////////////////////////////////////////////////////////////////////
+	static void Decommit(void *memory, size_t bytes) noexcept
+	{
+#if defined(_WIN32)
+		VirtualFree(memory, bytes, MEM_DECOMMIT);
+#else
+		madvise(memory, bytes, MADV_DONTNEED);
+		mprotect(memory, bytes, PROT_NONE);
+#endif
+	}
+
+	Record *mRecords { nullptr };
+	size_t mReservedBytes { 0 };
+	size_t mCommittedBytes { 0 };
+	/// Read by other threads while storage grows
+	PoolAtomicValue<size_t> mCapacity { 0 };
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Storage that keeps stamps and objects in two parallel arrays: a dense array of 
+/// stamps and an array of objects aligned to 'Alignment' (natural alignment of T when
+/// zero). Validity checks touch only stamps, so they do not pull objects into cache.
+/// Growth relocates both arrays, same as contiguous storage.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename T, typename StampType, typename LinkType, typename Allocator, size_t Alignment>
+class SplitPoolStorage final
+{
+public:
+	static constexpr size_t ObjectAlignment = Alignment > alignof(T) ? Alignment : alignof(T);
+	static_assert((ObjectAlignment & (ObjectAlignment - 1)) == 0, 
+		"Alignment must be power of two");
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Memory of an object, holds link to next free record when object is destructed.
+	/// Size of a slot is multiple of its alignment, so every object is aligned.
+	///////////////////////////////////////////////////////////////////////////////////////
+	struct alignas(ObjectAlignment) Slot
+	{
+		Slot() { }
+		~Slot() { }
+		union
+		{
+			T mObject;
+			LinkType mNextFree;
+		};
+	};
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Objects in this storage are relocated on growth
+	///////////////////////////////////////////////////////////////////////////////////////
+	static constexpr bool StableAddresses = false;
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Other threads can not read records while storage grows
+	///////////////////////////////////////////////////////////////////////////////////////
+	static constexpr bool LockFreeReads = false;
+
+	explicit SplitPoolStorage(const Allocator &allocator)
+		: mAllocator(allocator)
+	{
+	}
+
+	SplitPoolStorage(const SplitPoolStorage&) = delete;
+	SplitPoolStorage& operator=(const SplitPoolStorage&) = delete;
+
+	~SplitPoolStorage()
+	{
+		Release();
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Preallocates memory for 'capacity' records. Returns actual capacity.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t Reserve(size_t capacity)
+	{
+		return capacity > mCapacity ? Grow(capacity) : mCapacity;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Allocates new arrays of 'capacity' records and moves every live object into them.
+	/// Returns actual capacity.
+	///
+	/// Throws std::bad_alloc when unable to allocate memory.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t Grow(size_t capacity)
+	{
+		assert(capacity > mCapacity);
+		return Relocate(capacity);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Moves first 'capacity' records to smaller arrays. Records at and above 'capacity'
+	/// must be free. Returns actual capacity.
+	///
+	/// Throws std::bad_alloc when unable to allocate memory.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t Shrink(size_t capacity)
+	{
+		assert(capacity < mCapacity);
+		if (capacity == 0)
+		{
+			Release();
+			return 0;
+		}
+		return Relocate(capacity);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Frees memory of both arrays. Objects must be destroyed by the pool before this call.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Release()
+	{
+		if (mStamps)
+		{
+			mAllocator.Deallocate(mStamps, sizeof(StampType) * mCapacity, alignof(StampType));
+			mAllocator.Deallocate(mSlots, sizeof(Slot) * mCapacity, ObjectAlignment);
+		}
+		mStamps = nullptr;
+		mSlots = nullptr;
+		mCapacity = 0;
+	}
+
+	StampType &Stamp(PoolIndex index) const noexcept
+	{
+		assert(index < mCapacity);
+		return mStamps[index];
+	}
+
+	T *Object(PoolIndex index) const noexcept
+	{
+		assert(index < mCapacity);
+		return &mSlots[index].mObject;
+	}
+
+	LinkType &NextFree(PoolIndex index) const noexcept
+	{
+		assert(index < mCapacity);
+		return mSlots[index].mNextFree;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Hints CPU to load stamp and object of record into cache, they are apart
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Prefetch(PoolIndex index) const noexcept
+	{
+		assert(index < mCapacity);
+		PoolPrefetch(mStamps + index);
+		PoolPrefetch(mSlots + index);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Writes index of record that holds 'ptr' to 'index'. Returns false if pointer does
+	/// not belong to this storage.
+	///////////////////////////////////////////////////////////////////////////////////////
+	bool IndexOf(const T *ptr, PoolIndex &index) const noexcept
+	{
+		const auto p = reinterpret_cast<const char *>(ptr);
+		const auto first = reinterpret_cast<const char *>(mSlots);
+		if (mCapacity == 0 || p < first || p >= first + sizeof(Slot) * mCapacity)
+		{
+			return false;
+		}
+		index = static_cast<PoolIndex>((p - first) / sizeof(Slot));
+		return true;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns dense array of stamps. You should NEVER store returned pointer.
+	///////////////////////////////////////////////////////////////////////////////////////
+	const StampType *GetStamps() const noexcept
+	{
+		return mStamps;
+	}
+private:
+	size_t Relocate(size_t capacity)
+	{
+		const auto stamps = static_cast<StampType *>(
+			mAllocator.Allocate(sizeof(StampType) * capacity, alignof(StampType)));
+		Slot *slots;
+		try
+		{
+			slots = static_cast<Slot *>(mAllocator.Allocate(sizeof(Slot) * capacity, ObjectAlignment));
+		}
+		catch (...)
+		{
+			mAllocator.Deallocate(stamps, sizeof(StampType) * capacity, alignof(StampType));
+			throw;
+		}
+		const size_t count = capacity < mCapacity ? capacity : mCapacity;
+		// Zero stamp marks free record that has never been used
+		if (count != 0)
+		{
+			memcpy(stamps, mStamps, sizeof(StampType) * count);
+		}
+		memset(stamps + count, 0, sizeof(StampType) * (capacity - count));
+		try
+		{
+			MoveSlots(slots, count, std::integral_constant<bool, PoolTriviallyRelocatable<T>::value>());
+		}
+		catch (...)
+		{
+			mAllocator.Deallocate(slots, sizeof(Slot) * capacity, ObjectAlignment);
+			mAllocator.Deallocate(stamps, sizeof(StampType) * capacity, alignof(StampType));
+			throw;
+		}
+		Release();
+		mStamps = stamps;
+		mSlots = slots;
+		mCapacity = capacity;
+		return mCapacity;
+	}
+
+	void MoveSlots(Slot *slots, size_t count, std::true_type) noexcept
+	{
+		// Objects and links of free list at once, slots keep their alignment
+		if (count != 0)
+		{
+			memcpy(static_cast<void *>(slots), static_cast<const void *>(mSlots), sizeof(Slot) * count);
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Moves objects when move constructor can not throw, copies them otherwise. If copy
+	/// throws, copies made so far are destructed and old slots are untouched.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void MoveSlots(Slot *slots, size_t count, std::false_type)
+	{
+		size_t i = 0;
+		try
+		{
+			for (; i < count; ++i)
+			{
+				if (IsLivePoolStamp(mStamps[i]))
+				{
+					new (&slots[i].mObject) T(std::move_if_noexcept(mSlots[i].mObject));
+					if (std::is_nothrow_move_constructible<T>::value)
+					{
+						mSlots[i].mObject.~T();
+					}
+				}
+				else
+				{
+					slots[i].mNextFree = mSlots[i].mNextFree;
+				}
+			}
+		}
+		catch (...)
+		{
+			for (size_t j = 0; j < i; ++j)
+			{
+				if (IsLivePoolStamp(mStamps[j]))
+				{
+					slots[j].mObject.~T();
+				}
+			}
+			throw;
+		}
+		if (!std::is_nothrow_move_constructible<T>::value)
+		{
+			for (i = 0; i < count; ++i)
+			{
+				if (IsLivePoolStamp(mStamps[i]))
+				{
+					mSlots[i].mObject.~T();
+				}
+			}
+		}
+	}
+
+	StampType *mStamps { nullptr };
+	Slot *mSlots { nullptr };
+	size_t mCapacity { 0 };
+	Allocator mAllocator;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Returns index of lowest set bit of 'word', which must not be zero
+///////////////////////////////////////////////////////////////////////////////////////
+inline unsigned PoolBitScanForward(uint64_t word) noexcept
+{
+	assert(word != 0);
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, word);
+	return static_cast<unsigned>(index);
+#else
+	return static_cast<unsigned>(__builtin_ctzll(word));
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Returns count of set bits of 'word'
+///////////////////////////////////////////////////////////////////////////////////////
+inline unsigned PoolPopCount(uint64_t word) noexcept
+{
+#if defined(_MSC_VER)
+	return static_cast<unsigned>(__popcnt64(word));
+#else
+	return static_cast<unsigned>(__builtin_popcountll(word));
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Returns index of highest set bit of 'word', which must not be zero
+///////////////////////////////////////////////////////////////////////////////////////
+inline unsigned PoolBitScanReverse(uint64_t word) noexcept
+{
+	assert(word != 0);
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanReverse64(&index, word);
+	return static_cast<unsigned>(index);
+#else
+	return static_cast<unsigned>(63 - __builtin_clzll(word));
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Resizable set of bits, used to track occupied records. Bits are scanned a 64-bit
+/// word at a time, so cost of the scan is proportional to count of set bits plus
+/// count of words, not count of bits.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename Allocator = PoolFunctionAllocator>
+class PoolBitmap final
+{
+public:
+	static constexpr size_t BitsPerWord = 64;
+
+	explicit PoolBitmap(const Allocator &allocator)
+		: mAllocator(allocator)
+	{
+	}
+
+	PoolBitmap(const PoolBitmap&) = delete;
+	PoolBitmap& operator=(const PoolBitmap&) = delete;
+
+	~PoolBitmap()
+	{
+		Release();
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Changes count of bits. Bits below new count are kept, new bits are cleared.
+	///
+	/// Throws std::bad_alloc when unable to allocate memory.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Resize(size_t bitCount)
+	{
+		const size_t wordCount = (bitCount + BitsPerWord - 1) / BitsPerWord;
+		if (wordCount == 0)
+		{
+			Release();
+			return;
+		}
+		if (wordCount != mWordCount)
+		{
+			mWords = static_cast<uint64_t *>(PoolReallocate(mAllocator, mWords, 
+				sizeof(uint64_t) * mWordCount, sizeof(uint64_t) * wordCount, alignof(uint64_t)));
+			if (wordCount > mWordCount)
+			{
+				memset(mWords + mWordCount, 0, sizeof(uint64_t) * (wordCount - mWordCount));
+			}
+			mWordCount = wordCount;
+		}
+		if (bitCount < mBitCount && bitCount % BitsPerWord != 0)
+		{
+			// Clear tail of last word
+			mWords[wordCount - 1] &= (uint64_t(1) << (bitCount % BitsPerWord)) - 1;
+		}
+		mBitCount = bitCount;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Frees memory of the bitmap
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Release()
+	{
+		if (mWords)
+		{
+			mAllocator.Deallocate(mWords, sizeof(uint64_t) * mWordCount, alignof(uint64_t));
+		}
+		mWords = nullptr;
+		mWordCount = 0;
+		mBitCount = 0;
+	}
+
+	void Set(size_t index) noexcept
+	{
+		assert(index < mBitCount);
+		mWords[index / BitsPerWord] |= uint64_t(1) << (index % BitsPerWord);
+	}
+
+	void Reset(size_t index) noexcept
+	{
+		assert(index < mBitCount);
+		mWords[index / BitsPerWord] &= ~(uint64_t(1) << (index % BitsPerWord));
+	}
+
+	bool Test(size_t index) const noexcept
+	{
+		assert(index < mBitCount);
+		return (mWords[index / BitsPerWord] >> (index % BitsPerWord)) & 1;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns index of first set bit at or after 'from', or bit count if there is none.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t FindNext(size_t from) const noexcept
+	{
+		if (from >= mBitCount)
+		{
+			return mBitCount;
+		}
+		size_t wordIndex = from / BitsPerWord;
+		// Mask out bits below 'from' in the first word
+		uint64_t word = mWords[wordIndex] & (~uint64_t(0) << (from % BitsPerWord));
+		while (word == 0)
+		{
+			if (++wordIndex == mWordCount)
+			{
+				return mBitCount;
+			}
+			word = mWords[wordIndex];
+		}
+		return wordIndex * BitsPerWord + PoolBitScanForward(word);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns index of last set bit before 'end', or bit count if there is none.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t FindPrevious(size_t end) const noexcept
+	{
+		if (end > mBitCount)
+		{
+			end = mBitCount;
+		}
+		if (end == 0)
+		{
+			return mBitCount;
+		}
+		size_t wordIndex = (end - 1) / BitsPerWord;
+		// Mask out bits at and after 'end' in the last word
+		const size_t tail = end % BitsPerWord;
+		uint64_t word = mWords[wordIndex] & (tail == 0 ? ~uint64_t(0) : (uint64_t(1) << tail) - 1);
+		while (word == 0)
+		{
+			if (wordIndex-- == 0)
+			{
+				return mBitCount;
+			}
+			word = mWords[wordIndex];
+		}
+		return wordIndex * BitsPerWord + PoolBitScanReverse(word);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Calls 'func(index)' for every set bit in ascending order. Bits are read a word at a
+	/// time, so 'func' may clear bit it was called for.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template<typename Func>
+	void ForEachSet(Func &&func) const
+	{
+		ForEachSet(0, mWordCount, func);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Same as ForEachSet, but only for bits of words in [firstWord, lastWord)
+	///////////////////////////////////////////////////////////////////////////////////////
+	template<typename Func>
+	void ForEachSet(size_t firstWord, size_t lastWord, Func &&func) const
+	{
+		assert(firstWord <= lastWord && lastWord <= mWordCount);
+		for (size_t wordIndex = firstWord; wordIndex < lastWord; ++wordIndex)
+		{
+			uint64_t word = mWords[wordIndex];
+			while (word != 0)
+			{
+				func(wordIndex * BitsPerWord + PoolBitScanForward(word));
+				// Clear lowest set bit
+				word &= word - 1;
+			}
+		}
+	}
+
+	size_t GetBitCount() const noexcept
+	{
+		return mBitCount;
+	}
+
+	size_t GetWordCount() const noexcept
+	{
+		return mWordCount;
+	}
+
+	const uint64_t *GetWords() const noexcept
+	{
+		return mWords;
+	}
+
+	uint64_t *GetWords() noexcept
+	{
+		return mWords;
+	}
+private:
+	uint64_t *mWords { nullptr };
+	size_t mWordCount { 0 };
+	size_t mBitCount { 0 };
+	Allocator mAllocator;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Set of indices that gives out the lowest one first. Bit per index plus summary bit
+/// per word of index bits, so search for the lowest index skips 4096 indices per 
+/// summary word.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename Allocator = PoolFunctionAllocator>
+class PoolIndexSet final
+{
+public:
+	explicit PoolIndexSet(const Allocator &allocator)
+		: mBits(allocator)
+		, mSummary(allocator)
+	{
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Changes count of indices the set may hold, indices at and above 'count' are 
+	/// removed.
+	///
+	/// Throws std::bad_alloc when unable to allocate memory.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Resize(size_t count)
+	{
+		mBits.Resize(count);
+		const auto wordCount = mBits.GetWordCount();
+		mSummary.Resize(wordCount);
+		if (wordCount != 0 && mBits.GetWords()[wordCount - 1] == 0)
+		{
+			mSummary.Reset(wordCount - 1);
+		}
+	}
+
+	void Release()
+	{
+		mBits.Release();
+		mSummary.Release();
+		mHint = 0;
+	}
+
+	void Insert(size_t index) noexcept
+	{
+		mBits.Set(index);
+		const auto wordIndex = index / PoolBitmap<Allocator>::BitsPerWord;
+		mSummary.Set(wordIndex);
+		if (wordIndex < mHint)
+		{
+			mHint = wordIndex;
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Removes and returns the lowest index, returns count of indices if set is empty
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t PopLowest() noexcept
+	{
+		// No summary bit below hint is set
+		const auto wordIndex = mSummary.FindNext(mHint);
+		if (wordIndex == mSummary.GetBitCount())
+		{
+			mHint = wordIndex;
+			return mBits.GetBitCount();
+		}
+		mHint = wordIndex;
+		auto &word = mBits.GetWords()[wordIndex];
+		const auto bit = PoolBitScanForward(word);
+		word &= word - 1;
+		if (word == 0)
+		{
+			mSummary.Reset(wordIndex);
+		}
+		return wordIndex * PoolBitmap<Allocator>::BitsPerWord + bit;
+	}
+private:
+	PoolBitmap<Allocator> mBits;
+	PoolBitmap<Allocator> mSummary;
+	size_t mHint { 0 };
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Fixed set of worker threads that runs indexed tasks, used by Pool::ParallelForEach.
+/// Calling thread takes part in work, tasks are handed out through a shared atomic
+/// counter, so idle threads keep taking tasks until none is left.
+///////////////////////////////////////////////////////////////////////////////////////
+class PoolThreadPool final
+{
+public:
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// @param workerCount - count of threads besides calling one
+	///////////////////////////////////////////////////////////////////////////////////////
+	explicit PoolThreadPool(size_t workerCount)
+	{
+		for (size_t i = 0; i < workerCount; ++i)
+		{
+			mWorkers.emplace_back([this] { WorkerLoop(); });
+		}
+	}
+
+	PoolThreadPool(const PoolThreadPool&) = delete;
+	PoolThreadPool& operator=(const PoolThreadPool&) = delete;
+
+	~PoolThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStop = true;
+		}
+		mWake.notify_all();
+		for (auto &worker : mWorkers)
+		{
+			worker.join();
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Calls 'func(task)' for every task in [0, taskCount) and returns when all calls 
+	/// are done. 'func' must not throw. Concurrent calls are serialized.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template<typename Func>
+	void operator()(size_t taskCount, Func &&func)
+	{
+		std::lock_guard<std::mutex> runLock(mRunMutex);
+		auto invoke = [](void *context, size_t task)
+		{
+			(*static_cast<typename std::remove_reference<Func>::type *>(context))(task);
+		};
+		Job job { invoke, const_cast<void *>(static_cast<const void *>(&func)), taskCount };
+		{
+			// Late worker of previous job may still hold task counter
+			std::unique_lock<std::mutex> lock(mMutex);
+			mDone.wait(lock, [this] { return mBusyWorkers == 0; });
+			mJob = job;
+			mNextTask.store(0, std::memory_order_relaxed);
+			++mGeneration;
+		}
+		mWake.notify_all();
+		Work(job);
+		// Job lives on this stack, wait until no worker can touch it
+		std::unique_lock<std::mutex> lock(mMutex);
+		mDone.wait(lock, [this] { return mBusyWorkers == 0; });
+		mJob = Job();
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns count of threads that run tasks, including calling one
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetThreadCount() const noexcept
+	{
+		return mWorkers.size() + 1;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns shared thread pool with a thread per hardware thread
+	///////////////////////////////////////////////////////////////////////////////////////
+	static PoolThreadPool &GetDefault()
+	{
+		static PoolThreadPool pool(std::thread::hardware_concurrency() > 1 ? 
+			std::thread::hardware_concurrency() - 1 : 0);
+		return pool;
+	}
+private:
+	struct Job
+	{
+		void (*mInvoke)(void *context, size_t task);
+		void *mContext;
+		size_t mTaskCount;
+	};
+
+	void Work(const Job &job)
+	{
+		for (;;)
+		{
+			const auto task = mNextTask.fetch_add(1, std::memory_order_relaxed);
+			if (task >= job.mTaskCount)
+			{
+				break;
+			}
+			job.mInvoke(job.mContext, task);
+		}
+	}
+
+	void WorkerLoop()
+	{
+		uint64_t generation = 0;
+		std::unique_lock<std::mutex> lock(mMutex);
+		for (;;)
+		{
+			mWake.wait(lock, [&] { return mStop || mGeneration != generation; });
+			if (mStop)
+			{
+				return;
+			}
+			generation = mGeneration;
+			const auto job = mJob;
+			++mBusyWorkers;
+			lock.unlock();
+			Work(job);
+			lock.lock();
+			if (--mBusyWorkers == 0)
+			{
+				mDone.notify_all();
+			}
+		}
+	}
+
+	std::vector<std::thread> mWorkers;
+	std::mutex mRunMutex;
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::condition_variable mDone;
+	Job mJob {};
+	uint64_t mGeneration { 0 };
+	size_t mBusyWorkers { 0 };
+	bool mStop { false };
+	alignas(64) std::atomic<size_t> mNextTask { 0 };
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Header of pool snapshot file. Records follow the header at 'mRecordsOffset', then
+/// words of occupancy bitmap at 'mBitmapOffset'. Values are in native byte order, 
+/// snapshot is meant to be mapped on the machine that saved it.
+///////////////////////////////////////////////////////////////////////////////////////
+struct PoolSnapshotHeader
+{
+	static constexpr uint32_t CurrentVersion = 3;
+	/// Alignment of every block in snapshot file
+	static constexpr uint64_t BlockAlignment = 64;
+
+	char mMagic[8];
+	uint32_t mVersion;
+	uint32_t mRecordSize;
+	uint32_t mIndexBits;
+	uint32_t mStampBits;
+	/// PoolReuse of the pool, free records of LowestIndex policy are not linked
+	uint32_t mReuse;
+	uint32_t mReserved;
+	uint64_t mCapacity;
+	uint64_t mFrontier;
+	uint64_t mFreeHead;
+	uint64_t mFreeTail;
+	uint64_t mSpawnedCount;
+	uint64_t mRetiredCount;
+	uint64_t mStampFloor;
+	uint64_t mRecordsOffset;
+	uint64_t mBitmapOffset;
+	uint64_t mBitmapWordCount;
+
+	static uint64_t AlignOffset(uint64_t offset) noexcept
+	{
+		return (offset + BlockAlignment - 1) & ~(BlockAlignment - 1);
+	}
+
+	static const char *GetMagic() noexcept
+	{
+		return "SMPOOL\0";
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Counters of Pool, collected when Traits::CollectStats is set
+///////////////////////////////////////////////////////////////////////////////////////
+struct PoolStats
+{
+	uint64_t mSpawnCount { 0 };
+	uint64_t mReturnCount { 0 };
+	/// Count of storage growths
+	uint64_t mGrowthCount { 0 };
+	/// Bytes of live objects relocated by growths
+	uint64_t mGrowthBytesMoved { 0 };
+	/// Time spent in growths
+	uint64_t mGrowthNanoseconds { 0 };
+	/// Max count of live objects the pool ever had
+	uint64_t mHighWaterMark { 0 };
+	/// Count of IsValid calls and how many of them got stale handle
+	uint64_t mValidationCount { 0 };
+	uint64_t mStaleHandleCount { 0 };
+	/// Current state of the pool at the moment of GetStats call
+	uint64_t mLiveCount { 0 };
+	uint64_t mCapacity { 0 };
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns ratio of live objects to capacity, 1 means no free records
+	///////////////////////////////////////////////////////////////////////////////////////
+	double GetOccupancy() const noexcept
+	{
+		return mCapacity != 0 ? static_cast<double>(mLiveCount) / mCapacity : 0.0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns ratio of IsValid calls that got stale handle
+	///////////////////////////////////////////////////////////////////////////////////////
+	double GetStaleHandleRate() const noexcept
+	{
+		return mValidationCount != 0 ? static_cast<double>(mStaleHandleCount) / mValidationCount : 0.0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Writes counters to 'file' as single line JSON object
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Dump(FILE *file) const
+	{
+		fprintf(file, "{\"spawnCount\":%llu,\"returnCount\":%llu,\"growthCount\":%llu,"
+			"\"growthBytesMoved\":%llu,\"growthNanoseconds\":%llu,\"highWaterMark\":%llu,"
+			"\"validationCount\":%llu,\"staleHandleCount\":%llu,\"staleHandleRate\":%g,"
+			"\"liveCount\":%llu,\"capacity\":%llu,\"occupancy\":%g}\n",
+			static_cast<unsigned long long>(mSpawnCount), static_cast<unsigned long long>(mReturnCount),
+			static_cast<unsigned long long>(mGrowthCount), static_cast<unsigned long long>(mGrowthBytesMoved),
+			static_cast<unsigned long long>(mGrowthNanoseconds), static_cast<unsigned long long>(mHighWaterMark),
+			static_cast<unsigned long long>(mValidationCount), static_cast<unsigned long long>(mStaleHandleCount),
+			GetStaleHandleRate(), static_cast<unsigned long long>(mLiveCount),
+			static_cast<unsigned long long>(mCapacity), GetOccupancy());
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Base of Pool that collects PoolStats. This one is used when stats are off: it is 
+/// empty and every method does nothing, so it costs nothing.
+///////////////////////////////////////////////////////////////////////////////////////
+template<bool Enabled>
+class PoolStatsCollector
+{
+protected:
+	void CountSpawn(size_t, size_t) noexcept
+	{
+	}
+
+	void CountReturn(size_t) noexcept
+	{
+	}
+
+	void CountValidation(bool) const noexcept
+	{
+	}
+
+	template<typename Func>
+	void MeasureGrowth(size_t, Func &&grow)
+	{
+		grow();
+	}
+
+	PoolStats GetCollectedStats() const noexcept
+	{
+		return PoolStats();
+	}
+
+	void ResetCollectedStats() noexcept
+	{
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Base of Pool that collects PoolStats when stats are on
+///////////////////////////////////////////////////////////////////////////////////////
+template<>
+class PoolStatsCollector<true>
+{
+protected:
+	void CountSpawn(size_t count, size_t spawnedCount) noexcept
+	{
+		mStats.mSpawnCount += count;
+		if (spawnedCount > mStats.mHighWaterMark)
+		{
+			mStats.mHighWaterMark = spawnedCount;
+		}
+	}
+
+	void CountReturn(size_t count) noexcept
+	{
+		mStats.mReturnCount += count;
+	}
+
+	void CountValidation(bool valid) const noexcept
+	{
+		++mStats.mValidationCount;
+		mStats.mStaleHandleCount += !valid;
+	}
+
+	template<typename Func>
+	void MeasureGrowth(size_t bytesMoved, Func &&grow)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		grow();
+		mStats.mGrowthNanoseconds += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count());
+		++mStats.mGrowthCount;
+		mStats.mGrowthBytesMoved += bytesMoved;
+	}
+
+	PoolStats GetCollectedStats() const noexcept
+	{
+		return mStats;
+	}
+
+	void ResetCollectedStats() noexcept
+	{
+		mStats = PoolStats();
+	}
+private:
+	/// IsValid is const, but counts validations
+	mutable PoolStats mStats;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Epochs of reader threads for pools with deferred return. Every reader thread 
+/// registers once and wraps its reads in PoolReadGuard. Writer advances global epoch
+/// only when every reader inside of a read section has seen current epoch, so object
+/// returned in epoch E can not be seen by any reader once global epoch reaches E + 2.
+/// Readers never block and never write shared state except their own slot.
+///////////////////////////////////////////////////////////////////////////////////////
+class PoolEpochs final
+{
+public:
+	/// Max count of registered readers
+	static constexpr size_t MaxReaders = 64;
+
+	PoolEpochs() = default;
+	PoolEpochs(const PoolEpochs&) = delete;
+	PoolEpochs& operator=(const PoolEpochs&) = delete;
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Takes free reader slot and returns its index. Thread-safe.
+	///
+	/// Throws std::bad_alloc when every slot is taken.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t RegisterReader()
+	{
+		for (size_t i = 0; i < MaxReaders; ++i)
+		{
+			if (!mSlots[i].mUsed.exchange(true, std::memory_order_acquire))
+			{
+				return i;
+			}
+		}
+		throw std::bad_alloc();
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Gives reader slot back. Reader must be outside of read section.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void UnregisterReader(size_t reader) noexcept
+	{
+		assert(reader < MaxReaders);
+		mSlots[reader].mEpoch.store(Inactive, std::memory_order_release);
+		mSlots[reader].mUsed.store(false, std::memory_order_release);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Starts read section of 'reader'. Objects that are valid inside of read section
+	/// stay alive until the section ends, even if they are returned meanwhile.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Enter(size_t reader) noexcept
+	{
+		assert(reader < MaxReaders);
+		// Reads of the section must not be reordered before epoch is published, so it is
+		// published with read-modify-write
+		mSlots[reader].mEpoch.exchange(mEpoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+	}
+
+	void Leave(size_t reader) noexcept
+	{
+		assert(reader < MaxReaders);
+		mSlots[reader].mEpoch.store(Inactive, std::memory_order_release);
+	}
+
+	uint64_t GetEpoch() const noexcept
+	{
+		return mEpoch.load(std::memory_order_relaxed);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Advances global epoch if every reader inside of read section has seen it. 
+	/// Returns global epoch.
+	///////////////////////////////////////////////////////////////////////////////////////
+	uint64_t TryAdvance() noexcept
+	{
+		auto epoch = mEpoch.load(std::memory_order_seq_cst);
+		for (const auto &slot : mSlots)
+		{
+			// Synchronizes with Enter and Leave, reads of finished sections happen before
+			const auto readerEpoch = slot.mEpoch.load(std::memory_order_seq_cst);
+			if (readerEpoch != Inactive && readerEpoch != epoch)
+			{
+				return epoch;
+			}
+		}
+		if (mEpoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst))
+		{
+			++epoch;
+		}
+		return epoch;
+	}
+private:
+	/// Epoch of reader outside of read section, global epoch starts after it
+	static constexpr uint64_t Inactive = 0;
+
+	struct alignas(64) Slot
+	{
+		std::atomic<uint64_t> mEpoch { Inactive };
+		std::atomic<bool> mUsed { false };
+	};
+
+	alignas(64) std::atomic<uint64_t> mEpoch { Inactive + 1 };
+	Slot mSlots[MaxReaders];
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Read section of a reader thread, see PoolEpochs
+///////////////////////////////////////////////////////////////////////////////////////
+class PoolReadGuard final
+{
+public:
+	PoolReadGuard(PoolEpochs &epochs, size_t reader) noexcept
+		: mEpochs(epochs)
+		, mReader(reader)
+	{
+		mEpochs.Enter(mReader);
+	}
+
+	~PoolReadGuard()
+	{
+		mEpochs.Leave(mReader);
+	}
+
+	PoolReadGuard(const PoolReadGuard&) = delete;
+	PoolReadGuard& operator=(const PoolReadGuard&) = delete;
+private:
+	PoolEpochs &mEpochs;
+	size_t mReader;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Base of Pool that keeps returned records until readers are done with them. Empty
+/// when deferred return is off.
+///////////////////////////////////////////////////////////////////////////////////////
+template<bool Enabled>
+class PoolDeferredReturn
+{
+protected:
+	size_t GetPendingCount() const noexcept
+	{
+		return 0;
+	}
+};
+
+template<>
+class PoolDeferredReturn<true>
+{
+protected:
+	/// Returned record, which will be reclaimed when global epoch reaches mEpoch + 2
+	struct PendingRecord
+	{
+		PoolIndex mIndex;
+		uint64_t mEpoch;
+	};
+
+	size_t GetPendingCount() const noexcept
+	{
+		return mPending.size();
+	}
+
+	PoolEpochs mEpochs;
+	/// Ordered by epoch
+	std::vector<PendingRecord> mPending;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// See description in the beginning of this file
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename T, typename Traits>
+class Pool final 
+	: private PoolStatsCollector<Traits::CollectStats>
+	, private PoolDeferredReturn<Traits::DeferredReturn>
+{
+public:
+	typedef void* (*MemoryAllocFunc)(size_t size);
+	typedef void (*MemoryFreeFunc)(void* ptr);
+	using Handle = PoolHandle<T, Traits::IndexBits, Traits::StampBits>;
+	using Stamp = typename Handle::Stamp;
+	using Link = PoolUInt<Traits::IndexBits>;
+	using Allocator = typename Traits::Allocator;
+	/// Stamp kept in records, read by reader threads with deferred return
+	using RecordStamp = PoolSharedValue<Stamp, Traits::DeferredReturn>;
+	using Storage = typename Traits::template Storage<T, RecordStamp, Link, Allocator>;
+	using Record = PoolRecord<T, RecordStamp, Link>;
+	using Growth = typename Traits::Growth;
+
+	/// Max count of records, the largest index is reserved for end of free list
+	static constexpr size_t MaxCapacity = static_cast<size_t>(
+		~uint64_t(0) >> (64 - Traits::IndexBits)) - (Traits::IndexBits < 64 ? 0 : 1);
+
+	/// With deferred return, Return reclaims records every ReclaimBatch returns
+	static constexpr size_t ReclaimBatch = 64;
+
+	static_assert(!Traits::DeferredReturn || Storage::LockFreeReads,
+		"Deferred return needs storage that can be read during growth (VirtualPoolTraits)");
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Forward iterator over live objects, free records are skipped.
+	///////////////////////////////////////////////////////////////////////////////////////
+	class Iterator final
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = T;
+		using difference_type = ptrdiff_t;
+		using pointer = T *;
+		using reference = T &;
+
+		Iterator(Pool *pool, PoolIndex index) : mPool(pool), mIndex(index) { }
+
+		T &operator*() const
+		{
+			return *mPool->mStorage.Object(mIndex);
+		}
+
+		T *operator->() const
+		{
+			return mPool->mStorage.Object(mIndex);
+		}
+
+		Iterator &operator++()
+		{
+			mIndex = mPool->mOccupancy.FindNext(mIndex + 1);
+			return *this;
+		}
+
+		Iterator operator++(int)
+		{
+			const auto copy = *this;
+			++*this;
+			return copy;
+		}
+
+		bool operator==(const Iterator &other) const noexcept
+		{
+			return mIndex == other.mIndex;
+		}
+
+		bool operator!=(const Iterator &other) const noexcept
+		{
+			return mIndex != other.mIndex;
+		}
+
+		///////////////////////////////////////////////////////////////////////////////////
+		/// Returns handle of current object
+		///////////////////////////////////////////////////////////////////////////////////
+		Handle GetHandle() const
+		{
+			return Handle(mIndex, mPool->mStorage.Stamp(mIndex));
+		}
+	private:
+		Pool *mPool;
+		PoolIndex mIndex;
+	};
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// @param baseSize - base count of preallocated objects in the pool
+	/// @param allocator - allocator of pool memory, see PoolHeapAllocator
+	///////////////////////////////////////////////////////////////////////////////////////
+	Pool(size_t baseSize, const Allocator &allocator = Allocator())
+		: mFreeRecords(allocator)
+		, mStorage(allocator)
+		, mOccupancy(allocator)
+	{
+		mCapacity = LimitCapacity(mStorage.Reserve(LimitCapacity(baseSize)));
+		mOccupancy.Resize(mCapacity);
+		ResizeFreeRecords(mCapacity);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// @param baseSize - base count of preallocated objects in the pool
+	/// @param memoryAlloc Memory allocation function
+	/// @param memoryFree Memory deallocation function. free by default
+	///
+	/// Available when allocator is PoolFunctionAllocator, default one.
+	///////////////////////////////////////////////////////////////////////////////////////
+	Pool(size_t baseSize, MemoryAllocFunc memoryAlloc, MemoryFreeFunc memoryFree = free)
+		: Pool(baseSize, Allocator(memoryAlloc, memoryFree))
+	{
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Destructor
+	///////////////////////////////////////////////////////////////////////////////////////
+	~Pool()
+	{
+		Clear();
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns handle to free object, or if pool is full allocates new object and returns
+	/// handle to it.
+	///
+	/// Throws std::bad_alloc when unable to allocate memory.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template <typename... Args>
+	Handle Spawn(Args &&... args)
+	{
+		// Every record is either live, retired or waits for readers
+		if (mSpawnedCount + mRetiredCount + this->GetPendingCount() == mCapacity 
+			&& TryReclaim(DeferredReturnTag()) == 0)
+		{
+			Grow();
+		}
+		const auto index = GetFreeIndex();
+		// Construct object via placement new.
+		T *object;
+		try
+		{
+			object = new (mStorage.Object(index)) T(std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			PushFreeIndex(index);
+			throw;
+		}
+		// Odd stamp marks busy record
+		const auto stamp = ++mStorage.Stamp(index);
+		mOccupancy.Set(index);
+		// For newly constructed object we have to check if it is derived from Poolable<T>
+		// and set pointer to this pool as owner. 
+		SetOwner(object, std::is_base_of<Poolable<T, Traits>, T>());
+		++mSpawnedCount;
+		this->CountSpawn(1, mSpawnedCount);
+		// Return handle to existing object.
+		return Handle{index, stamp};
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Will return object with 'handle' to the pool
+	/// Calls destructor of returnable object. Invalid handles are ignored, including
+	/// handles of records released by Trim.
+	///
+	/// When stamp of the record is about to wrap around, the record is retired: it is
+	/// never reused, so stale handles can not match new object in it.
+	///
+	/// With deferred return, handle becomes invalid at once, but object is destructed
+	/// and record is reused only after every reader has left read sections that could
+	/// see it (see Reclaim).
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Return(const Handle &handle)
+	{
+		const auto index = handle.GetIndex();
+		if (index >= mCapacity)
+		{
+			return;
+		}
+		auto &stamp = mStorage.Stamp(index);
+		// Handle of a free record must not return it twice
+		if (stamp == handle.GetStamp() && IsLivePoolStamp(stamp))
+		{
+			// Even stamp marks free record
+			++stamp;
+			mOccupancy.Reset(index);
+			--mSpawnedCount;
+			this->CountReturn(1);
+			ReleaseRecord(index, DeferredReturnTag());
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Spawns 'count' objects constructed from 'args' and writes their handles to
+	/// 'outHandles'. Arguments are passed to every constructor as lvalues, so they are
+	/// never moved from. Capacity is checked and grown once for the whole batch, 
+	/// never-used records are taken as one contiguous run before records from free list
+	/// (except for PoolReuse::LowestIndex, which takes records in order of index).
+	///
+	/// Throws std::bad_alloc when unable to allocate memory. If constructor throws,
+	/// objects spawned so far are returned and exception is rethrown.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template <typename... Args>
+	void SpawnN(size_t count, Handle *outHandles, Args &&... args)
+	{
+		auto busyCount = mSpawnedCount + mRetiredCount + this->GetPendingCount();
+		if (mCapacity - busyCount < count && TryReclaim(DeferredReturnTag()) != 0)
+		{
+			busyCount = mSpawnedCount + mRetiredCount + this->GetPendingCount();
+		}
+		while (mCapacity - busyCount < count)
+		{
+			Grow(busyCount + count);
+		}
+		size_t spawned = 0;
+		try
+		{
+			// Records above frontier need no free list traversal
+			const auto runLength = Traits::Reuse == PoolReuse::LowestIndex ? 0 
+				: count < mCapacity - mFrontier ? count : mCapacity - mFrontier;
+			for (; spawned < runLength; ++spawned)
+			{
+				outHandles[spawned] = Construct(mFrontier, args...);
+				++mFrontier;
+			}
+			for (; spawned < count; ++spawned)
+			{
+				const auto index = GetFreeIndex();
+				try
+				{
+					outHandles[spawned] = Construct(index, args...);
+				}
+				catch (...)
+				{
+					PushFreeIndex(index);
+					throw;
+				}
+			}
+		}
+		catch (...)
+		{
+			mSpawnedCount += spawned;
+			this->CountSpawn(spawned, mSpawnedCount);
+			ReturnN(outHandles, spawned);
+			throw;
+		}
+		mSpawnedCount += count;
+		this->CountSpawn(count, mSpawnedCount);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns 'count' objects to the pool, same as calling Return for each handle. 
+	/// Destructor loop is skipped for trivially destructible objects.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void ReturnN(const Handle *handles, size_t count)
+	{
+		size_t returned = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			const auto index = handles[i].GetIndex();
+			if (index >= mCapacity || mStorage.Stamp(index) != handles[i].GetStamp()
+				|| !IsLivePoolStamp(handles[i].GetStamp()))
+			{
+				continue;
+			}
+			// Even stamp marks free record
+			++mStorage.Stamp(index);
+			mOccupancy.Reset(index);
+			++returned;
+			ReleaseRecord(index, DeferredReturnTag());
+		}
+		mSpawnedCount -= returned;
+		this->CountReturn(returned);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Destructs every object in pool, frees memory that holds records. All refs 
+	/// will become invalid! With deferred return, objects that wait for readers are 
+	/// destructed too, so readers must not run concurrently.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Clear()
+	{
+		DestroyObjects();
+		DropPending(DeferredReturnTag());
+		mStorage.Release();
+		mOccupancy.Release();
+		// Clear free list
+		mFreeHead = FreeListEnd;
+		mFreeTail = FreeListEnd;
+		mFreeRecords.Release();
+		mFrontier = 0;
+		mCapacity = 0;
+		mSpawnedCount = 0;
+		mRetiredCount = 0;
+		mStampFloor = 0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Releases free records at the end of the pool, after the last live or retired 
+	/// record. Live objects keep their handles (contiguous and split storages move them
+	/// to a smaller block). Handles of released records stay invalid, even after pool 
+	/// grows over them again. Storage may keep some free records to release only whole
+	/// chunks or pages. Returns count of released records.
+	///
+	/// Throws std::bad_alloc when storage is unable to allocate smaller block.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t Trim()
+	{
+		TryReclaim(DeferredReturnTag());
+		const auto lastLive = mOccupancy.FindPrevious(mCapacity);
+		size_t end = lastLive == mCapacity ? 0 : lastLive + 1;
+		// Records that wait for readers are kept
+		const auto pendingEnd = GetPendingEnd(DeferredReturnTag());
+		if (pendingEnd > end)
+		{
+			end = pendingEnd;
+		}
+		// Retired records are never reused and can not be released
+		for (size_t index = mCapacity; index > end; --index)
+		{
+			if (static_cast<Stamp>(mStorage.Stamp(static_cast<PoolIndex>(index - 1)) + 1) == Handle::InvalidStamp)
+			{
+				end = index;
+				break;
+			}
+		}
+		if (end == mCapacity)
+		{
+			return 0;
+		}
+		// New records above 'end' will start from the largest stamp of released ones
+		for (size_t index = end; index < mCapacity; ++index)
+		{
+			const Stamp stamp = mStorage.Stamp(static_cast<PoolIndex>(index));
+			if (stamp > mStampFloor)
+			{
+				mStampFloor = stamp;
+			}
+		}
+		// Released records leave free list, records kept by storage go above frontier
+		if (Traits::Reuse == PoolReuse::LowestIndex)
+		{
+			mFreeRecords.Resize(end);
+		}
+		else
+		{
+			auto index = mFreeHead;
+			mFreeHead = FreeListEnd;
+			mFreeTail = FreeListEnd;
+			while (index != FreeListEnd)
+			{
+				const auto next = mStorage.NextFree(index);
+				if (index < end)
+				{
+					PushFreeIndex(index);
+				}
+				index = next;
+			}
+		}
+		mFrontier = static_cast<PoolIndex>(end);
+		const auto oldCapacity = mCapacity;
+		const auto capacity = LimitCapacity(mStorage.Shrink(end));
+		mOccupancy.Resize(capacity);
+		ResizeFreeRecords(capacity);
+		mCapacity = capacity;
+		return oldCapacity - mCapacity;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns true if 'handle' corresponds to object, that handle indexes.
+	///////////////////////////////////////////////////////////////////////////////////////	
+	bool IsValid(const Handle &handle) const noexcept
+	{
+		// Index is out of range for handles of records released by Trim
+		const bool valid = handle.GetIndex() < mCapacity 
+			&& handle.GetStamp() == mStorage.Stamp(handle.GetIndex());
+		this->CountValidation(valid);
+		return valid;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Checks 'count' handles at once, writes result for every handle into 'valid'.
+	/// Returns count of valid handles. Only stamps are read, so with SplitPoolTraits
+	/// objects are not pulled into cache.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t IsValid(const Handle *handles, size_t count, bool *valid) const noexcept
+	{
+		size_t validCount = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			valid[i] = IsValid(handles[i]);
+			validCount += valid[i];
+		}
+		return validCount;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Writes pointer to object of every of 'count' handles into 'objects', nullptr for
+	/// invalid handles. Returns count of valid handles. Stamp is checked and object is 
+	/// found in a single lookup, records of handles PrefetchDistance ahead are 
+	/// prefetched, so handles in any order cost less than IsValid plus At per handle.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t Resolve(const Handle *handles, size_t count, T **objects) const noexcept
+	{
+		size_t validCount = 0;
+		ForEachResolved(handles, count, [objects, &validCount](size_t i, T *object)
+		{
+			objects[i] = object;
+			validCount += object != nullptr;
+		});
+		return validCount;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Calls 'func(object)' for object of every valid handle of 'count' handles, in 
+	/// order of handles, invalid handles are skipped. Records are prefetched same as in
+	/// Resolve. 'func' must not spawn or return objects.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template<typename Func>
+	void ForEachHandle(const Handle *handles, size_t count, Func &&func) const
+	{
+		ForEachResolved(handles, count, [&func](size_t, T *object)
+		{
+			if (object)
+			{
+				func(*object);
+			}
+		});
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns reference to object by its handle
+	/// WARNING: You should check handle to validity thru IsValid before pass it to method, 
+	/// otherwise you might get wrong object (destructed, or object that already in use by
+	/// someone other), or even segfault if you pass handle with index out of bounds.
+	/// Checking handle is similar as checking pointer for "non-nullptr" before use it.
+	/// With deferred return, reader thread may use handle that was valid when its read
+	/// section started, see PoolEpochs.
+	///////////////////////////////////////////////////////////////////////////////////////
+	T &At(const Handle &handle) const
+	{
+		// Reader threads of deferred return pools call it during growth
+		assert(Traits::DeferredReturn || handle.GetIndex() < mCapacity);
+		return *mStorage.Object(handle.GetIndex());
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Same as At.
+	///////////////////////////////////////////////////////////////////////////////////////
+	T &operator[](const Handle &handle) const
+	{
+		return At(handle);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns count of objects that are already spawned.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetSpawnedCount() const noexcept
+	{
+		return mSpawnedCount;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns total capacity of this pool. 
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetCapacity() const noexcept
+	{
+		return mCapacity;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns count of records that were retired because their stamps ran out. 
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetRetiredCount() const noexcept
+	{
+		return mRetiredCount;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns counters collected since construction or ResetStats, along with current
+	/// count of live objects and capacity. Counters are zero unless Traits::CollectStats
+	/// is set.
+	///////////////////////////////////////////////////////////////////////////////////////
+	PoolStats GetStats() const noexcept
+	{
+		auto stats = this->GetCollectedStats();
+		stats.mLiveCount = mSpawnedCount;
+		stats.mCapacity = mCapacity;
+		return stats;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Zeroes collected counters
+	///////////////////////////////////////////////////////////////////////////////////////
+	void ResetStats() noexcept
+	{
+		this->ResetCollectedStats();
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns pointer to memory block that holds every record of this pool.
+	/// You should NEVER store returned pointer: its address may change by calling Spawn.
+	/// Available only for contiguous storage.
+	///////////////////////////////////////////////////////////////////////////////////////
+	Record *GetRecords() noexcept
+	{
+		return mStorage.GetRecords();
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// begin method for "range-based for". Iterates over live objects only.
+	///////////////////////////////////////////////////////////////////////////////////////
+	Iterator begin()
+	{
+		return Iterator(this, mOccupancy.FindNext(0));
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// end method for "range-based for".
+	///////////////////////////////////////////////////////////////////////////////////////
+	Iterator end()
+	{
+		return Iterator(this, mCapacity);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Calls 'func(object)' for every live object in order of indices. Occupancy bitmap 
+	/// is scanned a word at a time, so cost is proportional to count of live objects,
+	/// not to capacity. 'func' may return object it was called for, but must not spawn
+	/// new objects.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template<typename Func>
+	void ForEach(Func &&func)
+	{
+		mOccupancy.ForEachSet([this, &func](size_t index)
+		{
+			func(*mStorage.Object(index));
+		});
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Calls 'func(object)' for every live object on threads of default PoolThreadPool.
+	/// See ParallelForEach with executor.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template<typename Func>
+	void ParallelForEach(Func &&func, size_t grainSize = 4096)
+	{
+		ParallelForEach(func, grainSize, PoolThreadPool::GetDefault());
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Calls 'func(object)' for every live object in parallel. Records are split into
+	/// chunks of at least 'grainSize' records, rounded up to whole words of occupancy 
+	/// bitmap (64 records). Size of a chunk in bytes is then a multiple of cache line,
+	/// so with storage aligned to cache line (SplitPoolTraits<64>) neighbouring chunks
+	/// never share a line. Free records are skipped by bitmap scan inside of chunk.
+	///
+	/// 'executor(chunkCount, task)' must call 'task(chunk)' for every chunk in 
+	/// [0, chunkCount), possibly concurrently, and return when all calls are done.
+	/// PoolThreadPool is such executor. 'func' must not throw, spawn or return objects.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template<typename Func, typename Executor>
+	void ParallelForEach(Func &&func, size_t grainSize, Executor &&executor)
+	{
+		constexpr size_t BitsPerWord = PoolBitmap<Allocator>::BitsPerWord;
+		const auto wordCount = mOccupancy.GetWordCount();
+		const auto wordsPerChunk = grainSize > BitsPerWord ? (grainSize + BitsPerWord - 1) / BitsPerWord : 1;
+		const auto chunkCount = (wordCount + wordsPerChunk - 1) / wordsPerChunk;
+		executor(chunkCount, [this, &func, wordCount, wordsPerChunk](size_t chunk)
+		{
+			const auto firstWord = chunk * wordsPerChunk;
+			const auto lastWord = firstWord + wordsPerChunk < wordCount ? firstWord + wordsPerChunk : wordCount;
+			mOccupancy.ForEachSet(firstWord, lastWord, [this, &func](size_t index)
+			{
+				func(*mStorage.Object(index));
+			});
+		});
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Writes records, stamps, occupancy and free list state to file at 'path'. Pool
+	/// restored from the file by MapSnapshot accepts every handle of this pool. 
+	/// Returns false if file can not be written.
+	///
+	/// Available only for trivially copyable objects and storages with a single block of
+	/// records (contiguous and virtual).
+	///////////////////////////////////////////////////////////////////////////////////////
+	bool SaveSnapshot(const char *path) const
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Snapshot needs trivially copyable objects");
+		// Records waiting for readers are neither live nor free
+		assert(this->GetPendingCount() == 0);
+		PoolSnapshotHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.mMagic, PoolSnapshotHeader::GetMagic(), sizeof(header.mMagic));
+		header.mVersion = PoolSnapshotHeader::CurrentVersion;
+		header.mRecordSize = sizeof(Record);
+		header.mIndexBits = Traits::IndexBits;
+		header.mStampBits = Traits::StampBits;
+		header.mReuse = static_cast<uint32_t>(Traits::Reuse);
+		header.mCapacity = mCapacity;
+		header.mFrontier = mFrontier;
+		header.mFreeHead = mFreeHead;
+		header.mFreeTail = mFreeTail;
+		header.mSpawnedCount = mSpawnedCount;
+		header.mRetiredCount = mRetiredCount;
+		header.mStampFloor = mStampFloor;
+		header.mRecordsOffset = PoolSnapshotHeader::AlignOffset(sizeof(header));
+		header.mBitmapOffset = PoolSnapshotHeader::AlignOffset(header.mRecordsOffset + sizeof(Record) * mCapacity);
+		header.mBitmapWordCount = mOccupancy.GetWordCount();
+
+		FILE *file = fopen(path, "wb");
+		if (!file)
+		{
+			return false;
+		}
+		// Blocks are written in order, gaps between them are filled with zeros. No seeking,
+		// so offsets are not limited by 'long' of fseek.
+		static const char zeros[PoolSnapshotHeader::BlockAlignment] = { };
+		const size_t recordsBytes = sizeof(Record) * mCapacity;
+		bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+		written = written && fwrite(zeros, 1, header.mRecordsOffset - sizeof(header), file) 
+			== header.mRecordsOffset - sizeof(header);
+		written = written && fwrite(mStorage.GetRecords(), sizeof(Record), mCapacity, file) == mCapacity;
+		written = written && fwrite(zeros, 1, header.mBitmapOffset - header.mRecordsOffset - recordsBytes, file) 
+			== header.mBitmapOffset - header.mRecordsOffset - recordsBytes;
+		written = written && fwrite(mOccupancy.GetWords(), sizeof(uint64_t), 
+			header.mBitmapWordCount, file) == header.mBitmapWordCount;
+		return fclose(file) == 0 && written;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Replaces content of this pool with snapshot from file at 'path'. Records are not
+	/// parsed or copied: file is mapped with copy-on-write pages, so changes never reach
+	/// the file. Growth moves records from the mapping to regular memory. Returns false
+	/// and keeps pool untouched if file is missing or was saved by pool of other type.
+	///
+	/// Available only for trivially copyable objects and contiguous storage. On Windows
+	/// records are read into memory instead of mapping.
+	///////////////////////////////////////////////////////////////////////////////////////
+	bool MapSnapshot(const char *path)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Snapshot needs trivially copyable objects");
+#if defined(_WIN32)
+		FILE *file = fopen(path, "rb");
+		if (!file)
+		{
+			return false;
+		}
+		_fseeki64(file, 0, SEEK_END);
+		const auto size = static_cast<size_t>(_ftelli64(file));
+		_fseeki64(file, 0, SEEK_SET);
+		const auto mapping = static_cast<char *>(malloc(size ? size : 1));
+		if (!mapping)
+		{
+			fclose(file);
+			throw std::bad_alloc();
+		}
+		const bool read = fread(mapping, 1, size, file) == size;
+		fclose(file);
+		const auto unmap = [&] { free(mapping); };
+		if (!read)
+		{
+			unmap();
+			return false;
+		}
+#else
+		const int file = open(path, O_RDONLY);
+		if (file < 0)
+		{
+			return false;
+		}
+		struct stat info;
+		if (fstat(file, &info) != 0 || info.st_size == 0)
+		{
+			close(file);
+			return false;
+		}
+		const auto size = static_cast<size_t>(info.st_size);
+		const auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+		close(file);
+		if (memory == MAP_FAILED)
+		{
+			return false;
+		}
+		const auto mapping = static_cast<char *>(memory);
+		const auto unmap = [&] { munmap(memory, size); };
+#endif
+		PoolSnapshotHeader header;
+		if (size < sizeof(header))
+		{
+			unmap();
+			return false;
+		}
+		memcpy(&header, mapping, sizeof(header));
+		// File may be truncated or damaged: header fields are checked before use, bounds
+		// are checked without overflow
+		constexpr size_t BitsPerWord = PoolBitmap<Allocator>::BitsPerWord;
+		const bool compatible = memcmp(header.mMagic, PoolSnapshotHeader::GetMagic(), sizeof(header.mMagic)) == 0
+			&& header.mVersion == PoolSnapshotHeader::CurrentVersion
+			&& header.mRecordSize == sizeof(Record)
+			&& header.mIndexBits == Traits::IndexBits
+			&& header.mStampBits == Traits::StampBits
+			&& header.mReuse == static_cast<uint32_t>(Traits::Reuse)
+			&& header.mCapacity <= MaxCapacity
+			&& header.mFrontier <= header.mCapacity
+			&& (header.mFreeHead == FreeListEnd || header.mFreeHead < header.mCapacity)
+			&& (header.mFreeTail == FreeListEnd || header.mFreeTail < header.mCapacity)
+			&& header.mSpawnedCount <= header.mCapacity
+			&& header.mRetiredCount <= header.mCapacity - header.mSpawnedCount
+			&& header.mRecordsOffset % alignof(Record) == 0
+			&& header.mRecordsOffset <= size
+			&& header.mCapacity <= (size - header.mRecordsOffset) / sizeof(Record)
+			&& header.mBitmapWordCount == (header.mCapacity + BitsPerWord - 1) / BitsPerWord
+			&& header.mBitmapOffset <= size
+			&& header.mBitmapWordCount <= (size - header.mBitmapOffset) / sizeof(uint64_t)
+			&& IsSnapshotConsistent(header, reinterpret_cast<const Record *>(mapping + header.mRecordsOffset),
+				mapping + header.mBitmapOffset);
+		if (!compatible)
+		{
+			unmap();
+			return false;
+		}
+
+		Clear();
+		mOccupancy.Resize(static_cast<size_t>(header.mCapacity));
+		memcpy(mOccupancy.GetWords(), mapping + header.mBitmapOffset, sizeof(uint64_t) * header.mBitmapWordCount);
+#if defined(_WIN32)
+		// Records are moved to memory of exact size, file contents are dropped
+		mStorage.Reserve(static_cast<size_t>(header.mCapacity));
+		memcpy(static_cast<void *>(mStorage.GetRecords()), mapping + header.mRecordsOffset,
+			sizeof(Record) * header.mCapacity);
+		unmap();
+#else
+		mStorage.AdoptMapping(reinterpret_cast<Record *>(mapping + header.mRecordsOffset),
+			static_cast<size_t>(header.mCapacity), memory, size);
+#endif
+		mCapacity = static_cast<size_t>(header.mCapacity);
+		mFrontier = header.mFrontier;
+		mFreeHead = static_cast<Link>(header.mFreeHead);
+		mFreeTail = static_cast<Link>(header.mFreeTail);
+		mSpawnedCount = static_cast<size_t>(header.mSpawnedCount);
+		mRetiredCount = static_cast<size_t>(header.mRetiredCount);
+		mStampFloor = static_cast<Stamp>(header.mStampFloor);
+		if (Traits::Reuse == PoolReuse::LowestIndex)
+		{
+			// Returned records are free records below frontier, except retired ones
+			ResizeFreeRecords(mCapacity);
+			for (size_t index = 0; index < mFrontier; ++index)
+			{
+				const Stamp stamp = mStorage.Stamp(static_cast<PoolIndex>(index));
+				if (!IsLivePoolStamp(stamp) && static_cast<Stamp>(stamp + 1) != Handle::InvalidStamp)
+				{
+					mFreeRecords.Insert(index);
+				}
+			}
+		}
+		return true;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Checks occupancy and free list of snapshot against its validated header: live
+	/// records lie below frontier and their count matches, free list links stay below
+	/// frontier, point to free records, end at the tail and make no cycle. Stamps and
+	/// objects of live records are trusted, checking them would read every page.
+	///////////////////////////////////////////////////////////////////////////////////////
+	static bool IsSnapshotConsistent(const PoolSnapshotHeader &header, const Record *records,
+		const char *bitmap) noexcept
+	{
+		constexpr uint64_t BitsPerWord = PoolBitmap<Allocator>::BitsPerWord;
+		uint64_t spawnedCount = 0;
+		for (uint64_t i = 0; i < header.mBitmapWordCount; ++i)
+		{
+			uint64_t word;
+			memcpy(&word, bitmap + sizeof(word) * i, sizeof(word));
+			const auto first = i * BitsPerWord;
+			if (first + BitsPerWord > header.mFrontier
+				&& (word >> (first < header.mFrontier ? header.mFrontier - first : 0)) != 0)
+			{
+				return false;
+			}
+			spawnedCount += PoolPopCount(word);
+		}
+		if (spawnedCount != header.mSpawnedCount)
+		{
+			return false;
+		}
+		if (Traits::Reuse == PoolReuse::LowestIndex)
+		{
+			// Free records are not linked
+			return true;
+		}
+		auto link = header.mFreeHead;
+		uint64_t last = FreeListEnd;
+		for (uint64_t steps = 0; link != FreeListEnd; ++steps)
+		{
+			if (link >= header.mFrontier || steps >= header.mFrontier
+				|| IsLivePoolStamp(static_cast<Stamp>(records[link].mStamp)))
+			{
+				return false;
+			}
+			last = link;
+			link = records[link].mNextFree;
+		}
+		return last == header.mFreeTail;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns epochs of reader threads. Available only with deferred return.
+	///////////////////////////////////////////////////////////////////////////////////////
+	PoolEpochs &GetEpochs() noexcept
+	{
+		static_assert(Traits::DeferredReturn, "Epochs are available only with deferred return");
+		return this->mEpochs;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Tries to advance epoch, then destructs returned objects that no reader can see
+	/// anymore and makes their records free. Return calls it every ReclaimBatch returns
+	/// and Spawn calls it before growth. Returns count of reclaimed records. Available
+	/// only with deferred return.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t Reclaim()
+	{
+		static_assert(Traits::DeferredReturn, "Reclaim is available only with deferred return");
+		auto &pending = this->mPending;
+		auto epoch = this->mEpochs.TryAdvance();
+		if (!pending.empty() && pending.front().mEpoch + 2 > epoch)
+		{
+			// Second step is free when readers are idle or quick
+			epoch = this->mEpochs.TryAdvance();
+		}
+		size_t count = 0;
+		while (count < pending.size() && pending[count].mEpoch + 2 <= epoch)
+		{
+			const auto index = pending[count].mIndex;
+			mStorage.Object(index)->~T();
+			RecycleRecord(index);
+			++count;
+		}
+		pending.erase(pending.begin(), pending.begin() + static_cast<ptrdiff_t>(count));
+		return count;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns count of returned objects that wait for readers. Always zero without 
+	/// deferred return.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetPendingCount() const noexcept
+	{
+		return PoolDeferredReturn<Traits::DeferredReturn>::GetPendingCount();
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Use this only to obtain handle by 'this' pointer inside class method.
+	/// Note: Do not rely on pointers to objects in pool, they can suddenly become
+	/// invalid (unless storage has stable addresses). 'this' pointer can be used, because
+	/// it is always valid. Returns invalid handle for memory of a free record.
+	///////////////////////////////////////////////////////////////////////////////////////
+	Handle HandleByPointer(T * const ptr)
+	{
+		PoolIndex index;
+		if (!mStorage.IndexOf(ptr, index) || index >= mCapacity)
+		{
+			return Handle();
+		}
+		const Stamp stamp = mStorage.Stamp(index);
+		return IsLivePoolStamp(stamp) ? Handle(index, stamp) : Handle();
+	}
+private:
+	/// Marks end of free list
+	static constexpr Link FreeListEnd = static_cast<Link>(~uint64_t(0));
+
+	/// Largest capacity allowed by handle and by growth policy
+	static constexpr size_t CapacityLimit = 
+		MaxCapacity < Growth::CapacityLimit ? MaxCapacity : Growth::CapacityLimit;
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Clamps capacity to count of records, that handle can index and growth policy 
+	/// allows
+	///////////////////////////////////////////////////////////////////////////////////////
+	static size_t LimitCapacity(size_t capacity) noexcept
+	{
+		return capacity < CapacityLimit ? capacity : CapacityLimit;
+	}
+
+	void SetOwner(T *object, std::true_type) noexcept
+	{
+		static_cast<Poolable<T, Traits>*>(object)->mOwner = this;
+	}
+
+	void SetOwner(T *, std::false_type) noexcept
+	{
+	}
+
+	using DeferredReturnTag = std::integral_constant<bool, Traits::DeferredReturn>;
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Destructs object of returned record and makes record free. Record is already
+	/// marked free by stamp and occupancy.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void ReleaseRecord(PoolIndex index, std::false_type) noexcept
+	{
+		if (!std::is_trivially_destructible<T>::value)
+		{
+			mStorage.Object(index)->~T();
+		}
+		RecycleRecord(index);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Keeps returned record until readers of current epoch are done with it
+	///////////////////////////////////////////////////////////////////////////////////////
+	void ReleaseRecord(PoolIndex index, std::true_type)
+	{
+		this->mPending.push_back({ index, this->mEpochs.GetEpoch() });
+		if (this->mPending.size() % ReclaimBatch == 0)
+		{
+			Reclaim();
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Registers destructed record as free, or retires it when its stamp ran out
+	///////////////////////////////////////////////////////////////////////////////////////
+	void RecycleRecord(PoolIndex index) noexcept
+	{
+		if (static_cast<Stamp>(mStorage.Stamp(index) + 1) == Handle::InvalidStamp)
+		{
+			++mRetiredCount;
+		}
+		else
+		{
+			PushFreeIndex(index);
+		}
+	}
+
+	size_t TryReclaim(std::false_type) noexcept
+	{
+		return 0;
+	}
+
+	size_t TryReclaim(std::true_type)
+	{
+		return Reclaim();
+	}
+
+	size_t GetPendingEnd(std::false_type) const noexcept
+	{
+		return 0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns index of the last record that waits for readers plus one
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetPendingEnd(std::true_type) const noexcept
+	{
+		size_t end = 0;
+		for (const auto &record : this->mPending)
+		{
+			if (record.mIndex >= end)
+			{
+				end = record.mIndex + 1;
+			}
+		}
+		return end;
+	}
+
+	void DropPending(std::false_type) noexcept
+	{
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Destructs objects that wait for readers, regardless of readers
+	///////////////////////////////////////////////////////////////////////////////////////
+	void DropPending(std::true_type) noexcept
+	{
+		for (const auto &record : this->mPending)
+		{
+			mStorage.Object(record.mIndex)->~T();
+		}
+		this->mPending.clear();
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Grows storage when there are no free records left. Requests at least 
+	/// 'minCapacity' records, storage may give less (one chunk of segmented storage).
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Grow(size_t minCapacity = 0)
+	{
+		if (mCapacity >= CapacityLimit)
+		{
+			throw std::bad_alloc();
+		}
+		size_t requested = Growth::GetNextCapacity(mCapacity);
+		if (requested < minCapacity)
+		{
+			requested = minCapacity;
+		}
+		// Relocating storage moves every live object
+		const auto bytesMoved = Storage::StableAddresses ? 0 : sizeof(T) * mSpawnedCount;
+		this->MeasureGrowth(bytesMoved, [this, requested]
+		{
+			// New records are above frontier, so they are free without registration
+			const auto oldCapacity = mCapacity;
+			mCapacity = LimitCapacity(mStorage.Grow(LimitCapacity(requested)));
+			mOccupancy.Resize(mCapacity);
+			ResizeFreeRecords(mCapacity);
+			if (mStampFloor != 0)
+			{
+				// Stale handles of records released by Trim must not match new objects
+				for (size_t index = oldCapacity; index < mCapacity; ++index)
+				{
+					mStorage.Stamp(static_cast<PoolIndex>(index)) = mStampFloor;
+				}
+			}
+		});
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Constructs object in free record with 'index', that is already taken off free 
+	/// list, and marks record busy. Spawned count is updated by caller.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template <typename... Args>
+	Handle Construct(PoolIndex index, Args &&... args)
+	{
+		T *object = new (mStorage.Object(index)) T(args...);
+		// Odd stamp marks busy record
+		const auto stamp = ++mStorage.Stamp(index);
+		mOccupancy.Set(index);
+		SetOwner(object, std::is_base_of<Poolable<T, Traits>, T>());
+		return Handle{index, stamp};
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Calls 'func(i, object)' for every of 'count' handles, object is nullptr when i-th
+	/// handle is invalid. Prefetches record PrefetchDistance handles ahead.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template<typename Func>
+	void ForEachResolved(const Handle *handles, size_t count, Func &&func) const
+	{
+		constexpr size_t distance = Traits::PrefetchDistance;
+		for (size_t i = 0; i < distance && i < count; ++i)
+		{
+			PrefetchRecord(handles[i]);
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (distance != 0 && i + distance < count)
+			{
+				PrefetchRecord(handles[i + distance]);
+			}
+			const auto index = handles[i].GetIndex();
+			const bool valid = index < mCapacity && handles[i].GetStamp() == mStorage.Stamp(index);
+			this->CountValidation(valid);
+			func(i, valid ? mStorage.Object(index) : nullptr);
+		}
+	}
+
+	void PrefetchRecord(const Handle &handle) const noexcept
+	{
+		// Index may be out of range for handles of released records
+		if (handle.GetIndex() < mCapacity)
+		{
+			mStorage.Prefetch(handle.GetIndex());
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Calls destructors for every spawned object
+	///////////////////////////////////////////////////////////////////////////////////////
+	void DestroyObjects()
+	{
+		// Destruct only busy objects, not the free ones (they are already destructed).
+		// Destructor may return other objects of the same word, so bit is checked again.
+		mOccupancy.ForEachSet([this](size_t index)
+		{
+			if (mOccupancy.Test(index))
+			{
+				mStorage.Object(index)->~T();
+			}
+		});
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns index of next free record. Records that were never used are handed out
+	/// first, then returned ones in order of reuse policy. With LowestIndex policy, 
+	/// returned records come first, in order of index.
+	///////////////////////////////////////////////////////////////////////////////////////
+	PoolIndex GetFreeIndex() noexcept
+	{
+		if (Traits::Reuse == PoolReuse::LowestIndex)
+		{
+			// Returned records are below frontier
+			const auto index = mFreeRecords.PopLowest();
+			return index < mFrontier ? static_cast<PoolIndex>(index) : mFrontier++;
+		}
+		if (mFrontier < mCapacity)
+		{
+			return mFrontier++;
+		}
+		const auto index = mFreeHead;
+		mFreeHead = mStorage.NextFree(index);
+		if (mFreeHead == FreeListEnd)
+		{
+			mFreeTail = FreeListEnd;
+		}
+		return index;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Registers record with 'index' as free: appends it to the end of free list (Fifo),
+	/// prepends it (Lifo) or sets its bit (LowestIndex). Record must be destructed.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void PushFreeIndex(PoolIndex index) noexcept
+	{
+		if (Traits::Reuse == PoolReuse::LowestIndex)
+		{
+			mFreeRecords.Insert(index);
+			return;
+		}
+		const auto link = static_cast<Link>(index);
+		if (Traits::Reuse == PoolReuse::Lifo)
+		{
+			mStorage.NextFree(index) = mFreeHead;
+			if (mFreeHead == FreeListEnd)
+			{
+				mFreeTail = link;
+			}
+			mFreeHead = link;
+			return;
+		}
+		mStorage.NextFree(index) = FreeListEnd;
+		if (mFreeTail == FreeListEnd)
+		{
+			mFreeHead = link;
+		}
+		else
+		{
+			mStorage.NextFree(mFreeTail) = link;
+		}
+		mFreeTail = link;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Resizes set of returned records, which is used only by LowestIndex policy
+	///////////////////////////////////////////////////////////////////////////////////////
+	void ResizeFreeRecords(size_t capacity)
+	{
+		if (Traits::Reuse == PoolReuse::LowestIndex)
+		{
+			mFreeRecords.Resize(capacity);
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	// Internals
+	///////////////////////////////////////////////////////////////////////////////////////
+
+	size_t mSpawnedCount { 0 };
+	size_t mRetiredCount { 0 };
+	/// Read by reader threads with deferred return
+	PoolSharedValue<size_t, Traits::DeferredReturn> mCapacity { 0 };
+	/// Every record with index at or above frontier has never been used
+	PoolIndex mFrontier { 0 };
+	/// Intrusive list of returned records, linked through record storage
+	Link mFreeHead { FreeListEnd };
+	Link mFreeTail { FreeListEnd };
+	/// Returned records, used only by LowestIndex policy
+	PoolIndexSet<Allocator> mFreeRecords;
+	/// Even stamp of records added on growth, the largest stamp of records released by
+	/// Trim
+	Stamp mStampFloor { 0 };
+	Storage mStorage;
+	/// Bit per record, set for records with live objects
+	PoolBitmap<Allocator> mOccupancy;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Pool that keeps live objects densely packed at the front of a single array. Handles
+/// index a sparse table of slots, slot of live object holds position of the object in 
+/// the dense array. When object is returned, the last object is moved into its place,
+/// so there are never holes and iteration is a plain loop over the dense array.
+///
+/// Objects move on Return, Compact and ShrinkToFit, handles stay valid. T must be 
+/// nothrow move constructible.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename T, typename Traits = PoolTraits>
+class DensePool final
+{
+public:
+	typedef void* (*MemoryAllocFunc)(size_t size);
+	typedef void (*MemoryFreeFunc)(void* ptr);
+	using Handle = PoolHandle<T, Traits::IndexBits, Traits::StampBits>;
+	using Stamp = typename Handle::Stamp;
+	using Link = PoolUInt<Traits::IndexBits>;
+	using Allocator = typename Traits::Allocator;
+
+	/// Max count of slots, the largest index is reserved for end of free list
+	static constexpr size_t MaxCapacity = static_cast<size_t>(
+		~uint64_t(0) >> (64 - Traits::IndexBits)) - (Traits::IndexBits < 64 ? 0 : 1);
+
+	static_assert(std::is_nothrow_move_constructible<T>::value,
+		"Objects of DensePool must be nothrow move constructible");
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// @param baseSize - base count of preallocated objects in the pool
+	/// @param allocator - allocator of pool memory, see PoolHeapAllocator
+	///////////////////////////////////////////////////////////////////////////////////////
+	DensePool(size_t baseSize, const Allocator &allocator = Allocator())
+		: mAllocator(allocator)
+	{
+		baseSize = LimitCapacity(baseSize);
+		if (baseSize != 0)
+		{
+			GrowSlots(baseSize);
+			Relocate(baseSize, false);
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// @param baseSize - base count of preallocated objects in the pool
+	/// @param memoryAlloc Memory allocation function
+	/// @param memoryFree Memory deallocation function. free by default
+	///
+	/// Available when allocator is PoolFunctionAllocator, default one.
+	///////////////////////////////////////////////////////////////////////////////////////
+	DensePool(size_t baseSize, MemoryAllocFunc memoryAlloc, MemoryFreeFunc memoryFree = free)
+		: DensePool(baseSize, Allocator(memoryAlloc, memoryFree))
+	{
+	}
+
+	DensePool(const DensePool&) = delete;
+	DensePool& operator=(const DensePool&) = delete;
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Destructor
+	///////////////////////////////////////////////////////////////////////////////////////
+	~DensePool()
+	{
+		Clear();
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Constructs new object at the end of dense array and returns handle to it. Grows
+	/// slot table or dense array when either is full.
+	///
+	/// Throws std::bad_alloc when unable to allocate memory.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template <typename... Args>
+	Handle Spawn(Args &&... args)
+	{
+		if (mFreeHead == FreeListEnd && mFrontier == mCapacity)
+		{
+			if (mCapacity >= CapacityLimit)
+			{
+				throw std::bad_alloc();
+			}
+			GrowSlots(NextCapacity(mCapacity));
+		}
+		if (mCount == mDenseCapacity)
+		{
+			Relocate(NextCapacity(mDenseCapacity), false);
+		}
+		// Object is constructed before slot is taken, so throwing constructor leaves
+		// pool untouched
+		new (mObjects + mCount) T(std::forward<Args>(args)...);
+		const auto index = GetFreeIndex();
+		auto &slot = mSlots[index];
+		// Odd stamp marks busy slot
+		const auto stamp = ++slot.mStamp;
+		slot.mLink = static_cast<Link>(mCount);
+		mDenseToSlot[mCount] = static_cast<Link>(index);
+		++mCount;
+		return Handle { index, stamp };
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Destructs object with 'handle' and moves the last object into its place. Invalid
+	/// handles are ignored. Slots whose stamps are about to wrap around are retired, 
+	/// same as in Pool.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Return(const Handle &handle)
+	{
+		const auto index = handle.GetIndex();
+		if (index >= mCapacity)
+		{
+			return;
+		}
+		auto &slot = mSlots[index];
+		if (slot.mStamp != handle.GetStamp())
+		{
+			return;
+		}
+		// Even stamp marks free slot
+		++slot.mStamp;
+		const auto position = slot.mLink;
+		const auto last = mCount - 1;
+		mObjects[position].~T();
+		if (position != last)
+		{
+			new (mObjects + position) T(std::move(mObjects[last]));
+			mObjects[last].~T();
+			mDenseToSlot[position] = mDenseToSlot[last];
+			mSlots[mDenseToSlot[position]].mLink = position;
+		}
+		--mCount;
+		if (static_cast<Stamp>(slot.mStamp + 1) == Handle::InvalidStamp)
+		{
+			++mRetiredCount;
+		}
+		else
+		{
+			PushFreeIndex(index);
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Destructs every object in pool, frees memory of slots and objects. All handles 
+	/// will become invalid!
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Clear()
+	{
+		for (size_t i = 0; i < mCount; ++i)
+		{
+			mObjects[i].~T();
+		}
+		if (mSlots)
+		{
+			mAllocator.Deallocate(mSlots, sizeof(Slot) * mCapacity, alignof(Slot));
+		}
+		FreeDense();
+		mSlots = nullptr;
+		mObjects = nullptr;
+		mDenseToSlot = nullptr;
+		mFreeHead = FreeListEnd;
+		mFreeTail = FreeListEnd;
+		mFrontier = 0;
+		mCapacity = 0;
+		mDenseCapacity = 0;
+		mCount = 0;
+		mRetiredCount = 0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Moves objects into new block that fits them exactly, in order of their handle 
+	/// indices, so walking handles in index order walks objects forward. Tail of the old
+	/// block is given back to the allocator.
+	///
+	/// Throws std::bad_alloc when unable to allocate memory.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Compact()
+	{
+		Relocate(mCount, true);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Moves objects into new block that fits them exactly, order of objects is kept.
+	/// Tail of the old block is given back to the allocator.
+	///
+	/// Throws std::bad_alloc when unable to allocate memory.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void ShrinkToFit()
+	{
+		if (mCount != mDenseCapacity)
+		{
+			Relocate(mCount, false);
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns true if 'handle' corresponds to object, that handle indexes.
+	///////////////////////////////////////////////////////////////////////////////////////
+	bool IsValid(const Handle &handle) const noexcept
+	{
+		return handle.GetIndex() < mCapacity && handle.GetStamp() == mSlots[handle.GetIndex()].mStamp;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns reference to object by its handle. Handle must be valid, see Pool::At.
+	///////////////////////////////////////////////////////////////////////////////////////
+	T &At(const Handle &handle) const
+	{
+		assert(IsValid(handle));
+		return mObjects[mSlots[handle.GetIndex()].mLink];
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Same as At.
+	///////////////////////////////////////////////////////////////////////////////////////
+	T &operator[](const Handle &handle) const
+	{
+		return At(handle);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns handle of object at 'position' in dense array
+	///////////////////////////////////////////////////////////////////////////////////////
+	Handle GetHandle(size_t position) const noexcept
+	{
+		assert(position < mCount);
+		const auto index = mDenseToSlot[position];
+		return Handle(index, mSlots[index].mStamp);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns handle of object by pointer to it, or invalid handle if pointer is not
+	/// in the dense array.
+	///////////////////////////////////////////////////////////////////////////////////////
+	Handle HandleByPointer(const T *ptr) const noexcept
+	{
+		if (ptr < mObjects || ptr >= mObjects + mCount)
+		{
+			return Handle();
+		}
+		return GetHandle(static_cast<size_t>(ptr - mObjects));
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns count of objects that are already spawned.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetSpawnedCount() const noexcept
+	{
+		return mCount;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns count of slots, which is max index of handle plus one.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetCapacity() const noexcept
+	{
+		return mCapacity;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns count of objects that dense array can hold without growth.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetDenseCapacity() const noexcept
+	{
+		return mDenseCapacity;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns count of slots that were retired because their stamps ran out. 
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetRetiredCount() const noexcept
+	{
+		return mRetiredCount;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns dense array of live objects. You should NEVER store returned pointer:
+	/// objects move on Spawn and Return.
+	///////////////////////////////////////////////////////////////////////////////////////
+	T *GetObjects() const noexcept
+	{
+		return mObjects;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// begin method for "range-based for". There are no holes, so iterator is a pointer.
+	///////////////////////////////////////////////////////////////////////////////////////
+	T *begin() const noexcept
+	{
+		return mObjects;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// end method for "range-based for".
+	///////////////////////////////////////////////////////////////////////////////////////
+	T *end() const noexcept
+	{
+		return mObjects + mCount;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Calls 'func(object)' for every live object. 'func' must not spawn or return 
+	/// objects.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template<typename Func>
+	void ForEach(Func &&func)
+	{
+		for (size_t i = 0; i < mCount; ++i)
+		{
+			func(mObjects[i]);
+		}
+	}
+private:
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Entry of sparse table: link is position of object in dense array when slot is 
+	/// busy and index of next free slot when slot is free.
+	///////////////////////////////////////////////////////////////////////////////////////
+	struct Slot
+	{
+		Stamp mStamp;
+		Link mLink;
+	};
+
+	/// Marks end of free list
+	static constexpr Link FreeListEnd = static_cast<Link>(~uint64_t(0));
+	/// Largest capacity allowed by handle and by growth policy
+	static constexpr size_t CapacityLimit = 
+		MaxCapacity < Traits::Growth::CapacityLimit ? MaxCapacity : Traits::Growth::CapacityLimit;
+
+	static size_t LimitCapacity(size_t capacity) noexcept
+	{
+		return capacity < CapacityLimit ? capacity : CapacityLimit;
+	}
+
+	static size_t NextCapacity(size_t capacity) noexcept
+	{
+		return LimitCapacity(Traits::Growth::GetNextCapacity(capacity));
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Grows sparse table to 'capacity' slots. Slots are trivially copyable.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void GrowSlots(size_t capacity)
+	{
+		assert(capacity > mCapacity);
+		mSlots = static_cast<Slot *>(PoolReallocate(mAllocator, mSlots, sizeof(Slot) * mCapacity,
+			sizeof(Slot) * capacity, alignof(Slot)));
+		// Zero stamp marks free slot that has never been used
+		memset(mSlots + mCapacity, 0, sizeof(Slot) * (capacity - mCapacity));
+		mCapacity = capacity;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Moves objects into new dense array of 'capacity' objects. When 'ordered' is set, 
+	/// objects are placed in order of their slot indices.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Relocate(size_t capacity, bool ordered)
+	{
+		assert(capacity >= mCount);
+		T *objects = nullptr;
+		Link *denseToSlot = nullptr;
+		if (capacity != 0)
+		{
+			objects = static_cast<T *>(mAllocator.Allocate(sizeof(T) * capacity, alignof(T)));
+			try
+			{
+				denseToSlot = static_cast<Link *>(mAllocator.Allocate(sizeof(Link) * capacity, alignof(Link)));
+			}
+			catch (...)
+			{
+				mAllocator.Deallocate(objects, sizeof(T) * capacity, alignof(T));
+				throw;
+			}
+		}
+		size_t position = 0;
+		const auto moveObject = [&](size_t from)
+		{
+			const auto index = mDenseToSlot[from];
+			new (objects + position) T(std::move(mObjects[from]));
+			mObjects[from].~T();
+			denseToSlot[position] = index;
+			mSlots[index].mLink = static_cast<Link>(position);
+			++position;
+		};
+		if (ordered)
+		{
+			// Only slots below frontier have ever been used
+			for (size_t index = 0; index < mFrontier; ++index)
+			{
+				if (IsLivePoolStamp(mSlots[index].mStamp))
+				{
+					moveObject(mSlots[index].mLink);
+				}
+			}
+		}
+		else
+		{
+			PoolRelocate(objects, mObjects, mCount);
+			if (mCount != 0)
+			{
+				memcpy(denseToSlot, mDenseToSlot, sizeof(Link) * mCount);
+			}
+		}
+		FreeDense();
+		mObjects = objects;
+		mDenseToSlot = denseToSlot;
+		mDenseCapacity = capacity;
+	}
+
+	void FreeDense() noexcept
+	{
+		if (mObjects)
+		{
+			mAllocator.Deallocate(mObjects, sizeof(T) * mDenseCapacity, alignof(T));
+			mAllocator.Deallocate(mDenseToSlot, sizeof(Link) * mDenseCapacity, alignof(Link));
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns index of next free slot, same order as in Pool
+	///////////////////////////////////////////////////////////////////////////////////////
+	PoolIndex GetFreeIndex() noexcept
+	{
+		if (mFrontier < mCapacity)
+		{
+			return mFrontier++;
+		}
+		const auto index = mFreeHead;
+		mFreeHead = mSlots[index].mLink;
+		if (mFreeHead == FreeListEnd)
+		{
+			mFreeTail = FreeListEnd;
+		}
+		return index;
+	}
+
+	void PushFreeIndex(PoolIndex index) noexcept
+	{
+		const auto link = static_cast<Link>(index);
+		mSlots[index].mLink = FreeListEnd;
+		if (mFreeTail == FreeListEnd)
+		{
+			mFreeHead = link;
+		}
+		else
+		{
+			mSlots[mFreeTail].mLink = link;
+		}
+		mFreeTail = link;
+	}
+
+	Slot *mSlots { nullptr };
+	T *mObjects { nullptr };
+	/// Slot index of every object in dense array
+	Link *mDenseToSlot { nullptr };
+	size_t mCapacity { 0 };
+	size_t mDenseCapacity { 0 };
+	size_t mCount { 0 };
+	size_t mRetiredCount { 0 };
+	/// Every slot with index at or above frontier has never been used
+	PoolIndex mFrontier { 0 };
+	Link mFreeHead { FreeListEnd };
+	Link mFreeTail { FreeListEnd };
+	Allocator mAllocator;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Pool of tree nodes, such as scene graph nodes, that keeps live objects densely 
+/// packed in topological order: every parent is placed before its children. Updates 
+/// that flow from parents to children (global transforms) become a single forward 
+/// sweep over the dense array, parent of every object is found by its position, so 
+/// there is neither recursion nor handle lookups.
+///
+/// Handles index a sparse table of slots, same as in DensePool. New nodes are appended
+/// to the dense array. Return and SetParent repair order by moving objects after the
+/// affected node, relative order of all other objects is kept.
+///
+/// Objects move on Return and SetParent, handles stay valid. T must be nothrow move 
+/// constructible.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename T, typename Traits = PoolTraits>
+class HierarchyPool final
+{
+public:
+	typedef void* (*MemoryAllocFunc)(size_t size);
+	typedef void (*MemoryFreeFunc)(void* ptr);
+	using Handle = PoolHandle<T, Traits::IndexBits, Traits::StampBits>;
+	using Stamp = typename Handle::Stamp;
+	using Link = PoolUInt<Traits::IndexBits>;
+	using Allocator = typename Traits::Allocator;
+
+	/// Max count of slots, the largest index is reserved for end of free list
+	static constexpr size_t MaxCapacity = static_cast<size_t>(
+		~uint64_t(0) >> (64 - Traits::IndexBits)) - (Traits::IndexBits < 64 ? 0 : 1);
+
+	/// Parent position of root objects
+	static constexpr Link NoParent = static_cast<Link>(~uint64_t(0));
+
+	static_assert(std::is_nothrow_move_constructible<T>::value,
+		"Objects of HierarchyPool must be nothrow move constructible");
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// @param baseSize - base count of preallocated objects in the pool
+	/// @param allocator - allocator of pool memory, see PoolHeapAllocator
+	///////////////////////////////////////////////////////////////////////////////////////
+	HierarchyPool(size_t baseSize, const Allocator &allocator = Allocator())
+		: mAllocator(allocator)
+	{
+		baseSize = LimitCapacity(baseSize);
+		if (baseSize != 0)
+		{
+			GrowSlots(baseSize);
+			Relocate(baseSize);
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// @param baseSize - base count of preallocated objects in the pool
+	/// @param memoryAlloc Memory allocation function
+	/// @param memoryFree Memory deallocation function. free by default
+	///
+	/// Available when allocator is PoolFunctionAllocator, default one.
+	///////////////////////////////////////////////////////////////////////////////////////
+	HierarchyPool(size_t baseSize, MemoryAllocFunc memoryAlloc, MemoryFreeFunc memoryFree = free)
+		: HierarchyPool(baseSize, Allocator(memoryAlloc, memoryFree))
+	{
+	}
+
+	HierarchyPool(const HierarchyPool&) = delete;
+	HierarchyPool& operator=(const HierarchyPool&) = delete;
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Destructor
+	///////////////////////////////////////////////////////////////////////////////////////
+	~HierarchyPool()
+	{
+		Clear();
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Constructs new root object at the end of dense array and returns handle to it.
+	///
+	/// Throws std::bad_alloc when unable to allocate memory.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template <typename... Args>
+	Handle Spawn(Args &&... args)
+	{
+		return Append(NoParent, std::forward<Args>(args)...);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Constructs new child of object with 'parent' handle at the end of dense array,
+	/// order stays valid because parent is already in the array. When 'parent' is 
+	/// invalid, new object is a root, same as in SetParent.
+	///
+	/// Throws std::bad_alloc when unable to allocate memory.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template <typename... Args>
+	Handle SpawnChild(const Handle &parent, Args &&... args)
+	{
+		const auto parentLink = IsValid(parent) ? mSlots[parent.GetIndex()].mLink : NoParent;
+		return Append(parentLink, std::forward<Args>(args)...);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Destructs object with 'handle' together with all its descendants. Objects after
+	/// it are moved back over the gap in a single pass, since descendants always follow
+	/// their ancestors. Invalid handles are ignored.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Return(const Handle &handle)
+	{
+		if (!IsValid(handle))
+		{
+			return;
+		}
+		const size_t first = mSlots[handle.GetIndex()].mLink;
+		size_t position = first;
+		for (size_t i = first; i < mCount; ++i)
+		{
+			const auto parent = mParents[i];
+			const bool removed = i == first || (parent != NoParent && parent >= first 
+				&& mRemap[parent] == NoParent);
+			if (removed)
+			{
+				mRemap[i] = NoParent;
+				mObjects[i].~T();
+				FreeSlot(mDenseToSlot[i]);
+				continue;
+			}
+			mRemap[i] = static_cast<Link>(position);
+			if (parent != NoParent && parent >= first)
+			{
+				mParents[i] = mRemap[parent];
+			}
+			if (position != i)
+			{
+				new (mObjects + position) T(std::move(mObjects[i]));
+				mObjects[i].~T();
+				mParents[position] = mParents[i];
+				mDenseToSlot[position] = mDenseToSlot[i];
+				mSlots[mDenseToSlot[position]].mLink = static_cast<Link>(position);
+			}
+			++position;
+		}
+		mCount = position;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Attaches object with 'handle' to object with 'parent' handle, or makes it a root 
+	/// when 'parent' is invalid. When parent is placed after the object, the object and
+	/// its descendants that precede parent are moved right after parent. Returns false
+	/// and changes nothing when 'handle' is invalid or 'parent' is the object itself or
+	/// its descendant.
+	///////////////////////////////////////////////////////////////////////////////////////
+	bool SetParent(const Handle &handle, const Handle &parent)
+	{
+		if (!IsValid(handle))
+		{
+			return false;
+		}
+		const size_t first = mSlots[handle.GetIndex()].mLink;
+		if (!IsValid(parent))
+		{
+			mParents[first] = NoParent;
+			return true;
+		}
+		const size_t last = mSlots[parent.GetIndex()].mLink;
+		// Walk up from new parent to detect cycle
+		for (auto ancestor = static_cast<Link>(last); ancestor != NoParent; ancestor = mParents[ancestor])
+		{
+			if (ancestor == first)
+			{
+				return false;
+			}
+			if (ancestor < first)
+			{
+				break;
+			}
+		}
+		if (last < first)
+		{
+			mParents[first] = static_cast<Link>(last);
+			return true;
+		}
+		// Objects in (first, last] keep their order and move back by count of subtree
+		// objects among them, subtree objects keep their order and follow parent
+		size_t subtreeCount = 0;
+		for (size_t i = first; i <= last; ++i)
+		{
+			const auto ancestor = mParents[i];
+			if (i == first || (ancestor != NoParent && ancestor >= first && mRemap[ancestor] == NoParent))
+			{
+				mRemap[i] = NoParent;
+				++subtreeCount;
+			}
+			else
+			{
+				mRemap[i] = 0;
+			}
+		}
+		size_t otherPosition = first;
+		size_t subtreePosition = last + 1 - subtreeCount;
+		for (size_t i = first; i <= last; ++i)
+		{
+			mRemap[i] = static_cast<Link>(mRemap[i] == NoParent ? subtreePosition++ : otherPosition++);
+		}
+		mParents[first] = static_cast<Link>(last);
+		for (size_t i = first; i < mCount; ++i)
+		{
+			const auto ancestor = mParents[i];
+			if (ancestor != NoParent && ancestor >= first && ancestor <= last)
+			{
+				mParents[i] = mRemap[ancestor];
+			}
+		}
+		// Apply permutation by cycles
+		for (size_t i = first; i <= last; ++i)
+		{
+			while (mRemap[i] != i)
+			{
+				const size_t target = mRemap[i];
+				SwapRecords(i, target);
+				std::swap(mRemap[i], mRemap[target]);
+			}
+		}
+		for (size_t i = first; i <= last; ++i)
+		{
+			mSlots[mDenseToSlot[i]].mLink = static_cast<Link>(i);
+		}
+		return true;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns handle of parent of object with 'handle', invalid handle for roots.
+	///////////////////////////////////////////////////////////////////////////////////////
+	Handle GetParent(const Handle &handle) const noexcept
+	{
+		assert(IsValid(handle));
+		const auto parent = mParents[mSlots[handle.GetIndex()].mLink];
+		return parent == NoParent ? Handle() : GetHandle(parent);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Destructs every object in pool, frees memory of slots and objects. All handles 
+	/// will become invalid!
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Clear()
+	{
+		for (size_t i = 0; i < mCount; ++i)
+		{
+			mObjects[i].~T();
+		}
+		if (mSlots)
+		{
+			mAllocator.Deallocate(mSlots, sizeof(Slot) * mCapacity, alignof(Slot));
+		}
+		FreeDense();
+		mSlots = nullptr;
+		mObjects = nullptr;
+		mDenseToSlot = nullptr;
+		mParents = nullptr;
+		mRemap = nullptr;
+		mFreeHead = FreeListEnd;
+		mFreeTail = FreeListEnd;
+		mFrontier = 0;
+		mCapacity = 0;
+		mDenseCapacity = 0;
+		mCount = 0;
+		mRetiredCount = 0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns true if 'handle' corresponds to object, that handle indexes.
+	///////////////////////////////////////////////////////////////////////////////////////
+	bool IsValid(const Handle &handle) const noexcept
+	{
+		return handle.GetIndex() < mCapacity && handle.GetStamp() == mSlots[handle.GetIndex()].mStamp;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns reference to object by its handle. Handle must be valid, see Pool::At.
+	///////////////////////////////////////////////////////////////////////////////////////
+	T &At(const Handle &handle) const
+	{
+		assert(IsValid(handle));
+		return mObjects[mSlots[handle.GetIndex()].mLink];
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Same as At.
+	///////////////////////////////////////////////////////////////////////////////////////
+	T &operator[](const Handle &handle) const
+	{
+		return At(handle);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns handle of object at 'position' in dense array
+	///////////////////////////////////////////////////////////////////////////////////////
+	Handle GetHandle(size_t position) const noexcept
+	{
+		assert(position < mCount);
+		const auto index = mDenseToSlot[position];
+		return Handle(index, mSlots[index].mStamp);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns count of objects that are already spawned.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetSpawnedCount() const noexcept
+	{
+		return mCount;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns count of slots, which is max index of handle plus one.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetCapacity() const noexcept
+	{
+		return mCapacity;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns dense array of live objects in topological order. You should NEVER store
+	/// returned pointer: objects move on Spawn, Return and SetParent.
+	///////////////////////////////////////////////////////////////////////////////////////
+	T *GetObjects() const noexcept
+	{
+		return mObjects;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns position of parent for every object of dense array, NoParent for roots.
+	/// Parent position is always less than position of the object.
+	///////////////////////////////////////////////////////////////////////////////////////
+	const Link *GetParents() const noexcept
+	{
+		return mParents;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// begin method for "range-based for". There are no holes, so iterator is a pointer.
+	///////////////////////////////////////////////////////////////////////////////////////
+	T *begin() const noexcept
+	{
+		return mObjects;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// end method for "range-based for".
+	///////////////////////////////////////////////////////////////////////////////////////
+	T *end() const noexcept
+	{
+		return mObjects + mCount;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Calls 'func(object, parent)' for every live object in topological order, 'parent'
+	/// is nullptr for roots. Parent is always visited before its children, so values
+	/// written to parent are already final, e.g.:
+	///   pool.ForEachWithParent([](Node &node, Node *parent) 
+	///   { 
+	///       node.mGlobal = parent ? parent->mGlobal * node.mLocal : node.mLocal; 
+	///   });
+	/// 'func' must not spawn or return objects.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template<typename Func>
+	void ForEachWithParent(Func &&func)
+	{
+		for (size_t i = 0; i < mCount; ++i)
+		{
+			const auto parent = mParents[i];
+			func(mObjects[i], parent == NoParent ? nullptr : mObjects + parent);
+		}
+	}
+private:
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Entry of sparse table: link is position of object in dense array when slot is 
+	/// busy and index of next free slot when slot is free.
+	///////////////////////////////////////////////////////////////////////////////////////
+	struct Slot
+	{
+		Stamp mStamp;
+		Link mLink;
+	};
+
+	/// Marks end of free list
+	static constexpr Link FreeListEnd = static_cast<Link>(~uint64_t(0));
+	/// Largest capacity allowed by handle and by growth policy
+	static constexpr size_t CapacityLimit = 
+		MaxCapacity < Traits::Growth::CapacityLimit ? MaxCapacity : Traits::Growth::CapacityLimit;
+
+	static size_t LimitCapacity(size_t capacity) noexcept
+	{
+		return capacity < CapacityLimit ? capacity : CapacityLimit;
+	}
+
+	static size_t NextCapacity(size_t capacity) noexcept
+	{
+		return LimitCapacity(Traits::Growth::GetNextCapacity(capacity));
+	}
+
+	template <typename... Args>
+	Handle Append(Link parent, Args &&... args)
+	{
+		if (mFreeHead == FreeListEnd && mFrontier == mCapacity)
+		{
+			if (mCapacity >= CapacityLimit)
+			{
+				throw std::bad_alloc();
+			}
+			GrowSlots(NextCapacity(mCapacity));
+		}
+		if (mCount == mDenseCapacity)
+		{
+			Relocate(NextCapacity(mDenseCapacity));
+		}
+		// Object is constructed before slot is taken, so throwing constructor leaves
+		// pool untouched
+		new (mObjects + mCount) T(std::forward<Args>(args)...);
+		const auto index = GetFreeIndex();
+		auto &slot = mSlots[index];
+		// Odd stamp marks busy slot
+		const auto stamp = ++slot.mStamp;
+		slot.mLink = static_cast<Link>(mCount);
+		mDenseToSlot[mCount] = static_cast<Link>(index);
+		mParents[mCount] = parent;
+		++mCount;
+		return Handle { index, stamp };
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Swaps objects and links of two positions of dense array, slots are not updated
+	///////////////////////////////////////////////////////////////////////////////////////
+	void SwapRecords(size_t a, size_t b) noexcept
+	{
+		T temp(std::move(mObjects[a]));
+		mObjects[a].~T();
+		new (mObjects + a) T(std::move(mObjects[b]));
+		mObjects[b].~T();
+		new (mObjects + b) T(std::move(temp));
+		std::swap(mDenseToSlot[a], mDenseToSlot[b]);
+		std::swap(mParents[a], mParents[b]);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Marks slot free and registers it in free list, or retires it
+	///////////////////////////////////////////////////////////////////////////////////////
+	void FreeSlot(PoolIndex index) noexcept
+	{
+		auto &slot = mSlots[index];
+		// Even stamp marks free slot
+		++slot.mStamp;
+		if (static_cast<Stamp>(slot.mStamp + 1) == Handle::InvalidStamp)
+		{
+			++mRetiredCount;
+		}
+		else
+		{
+			PushFreeIndex(index);
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Grows sparse table to 'capacity' slots. Slots are trivially copyable.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void GrowSlots(size_t capacity)
+	{
+		assert(capacity > mCapacity);
+		mSlots = static_cast<Slot *>(PoolReallocate(mAllocator, mSlots, sizeof(Slot) * mCapacity,
+			sizeof(Slot) * capacity, alignof(Slot)));
+		// Zero stamp marks free slot that has never been used
+		memset(mSlots + mCapacity, 0, sizeof(Slot) * (capacity - mCapacity));
+		mCapacity = capacity;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Moves objects into new dense arrays of 'capacity' objects, order is kept. Links 
+	/// are kept in a single block after objects.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Relocate(size_t capacity)
+	{
+		assert(capacity >= mCount);
+		const auto objects = static_cast<T *>(mAllocator.Allocate(GetDenseSize(capacity), DenseAlignment));
+		const auto links = reinterpret_cast<Link *>(reinterpret_cast<char *>(objects) + GetObjectsSize(capacity));
+		PoolRelocate(objects, mObjects, mCount);
+		if (mCount != 0)
+		{
+			memcpy(links, mDenseToSlot, sizeof(Link) * mCount);
+			memcpy(links + capacity, mParents, sizeof(Link) * mCount);
+		}
+		FreeDense();
+		mObjects = objects;
+		mDenseToSlot = links;
+		mParents = links + capacity;
+		mRemap = links + capacity * 2;
+		mDenseCapacity = capacity;
+	}
+
+	void FreeDense() noexcept
+	{
+		if (mObjects)
+		{
+			mAllocator.Deallocate(mObjects, GetDenseSize(mDenseCapacity), DenseAlignment);
+		}
+	}
+
+	static constexpr size_t DenseAlignment = alignof(T) > alignof(Link) ? alignof(T) : alignof(Link);
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns size of objects part of dense block, rounded up to alignment of links
+	///////////////////////////////////////////////////////////////////////////////////////
+	static size_t GetObjectsSize(size_t capacity) noexcept
+	{
+		return (sizeof(T) * capacity + alignof(Link) - 1) / alignof(Link) * alignof(Link);
+	}
+
+	static size_t GetDenseSize(size_t capacity) noexcept
+	{
+		return GetObjectsSize(capacity) + sizeof(Link) * capacity * 3;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns index of next free slot, same order as in Pool
+	///////////////////////////////////////////////////////////////////////////////////////
+	PoolIndex GetFreeIndex() noexcept
+	{
+		if (mFrontier < mCapacity)
+		{
+			return mFrontier++;
+		}
+		const auto index = mFreeHead;
+		mFreeHead = mSlots[index].mLink;
+		if (mFreeHead == FreeListEnd)
+		{
+			mFreeTail = FreeListEnd;
+		}
+		return index;
+	}
+
+	void PushFreeIndex(PoolIndex index) noexcept
+	{
+		const auto link = static_cast<Link>(index);
+		mSlots[index].mLink = FreeListEnd;
+		if (mFreeTail == FreeListEnd)
+		{
+			mFreeHead = link;
+		}
+		else
+		{
+			mSlots[mFreeTail].mLink = link;
+		}
+		mFreeTail = link;
+	}
+
+	Slot *mSlots { nullptr };
+	/// Dense array of objects, its block also holds three arrays of links below
+	T *mObjects { nullptr };
+	/// Slot index of every object in dense array
+	Link *mDenseToSlot { nullptr };
+	/// Position of parent of every object in dense array
+	Link *mParents { nullptr };
+	/// Scratch array for new positions of objects during Return and SetParent
+	Link *mRemap { nullptr };
+	size_t mCapacity { 0 };
+	size_t mDenseCapacity { 0 };
+	size_t mCount { 0 };
+	size_t mRetiredCount { 0 };
+	/// Every slot with index at or above frontier has never been used
+	PoolIndex mFrontier { 0 };
+	Link mFreeHead { FreeListEnd };
+	Link mFreeTail { FreeListEnd };
+	Allocator mAllocator;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Non-owning view of contiguous array, returned by SoaPool for its columns.
+/// You should NEVER store span: its memory may move by calling Spawn.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename T>
+class PoolSpan final
+{
+public:
+	PoolSpan(T *data, size_t size) : mData(data), mSize(size) { }
+
+	T *GetData() const noexcept
+	{
+		return mData;
+	}
+
+	size_t GetSize() const noexcept
+	{
+		return mSize;
+	}
+
+	T &operator[](size_t index) const noexcept
+	{
+		assert(index < mSize);
+		return mData[index];
+	}
+
+	T *begin() const noexcept
+	{
+		return mData;
+	}
+
+	T *end() const noexcept
+	{
+		return mData + mSize;
+	}
+private:
+	T *mData;
+	size_t mSize;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Pool of entities, whose fields are stored in structure-of-arrays layout: every 
+/// field has its own contiguous column aligned to ColumnAlignment bytes, so system 
+/// that reads one field does not pull other fields into cache and its loop can be
+/// auto-vectorized. Handles and stamps work the same as in Pool.
+///
+/// Fields must be trivially copyable: columns are relocated with memcpy on growth and
+/// free records keep stale values, so per-column loops may run over them safely.
+///
+/// Columns live in one block taken from 'Allocator', see PoolHeapAllocator. SoaPool is
+/// BasicSoaPool with default allocator.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename Allocator, typename... Fields>
+class BasicSoaPool final
+{
+public:
+	typedef void* (*MemoryAllocFunc)(size_t size);
+	typedef void (*MemoryFreeFunc)(void* ptr);
+	using Handle = PoolHandle<BasicSoaPool>;
+	using Stamp = typename Handle::Stamp;
+	using Link = PoolUInt<PoolTraits::IndexBits>;
+
+	template<size_t Column>
+	using Field = typename std::tuple_element<Column, std::tuple<Fields...>>::type;
+
+	/// Count of columns
+	static constexpr size_t ColumnCount = sizeof...(Fields);
+	/// Alignment of every column, enough for any SIMD register
+	static constexpr size_t ColumnAlignment = 64;
+	/// Max count of records, the largest index is reserved for end of free list
+	static constexpr size_t MaxCapacity = static_cast<size_t>(
+		~uint64_t(0) >> (64 - PoolTraits::IndexBits)) - 1;
+
+	static_assert(ColumnCount > 0, "SoaPool needs at least one field");
+	static_assert(PoolAllOf<std::is_trivially_copyable<Fields>::value...>::value,
+		"Fields of SoaPool must be trivially copyable");
+	static_assert(PoolAllOf<(alignof(Fields) <= ColumnAlignment)...>::value,
+		"Fields of SoaPool must not be aligned stricter than ColumnAlignment");
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// @param baseSize - base count of preallocated records in the pool
+	/// @param allocator - allocator of pool memory, see PoolHeapAllocator
+	///////////////////////////////////////////////////////////////////////////////////////
+	BasicSoaPool(size_t baseSize, const Allocator &allocator = Allocator())
+		: mAllocator(allocator)
+		, mOccupancy(allocator)
+	{
+		if (baseSize != 0)
+		{
+			Grow(LimitCapacity(baseSize));
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// @param baseSize - base count of preallocated records in the pool
+	/// @param memoryAlloc Memory allocation function
+	/// @param memoryFree Memory deallocation function. free by default
+	///
+	/// Available when allocator is PoolFunctionAllocator, default one.
+	///////////////////////////////////////////////////////////////////////////////////////
+	BasicSoaPool(size_t baseSize, MemoryAllocFunc memoryAlloc, MemoryFreeFunc memoryFree = free)
+		: BasicSoaPool(baseSize, Allocator(memoryAlloc, memoryFree))
+	{
+	}
+
+	BasicSoaPool(const BasicSoaPool&) = delete;
+	BasicSoaPool& operator=(const BasicSoaPool&) = delete;
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Destructor
+	///////////////////////////////////////////////////////////////////////////////////////
+	~BasicSoaPool()
+	{
+		Clear();
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns handle to new record with value-initialized fields. Grows the pool when
+	/// there are no free records.
+	///
+	/// Throws std::bad_alloc when unable to allocate memory.
+	///////////////////////////////////////////////////////////////////////////////////////
+	Handle Spawn()
+	{
+		return Spawn(Fields()...);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns handle to new record with given field values. Grows the pool when there
+	/// are no free records.
+	///
+	/// Throws std::bad_alloc when unable to allocate memory.
+	///////////////////////////////////////////////////////////////////////////////////////
+	Handle Spawn(const Fields &... fields)
+	{
+		if (mFreeHead == FreeListEnd && mFrontier == mCapacity)
+		{
+			if (mCapacity >= MaxCapacity)
+			{
+				throw std::bad_alloc();
+			}
+			Grow(LimitCapacity(Growth::GetNextCapacity(mCapacity)));
+		}
+		const auto index = GetFreeIndex();
+		Assign(index, std::index_sequence_for<Fields...>(), fields...);
+		// Odd stamp marks busy record
+		const auto stamp = ++mStamps[index];
+		mOccupancy.Set(index);
+		++mSpawnedCount;
+		return Handle { index, stamp };
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Will return record with 'handle' to the pool. Invalid handles are ignored.
+	/// Records whose stamps are about to wrap around are retired, same as in Pool.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Return(const Handle &handle)
+	{
+		const auto index = handle.GetIndex();
+		if (index >= mCapacity)
+		{
+			return;
+		}
+		auto &stamp = mStamps[index];
+		if (stamp == handle.GetStamp())
+		{
+			// Even stamp marks free record
+			++stamp;
+			mOccupancy.Reset(index);
+			--mSpawnedCount;
+			if (static_cast<Stamp>(stamp + 1) == Handle::InvalidStamp)
+			{
+				++mRetiredCount;
+			}
+			else
+			{
+				PushFreeIndex(index);
+			}
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Frees memory of every column. All handles will become invalid!
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Clear()
+	{
+		if (mMemory)
+		{
+			mAllocator.Deallocate(mMemory, mMemorySize, ColumnAlignment);
+		}
+		mOccupancy.Release();
+		mMemory = nullptr;
+		mMemorySize = 0;
+		mStamps = nullptr;
+		mNextFree = nullptr;
+		for (auto &column : mColumns)
+		{
+			column = nullptr;
+		}
+		mFreeHead = FreeListEnd;
+		mFreeTail = FreeListEnd;
+		mFrontier = 0;
+		mCapacity = 0;
+		mSpawnedCount = 0;
+		mRetiredCount = 0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns true if 'handle' corresponds to record, that handle indexes.
+	///////////////////////////////////////////////////////////////////////////////////////
+	bool IsValid(const Handle &handle) const noexcept
+	{
+		return handle.GetIndex() < mCapacity && handle.GetStamp() == mStamps[handle.GetIndex()];
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns reference to field 'Column' of record by its handle. Handle must be valid.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template<size_t Column>
+	Field<Column> &Get(const Handle &handle) const noexcept
+	{
+		assert(handle.GetIndex() < mCapacity);
+		return GetColumnData<Column>()[handle.GetIndex()];
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns span of field 'Column' over every record that has ever been used, indices
+	/// in span are indices of handles. Free records hold stale values, mask them with
+	/// GetStamps when it matters.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template<size_t Column>
+	PoolSpan<Field<Column>> GetColumn() const noexcept
+	{
+		return PoolSpan<Field<Column>>(GetColumnData<Column>(), mFrontier);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns span of stamps parallel to columns, odd stamp marks live record
+	///////////////////////////////////////////////////////////////////////////////////////
+	PoolSpan<const Stamp> GetStamps() const noexcept
+	{
+		return PoolSpan<const Stamp>(mStamps, mFrontier);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Calls 'func(fields...)' for every live record in order of indices. 'func' must 
+	/// not spawn new records.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template<typename Func>
+	void ForEach(Func &&func)
+	{
+		ForEach(func, std::index_sequence_for<Fields...>());
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns count of records that are already spawned.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetSpawnedCount() const noexcept
+	{
+		return mSpawnedCount;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns total capacity of this pool. 
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetCapacity() const noexcept
+	{
+		return mCapacity;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns count of records that were retired because their stamps ran out. 
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetRetiredCount() const noexcept
+	{
+		return mRetiredCount;
+	}
+private:
+	/// Marks end of free list
+	static constexpr Link FreeListEnd = static_cast<Link>(~uint64_t(0));
+	/// By default, grow rate is golden ratio
+	using Growth = GeometricPoolGrowth<>;
+
+	static size_t LimitCapacity(size_t capacity) noexcept
+	{
+		return capacity < MaxCapacity ? capacity : MaxCapacity;
+	}
+
+	static size_t AlignColumn(size_t offset) noexcept
+	{
+		return (offset + ColumnAlignment - 1) & ~(ColumnAlignment - 1);
+	}
+
+	static size_t GetFieldSize(size_t column) noexcept
+	{
+		const size_t sizes[] = { sizeof(Fields)... };
+		return sizes[column];
+	}
+
+	template<size_t Column>
+	Field<Column> *GetColumnData() const noexcept
+	{
+		return static_cast<Field<Column> *>(mColumns[Column]);
+	}
+
+	template<size_t... Columns>
+	void Assign(PoolIndex index, std::index_sequence<Columns...>, const Fields &... fields) noexcept
+	{
+		const int expand[] = { (new (GetColumnData<Columns>() + index) Fields(fields), 0)... };
+		(void)expand;
+	}
+
+	template<typename Func, size_t... Columns>
+	void ForEach(Func &func, std::index_sequence<Columns...>)
+	{
+		mOccupancy.ForEachSet([this, &func](size_t index)
+		{
+			func(GetColumnData<Columns>()[index]...);
+		});
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Moves every column into single new block of memory for 'capacity' records.
+	/// Stamps and links of free list are kept in the same block.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Grow(size_t capacity)
+	{
+		assert(capacity > mCapacity);
+		size_t offsets[ColumnCount + 2];
+		size_t size = 0;
+		offsets[0] = size;
+		size = AlignColumn(size + sizeof(Stamp) * capacity);
+		offsets[1] = size;
+		size = AlignColumn(size + sizeof(Link) * capacity);
+		for (size_t i = 0; i < ColumnCount; ++i)
+		{
+			offsets[i + 2] = size;
+			size = AlignColumn(size + GetFieldSize(i) * capacity);
+		}
+		const auto memory = mAllocator.Allocate(size, ColumnAlignment);
+		const auto base = static_cast<char *>(memory);
+		const auto stamps = reinterpret_cast<Stamp *>(base + offsets[0]);
+		const auto nextFree = reinterpret_cast<Link *>(base + offsets[1]);
+		// Zero stamp marks free record that has never been used
+		memset(stamps, 0, sizeof(Stamp) * capacity);
+		if (mCapacity != 0)
+		{
+			memcpy(stamps, mStamps, sizeof(Stamp) * mCapacity);
+			memcpy(nextFree, mNextFree, sizeof(Link) * mCapacity);
+		}
+		for (size_t i = 0; i < ColumnCount; ++i)
+		{
+			if (mCapacity != 0)
+			{
+				memcpy(base + offsets[i + 2], mColumns[i], GetFieldSize(i) * mCapacity);
+			}
+			mColumns[i] = base + offsets[i + 2];
+		}
+		if (mMemory)
+		{
+			mAllocator.Deallocate(mMemory, mMemorySize, ColumnAlignment);
+		}
+		mMemory = memory;
+		mMemorySize = size;
+		mStamps = stamps;
+		mNextFree = nextFree;
+		mCapacity = capacity;
+		mOccupancy.Resize(mCapacity);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns index of next free record, same order as in Pool
+	///////////////////////////////////////////////////////////////////////////////////////
+	PoolIndex GetFreeIndex() noexcept
+	{
+		if (mFrontier < mCapacity)
+		{
+			return mFrontier++;
+		}
+		const auto index = mFreeHead;
+		mFreeHead = mNextFree[index];
+		if (mFreeHead == FreeListEnd)
+		{
+			mFreeTail = FreeListEnd;
+		}
+		return index;
+	}
+
+	void PushFreeIndex(PoolIndex index) noexcept
+	{
+		const auto link = static_cast<Link>(index);
+		mNextFree[index] = FreeListEnd;
+		if (mFreeTail == FreeListEnd)
+		{
+			mFreeHead = link;
+		}
+		else
+		{
+			mNextFree[mFreeTail] = link;
+		}
+		mFreeTail = link;
+	}
+
+	void *mMemory { nullptr };
+	size_t mMemorySize { 0 };
+	Stamp *mStamps { nullptr };
+	Link *mNextFree { nullptr };
+	void *mColumns[ColumnCount] { };
+	size_t mSpawnedCount { 0 };
+	size_t mRetiredCount { 0 };
+	size_t mCapacity { 0 };
+	/// Every record with index at or above frontier has never been used
+	PoolIndex mFrontier { 0 };
+	Link mFreeHead { FreeListEnd };
+	Link mFreeTail { FreeListEnd };
+	Allocator mAllocator;
+	/// Bit per record, set for live records
+	PoolBitmap<Allocator> mOccupancy;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// SoaPool with memory from malloc and free, or from given functions
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename... Fields>
+using SoaPool = BasicSoaPool<PoolFunctionAllocator, Fields...>;
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Index of type T in pack Ts, T must be in the pack
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename T, typename... Ts>
+struct PoolTypeIndex;
+
+template<typename T, typename... Ts>
+struct PoolTypeIndex<T, T, Ts...> : std::integral_constant<size_t, 0>
+{
+};
+
+template<typename T, typename U, typename... Ts>
+struct PoolTypeIndex<T, U, Ts...> : std::integral_constant<size_t, 1 + PoolTypeIndex<T, Ts...>::value>
+{
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Count of occurrences of type T in pack Ts
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename T, typename... Ts>
+struct PoolTypeCount : std::integral_constant<size_t, 0>
+{
+};
+
+template<typename T, typename U, typename... Ts>
+struct PoolTypeCount<T, U, Ts...> 
+	: std::integral_constant<size_t, std::is_same<T, U>::value + PoolTypeCount<T, Ts...>::value>
+{
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Pool of entities made of a fixed set of components (archetype). Every component 
+/// type has its own contiguous column aligned to ColumnAlignment bytes, and one handle
+/// with one stamp addresses a record in every column. Loop over a subset of component
+/// types reads only their columns.
+///
+/// Unlike SoaPool, components may be any nothrow move constructible or trivially 
+/// relocatable types: they are constructed on Spawn, destructed on Return and moved to 
+/// new columns on growth.
+/// Every component type must appear in the pack once.
+///
+/// Columns live in one block taken from 'Allocator', see PoolHeapAllocator. MultiPool 
+/// is BasicMultiPool with default allocator.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename Allocator, typename... Components>
+class BasicMultiPool final
+{
+public:
+	typedef void* (*MemoryAllocFunc)(size_t size);
+	typedef void (*MemoryFreeFunc)(void* ptr);
+	using Handle = PoolHandle<BasicMultiPool>;
+	using Stamp = typename Handle::Stamp;
+	using Link = PoolUInt<PoolTraits::IndexBits>;
+
+	/// Count of columns
+	static constexpr size_t ColumnCount = sizeof...(Components);
+	/// Alignment of every column, enough for any SIMD register
+	static constexpr size_t ColumnAlignment = 64;
+	/// Max count of records, the largest index is reserved for end of free list
+	static constexpr size_t MaxCapacity = static_cast<size_t>(
+		~uint64_t(0) >> (64 - PoolTraits::IndexBits)) - 1;
+
+	static_assert(ColumnCount > 0, "MultiPool needs at least one component");
+	static_assert(PoolAllOf<(PoolTypeCount<Components, Components...>::value == 1)...>::value,
+		"Every component type of MultiPool must be unique");
+	static_assert(PoolAllOf<(std::is_nothrow_move_constructible<Components>::value
+		|| PoolTriviallyRelocatable<Components>::value)...>::value,
+		"Components of MultiPool must be nothrow move constructible or trivially relocatable");
+	static_assert(PoolAllOf<(alignof(Components) <= ColumnAlignment)...>::value,
+		"Components of MultiPool must not be aligned stricter than ColumnAlignment");
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// @param baseSize - base count of preallocated records in the pool
+	/// @param allocator - allocator of pool memory, see PoolHeapAllocator
+	///////////////////////////////////////////////////////////////////////////////////////
+	BasicMultiPool(size_t baseSize, const Allocator &allocator = Allocator())
+		: mAllocator(allocator)
+		, mOccupancy(allocator)
+	{
+		if (baseSize != 0)
+		{
+			Grow(LimitCapacity(baseSize));
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// @param baseSize - base count of preallocated records in the pool
+	/// @param memoryAlloc Memory allocation function
+	/// @param memoryFree Memory deallocation function. free by default
+	///
+	/// Available when allocator is PoolFunctionAllocator, default one.
+	///////////////////////////////////////////////////////////////////////////////////////
+	BasicMultiPool(size_t baseSize, MemoryAllocFunc memoryAlloc, MemoryFreeFunc memoryFree = free)
+		: BasicMultiPool(baseSize, Allocator(memoryAlloc, memoryFree))
+	{
+	}
+
+	BasicMultiPool(const BasicMultiPool&) = delete;
+	BasicMultiPool& operator=(const BasicMultiPool&) = delete;
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Destructor
+	///////////////////////////////////////////////////////////////////////////////////////
+	~BasicMultiPool()
+	{
+		Clear();
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns handle to new record with value-initialized components. Grows the pool 
+	/// when there are no free records.
+	///
+	/// Throws std::bad_alloc when unable to allocate memory. If constructor of a 
+	/// component throws, components constructed so far are destructed and exception 
+	/// is rethrown.
+	///////////////////////////////////////////////////////////////////////////////////////
+	Handle Spawn()
+	{
+		return Spawn(Components()...);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns handle to new record, every component is constructed from argument at
+	/// the same position. Grows the pool when there are no free records.
+	///
+	/// Throws std::bad_alloc when unable to allocate memory. If constructor of a 
+	/// component throws, components constructed so far are destructed and exception 
+	/// is rethrown.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template<typename... Args>
+	Handle Spawn(Args &&... components)
+	{
+		static_assert(sizeof...(Args) == ColumnCount, "Spawn needs argument for every component");
+		if (mSpawnedCount + mRetiredCount == mCapacity)
+		{
+			if (mCapacity >= MaxCapacity)
+			{
+				throw std::bad_alloc();
+			}
+			Grow(LimitCapacity(Growth::GetNextCapacity(mCapacity)));
+		}
+		const auto index = GetFreeIndex();
+		try
+		{
+			Construct<0>(index, std::forward<Args>(components)...);
+		}
+		catch (...)
+		{
+			PushFreeIndex(index);
+			throw;
+		}
+		// Odd stamp marks busy record
+		const auto stamp = ++mStamps[index];
+		mOccupancy.Set(index);
+		++mSpawnedCount;
+		return Handle { index, stamp };
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Destructs every component of record with 'handle' and returns record to the 
+	/// pool. Invalid handles are ignored. Records whose stamps are about to wrap around
+	/// are retired, same as in Pool.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Return(const Handle &handle)
+	{
+		const auto index = handle.GetIndex();
+		if (index >= mCapacity)
+		{
+			return;
+		}
+		auto &stamp = mStamps[index];
+		if (stamp == handle.GetStamp())
+		{
+			// Even stamp marks free record
+			++stamp;
+			mOccupancy.Reset(index);
+			Destruct(index);
+			--mSpawnedCount;
+			if (static_cast<Stamp>(stamp + 1) == Handle::InvalidStamp)
+			{
+				++mRetiredCount;
+			}
+			else
+			{
+				PushFreeIndex(index);
+			}
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Destructs every live record and frees memory of every column. All handles will
+	/// become invalid!
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Clear()
+	{
+		mOccupancy.ForEachSet([this](size_t index)
+		{
+			Destruct(static_cast<PoolIndex>(index));
+		});
+		if (mMemory)
+		{
+			mAllocator.Deallocate(mMemory, mMemorySize, ColumnAlignment);
+		}
+		mOccupancy.Release();
+		mMemory = nullptr;
+		mMemorySize = 0;
+		mStamps = nullptr;
+		mNextFree = nullptr;
+		for (auto &column : mColumns)
+		{
+			column = nullptr;
+		}
+		mFreeHead = FreeListEnd;
+		mFreeTail = FreeListEnd;
+		mFrontier = 0;
+		mCapacity = 0;
+		mSpawnedCount = 0;
+		mRetiredCount = 0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns true if 'handle' corresponds to record, that handle indexes.
+	///////////////////////////////////////////////////////////////////////////////////////
+	bool IsValid(const Handle &handle) const noexcept
+	{
+		return handle.GetIndex() < mCapacity && handle.GetStamp() == mStamps[handle.GetIndex()];
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns reference to component 'T' of record by its handle. Handle must be valid.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template<typename T>
+	T &Get(const Handle &handle) const noexcept
+	{
+		assert(handle.GetIndex() < mCapacity);
+		return GetColumnData<T>()[handle.GetIndex()];
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Calls 'func(components...)' for every live record in order of indices, passing
+	/// components of types 'Ts' (every component when 'Ts' is empty). Only columns of 
+	/// 'Ts' are read. 'func' must not spawn new records.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template<typename... Ts, typename Func>
+	void ForEach(Func &&func)
+	{
+		static_assert(PoolAllOf<(PoolTypeCount<Ts, Components...>::value == 1)...>::value,
+			"ForEach needs component types of this pool");
+		using Selected = typename std::conditional<sizeof...(Ts) == 0, 
+			TypeList<Components...>, TypeList<Ts...>>::type;
+		ForEachOf(func, Selected());
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns count of records that are already spawned.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetSpawnedCount() const noexcept
+	{
+		return mSpawnedCount;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns total capacity of this pool. 
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetCapacity() const noexcept
+	{
+		return mCapacity;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns count of records that were retired because their stamps ran out. 
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetRetiredCount() const noexcept
+	{
+		return mRetiredCount;
+	}
+private:
+	template<typename...>
+	struct TypeList
+	{
+	};
+
+	/// Marks end of free list
+	static constexpr Link FreeListEnd = static_cast<Link>(~uint64_t(0));
+	/// By default, grow rate is golden ratio
+	using Growth = GeometricPoolGrowth<>;
+
+	static size_t LimitCapacity(size_t capacity) noexcept
+	{
+		return capacity < MaxCapacity ? capacity : MaxCapacity;
+	}
+
+	static size_t AlignColumn(size_t offset) noexcept
+	{
+		return (offset + ColumnAlignment - 1) & ~(ColumnAlignment - 1);
+	}
+
+	template<typename T>
+	T *GetColumnData() const noexcept
+	{
+		return static_cast<T *>(mColumns[PoolTypeIndex<T, Components...>::value]);
+	}
+
+	template<size_t Column, typename Arg, typename... Args>
+	void Construct(PoolIndex index, Arg &&arg, Args &&... args)
+	{
+		using T = typename std::tuple_element<Column, std::tuple<Components...>>::type;
+		T *component = new (GetColumnData<T>() + index) T(std::forward<Arg>(arg));
+		try
+		{
+			Construct<Column + 1>(index, std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			component->~T();
+			throw;
+		}
+	}
+
+	template<size_t Column>
+	void Construct(PoolIndex) noexcept
+	{
+	}
+
+	void Destruct(PoolIndex index) noexcept
+	{
+		const int expand[] = { (GetColumnData<Components>()[index].~Components(), 0)... };
+		(void)expand;
+	}
+
+	template<typename Func, typename... Ts>
+	void ForEachOf(Func &func, TypeList<Ts...>)
+	{
+		// Columns are read once, not on every record
+		const auto columns = std::make_tuple(GetColumnData<Ts>()...);
+		mOccupancy.ForEachSet([&func, &columns](size_t index)
+		{
+			func(std::get<Ts *>(columns)[index]...);
+		});
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Moves live components of column 'T' to 'to', column by column. Trivially 
+	/// relocatable columns are copied whole.
+	///////////////////////////////////////////////////////////////////////////////////////
+	template<typename T>
+	void MoveColumn(T *to) noexcept
+	{
+		MoveColumn(to, std::integral_constant<bool, PoolTriviallyRelocatable<T>::value>());
+	}
+
+	template<typename T>
+	void MoveColumn(T *to, std::true_type) noexcept
+	{
+		memcpy(static_cast<void *>(to), static_cast<const void *>(GetColumnData<T>()), sizeof(T) * mCapacity);
+	}
+
+	template<typename T>
+	void MoveColumn(T *to, std::false_type) noexcept
+	{
+		T *from = GetColumnData<T>();
+		mOccupancy.ForEachSet([to, from](size_t index)
+		{
+			new (to + index) T(std::move(from[index]));
+			from[index].~T();
+		});
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Moves every column into single new block of memory for 'capacity' records.
+	/// Stamps and links of free list are kept in the same block.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Grow(size_t capacity)
+	{
+		assert(capacity > mCapacity);
+		const size_t sizes[] = { sizeof(Components)... };
+		size_t offsets[ColumnCount + 2];
+		size_t size = 0;
+		offsets[0] = size;
+		size = AlignColumn(size + sizeof(Stamp) * capacity);
+		offsets[1] = size;
+		size = AlignColumn(size + sizeof(Link) * capacity);
+		for (size_t i = 0; i < ColumnCount; ++i)
+		{
+			offsets[i + 2] = size;
+			size = AlignColumn(size + sizes[i] * capacity);
+		}
+		const auto memory = mAllocator.Allocate(size, ColumnAlignment);
+		const auto base = static_cast<char *>(memory);
+		const auto stamps = reinterpret_cast<Stamp *>(base + offsets[0]);
+		const auto nextFree = reinterpret_cast<Link *>(base + offsets[1]);
+		// Zero stamp marks free record that has never been used
+		memset(stamps, 0, sizeof(Stamp) * capacity);
+		if (mCapacity != 0)
+		{
+			memcpy(stamps, mStamps, sizeof(Stamp) * mCapacity);
+			memcpy(nextFree, mNextFree, sizeof(Link) * mCapacity);
+			const int expand[] = { (MoveColumn(reinterpret_cast<Components *>(
+				base + offsets[PoolTypeIndex<Components, Components...>::value + 2])), 0)... };
+			(void)expand;
+			mAllocator.Deallocate(mMemory, mMemorySize, ColumnAlignment);
+		}
+		for (size_t i = 0; i < ColumnCount; ++i)
+		{
+			mColumns[i] = base + offsets[i + 2];
+		}
+		mMemory = memory;
+		mMemorySize = size;
+		mStamps = stamps;
+		mNextFree = nextFree;
+		mCapacity = capacity;
+		mOccupancy.Resize(mCapacity);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns index of next free record, same order as in Pool
+	///////////////////////////////////////////////////////////////////////////////////////
+	PoolIndex GetFreeIndex() noexcept
+	{
+		if (mFrontier < mCapacity)
+		{
+			return mFrontier++;
+		}
+		const auto index = mFreeHead;
+		mFreeHead = mNextFree[index];
+		if (mFreeHead == FreeListEnd)
+		{
+			mFreeTail = FreeListEnd;
+		}
+		return index;
+	}
+
+	void PushFreeIndex(PoolIndex index) noexcept
+	{
+		const auto link = static_cast<Link>(index);
+		mNextFree[index] = FreeListEnd;
+		if (mFreeTail == FreeListEnd)
+		{
+			mFreeHead = link;
+		}
+		else
+		{
+			mNextFree[mFreeTail] = link;
+		}
+		mFreeTail = link;
+	}
+
+	void *mMemory { nullptr };
+	size_t mMemorySize { 0 };
+	Stamp *mStamps { nullptr };
+	Link *mNextFree { nullptr };
+	void *mColumns[ColumnCount] { };
+	size_t mSpawnedCount { 0 };
+	size_t mRetiredCount { 0 };
+	size_t mCapacity { 0 };
+	/// Every record with index at or above frontier has never been used
+	PoolIndex mFrontier { 0 };
+	Link mFreeHead { FreeListEnd };
+	Link mFreeTail { FreeListEnd };
+	Allocator mAllocator;
+	/// Bit per record, set for live records
+	PoolBitmap<Allocator> mOccupancy;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// MultiPool with memory from malloc and free, or from given functions
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename... Components>
+using MultiPool = BasicMultiPool<PoolFunctionAllocator, Components...>;
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Uninitialized block of raw memory of PoolMemoryArena
+///////////////////////////////////////////////////////////////////////////////////////
+template<size_t Size>
+struct PoolMemoryBlock
+{
+	/// Leaves bytes uninitialized, so Spawn does not clear the block
+	PoolMemoryBlock()
+	{
+	}
+
+	alignas(8) unsigned char mBytes[Size];
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Traits of pools of PoolMemoryArena: virtual storage, so blocks never move and
+/// pointer maps to handle in O(1); the most recently freed block is reused first, its
+/// memory is likely still in cache.
+///////////////////////////////////////////////////////////////////////////////////////
+template<size_t MaxRecords>
+struct PoolMemoryTraits : VirtualPoolTraits<MaxRecords>
+{
+	static constexpr PoolReuse Reuse = PoolReuse::Lifo;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Default address space reserved by every size class of PoolMemoryArena
+///////////////////////////////////////////////////////////////////////////////////////
+constexpr size_t PoolDefaultMaxClassBytes = sizeof(void *) < 8 ? size_t(1) << 24 : size_t(1) << 28;
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Raw memory allocator backed by Pools of size classes: 8, 16, 32 ... 512 bytes. 
+/// Request is rounded up to the nearest class and served by Spawn of its pool, so 
+/// Allocate and Deallocate are O(1) and blocks of a class are packed together. Larger
+/// or over-aligned requests go to 'Allocator', see PoolHeapAllocator.
+///
+/// Every class reserves address space for MaxClassBytes on first use and commits it
+/// as it grows. Arena is not thread-safe, same as Pool.
+///////////////////////////////////////////////////////////////////////////////////////
+template<size_t MaxClassBytes = PoolDefaultMaxClassBytes, typename Allocator = PoolFunctionAllocator>
+class PoolMemoryArena final
+{
+public:
+	typedef void* (*MemoryAllocFunc)(size_t size);
+	typedef void (*MemoryFreeFunc)(void* ptr);
+
+	static constexpr size_t MinBlockSize = 8;
+	static constexpr size_t MaxBlockSize = 512;
+	/// Alignment of every block, requests with larger alignment go to the allocator
+	static constexpr size_t BlockAlignment = 8;
+	static constexpr size_t ClassCount = 7;
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// @param allocator Allocator of large blocks
+	///////////////////////////////////////////////////////////////////////////////////////
+	explicit PoolMemoryArena(const Allocator &allocator = Allocator())
+		: PoolMemoryArena(allocator, std::make_index_sequence<ClassCount>())
+	{
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// @param memoryAlloc Allocation function for large blocks
+	/// @param memoryFree Deallocation function for large blocks. free by default
+	///
+	/// Available when allocator is PoolFunctionAllocator, default one.
+	///////////////////////////////////////////////////////////////////////////////////////
+	explicit PoolMemoryArena(MemoryAllocFunc memoryAlloc, MemoryFreeFunc memoryFree = free)
+		: PoolMemoryArena(Allocator(memoryAlloc, memoryFree))
+	{
+	}
+
+	PoolMemoryArena(const PoolMemoryArena&) = delete;
+	PoolMemoryArena& operator=(const PoolMemoryArena&) = delete;
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns block of at least 'bytes' bytes aligned to 'alignment', which must be a 
+	/// power of two.
+	///
+	/// Throws std::bad_alloc when unable to allocate memory.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void *Allocate(size_t bytes, size_t alignment)
+	{
+		assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+		if (IsPooled(bytes, alignment))
+		{
+			return AllocateBlock(GetSizeClass(bytes), std::integral_constant<size_t, 0>());
+		}
+		return AllocateLarge(bytes, alignment);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Frees block returned by Allocate with the same 'bytes' and 'alignment'
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Deallocate(void *ptr, size_t bytes, size_t alignment) noexcept
+	{
+		if (IsPooled(bytes, alignment))
+		{
+			DeallocateBlock(ptr, GetSizeClass(bytes), std::integral_constant<size_t, 0>());
+			return;
+		}
+		DeallocateLarge(ptr, bytes, alignment);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns count of live blocks served by pools
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetBlockCount() const noexcept
+	{
+		return CountBlocks(std::make_index_sequence<ClassCount>());
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns count of live blocks served by the allocator
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetLargeCount() const noexcept
+	{
+		return mLargeCount;
+	}
+private:
+	template<size_t Class>
+	using ClassPool = Pool<PoolMemoryBlock<(MinBlockSize << Class)>, 
+		PoolMemoryTraits<MaxClassBytes / (MinBlockSize << Class)>>;
+
+	template<typename Sequence>
+	struct ClassPools;
+
+	template<size_t... Classes>
+	struct ClassPools<std::index_sequence<Classes...>>
+	{
+		using Type = std::tuple<ClassPool<Classes>...>;
+	};
+
+	template<size_t... Classes>
+	PoolMemoryArena(const Allocator &allocator, std::index_sequence<Classes...>)
+		: mPools(((void)Classes, size_t(0))...)
+		, mAllocator(allocator)
+	{
+	}
+
+	static bool IsPooled(size_t bytes, size_t alignment) noexcept
+	{
+		return bytes <= MaxBlockSize && alignment <= BlockAlignment;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns index of the smallest class that fits 'bytes'
+	///////////////////////////////////////////////////////////////////////////////////////
+	static size_t GetSizeClass(size_t bytes) noexcept
+	{
+		return bytes <= MinBlockSize ? 0 : PoolBitScanReverse(bytes - 1) - 2;
+	}
+
+	template<size_t Class>
+	void *AllocateBlock(size_t sizeClass, std::integral_constant<size_t, Class>)
+	{
+		if (sizeClass != Class)
+		{
+			return AllocateBlock(sizeClass, std::integral_constant<size_t, Class + 1>());
+		}
+		auto &pool = std::get<Class>(mPools);
+		return pool[pool.Spawn()].mBytes;
+	}
+
+	void *AllocateBlock(size_t, std::integral_constant<size_t, ClassCount>) noexcept
+	{
+		assert(false);
+		return nullptr;
+	}
+
+	template<size_t Class>
+	void DeallocateBlock(void *ptr, size_t sizeClass, std::integral_constant<size_t, Class>) noexcept
+	{
+		if (sizeClass != Class)
+		{
+			DeallocateBlock(ptr, sizeClass, std::integral_constant<size_t, Class + 1>());
+			return;
+		}
+		auto &pool = std::get<Class>(mPools);
+		const auto handle = pool.HandleByPointer(
+			reinterpret_cast<PoolMemoryBlock<(MinBlockSize << Class)> *>(ptr));
+		assert(pool.IsValid(handle));
+		pool.Return(handle);
+	}
+
+	void DeallocateBlock(void *, size_t, std::integral_constant<size_t, ClassCount>) noexcept
+	{
+		assert(false);
+	}
+
+	template<size_t... Classes>
+	size_t CountBlocks(std::index_sequence<Classes...>) const noexcept
+	{
+		const size_t counts[] = { std::get<Classes>(mPools).GetSpawnedCount()... };
+		size_t count = 0;
+		for (auto classCount : counts)
+		{
+			count += classCount;
+		}
+		return count;
+	}
+
+	void *AllocateLarge(size_t bytes, size_t alignment)
+	{
+		const auto memory = mAllocator.Allocate(bytes, alignment);
+		++mLargeCount;
+		return memory;
+	}
+
+	void DeallocateLarge(void *ptr, size_t bytes, size_t alignment) noexcept
+	{
+		--mLargeCount;
+		mAllocator.Deallocate(ptr, bytes, alignment);
+	}
+
+	typename ClassPools<std::make_index_sequence<ClassCount>>::Type mPools;
+	size_t mLargeCount { 0 };
+	Allocator mAllocator;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////
+/// Standard allocator that takes memory from PoolMemoryArena, so nodes of std::list,
+/// std::map and std::unordered_map, and small vectors and strings come from pools.
+/// Allocator only refers to the arena, arena must outlive every container that uses
+/// it. Allocators are equal when they refer to the same arena. Method names follow 
+/// the standard Allocator requirements.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename U, typename Arena = PoolMemoryArena<>>
+class PoolAllocator
+{
+public:
+	using value_type = U;
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	template<typename V>
+	struct rebind
+	{
+		using other = PoolAllocator<V, Arena>;
+	};
+
+	explicit PoolAllocator(Arena &arena) noexcept : mArena(&arena)
+	{
+	}
+
+	template<typename V>
+	PoolAllocator(const PoolAllocator<V, Arena> &other) noexcept : mArena(other.GetArena())
+	{
+	}
+
+	U *allocate(size_t count)
+	{
+		if (count > ~size_t(0) / sizeof(U))
+		{
+			throw std::bad_alloc();
+		}
+		return static_cast<U *>(mArena->Allocate(sizeof(U) * count, alignof(U)));
+	}
+
+	void deallocate(U *ptr, size_t count) noexcept
+	{
+		mArena->Deallocate(ptr, sizeof(U) * count, alignof(U));
+	}
+
+	Arena *GetArena() const noexcept
+	{
+		return mArena;
+	}
+
+	template<typename V>
+	bool operator==(const PoolAllocator<V, Arena> &other) const noexcept
+	{
+		return mArena == other.GetArena();
+	}
+
+	template<typename V>
+	bool operator!=(const PoolAllocator<V, Arena> &other) const noexcept
+	{
+		return mArena != other.GetArena();
+	}
+private:
+	Arena *mArena;
 };
 
-template<typename T>
-class Pool;
-
+#if SMART_POOL_HAS_PMR
 ///////////////////////////////////////////////////////////////////////////////////////
-///
+/// Polymorphic memory resource that owns PoolMemoryArena, for std::pmr containers.
+/// Large and over-aligned blocks go to 'Allocator', see PoolHeapAllocator.
+/// Not thread-safe, same as std::pmr::unsynchronized_pool_resource.
 ///////////////////////////////////////////////////////////////////////////////////////
-template<typename T>
-class PoolHandle final
+template<typename Allocator = PoolFunctionAllocator, size_t MaxClassBytes = PoolDefaultMaxClassBytes>
+class PoolMemoryResource final : public std::pmr::memory_resource
 {
 public:
+	typedef void* (*MemoryAllocFunc)(size_t size);
+	typedef void (*MemoryFreeFunc)(void* ptr);
+	using Arena = PoolMemoryArena<MaxClassBytes, Allocator>;
+
 	///////////////////////////////////////////////////////////////////////////////////////
-	/// Default contructor. Create "invalid" pool handle
+	/// @param allocator Allocator of large blocks
 	///////////////////////////////////////////////////////////////////////////////////////
-	PoolHandle() : mIndex(0), mStamp(PoolStamp_Free) { }
-private:
-	friend class Pool<T>;
-	PoolIndex mIndex;
-	PoolStamp mStamp;
+	explicit PoolMemoryResource(const Allocator &allocator = Allocator())
+		: mArena(allocator)
+	{
+	}
 
 	///////////////////////////////////////////////////////////////////////////////////////
-	/// Private constructor for pool needs
+	/// @param memoryAlloc Allocation function for large blocks
+	/// @param memoryFree Deallocation function for large blocks. free by default
+	///
+	/// Available when allocator is PoolFunctionAllocator, default one.
 	///////////////////////////////////////////////////////////////////////////////////////
-	PoolHandle(PoolIndex index, PoolStamp stamp) : mIndex(index), mStamp(stamp) { }
+	explicit PoolMemoryResource(MemoryAllocFunc memoryAlloc, MemoryFreeFunc memoryFree = free)
+		: mArena(memoryAlloc, memoryFree)
+	{
+	}
+
+	Arena &GetArena() noexcept
+	{
+		return mArena;
+	}
+protected:
+	void *do_allocate(size_t bytes, size_t alignment) override
+	{
+		return mArena.Allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void *ptr, size_t bytes, size_t alignment) override
+	{
+		mArena.Deallocate(ptr, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+	{
+		return this == &other;
+	}
+private:
+	Arena mArena;
 };
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////////////
-/// Internal class for holding user objects. Stores additional information along with 
-/// user's object
+/// Internal class for holding user objects in ConcurrentPool. Link to next free
+/// record is kept apart from object, because it can be read by other thread while
+/// record is being reused.
 ///////////////////////////////////////////////////////////////////////////////////////
 template <typename T>
-class PoolRecord final
+class ConcurrentPoolRecord final
 {
 public:
-	///////////////////////////////////////////////////////////////////////////////////////
-	/// Constructor with arguments delegation
-	///////////////////////////////////////////////////////////////////////////////////////
-	template <typename... Args>
-	PoolRecord(PoolStamp stamp, Args &&... args) : mStamp(stamp), mObject(args...) { }
+	ConcurrentPoolRecord() : mStamp(0), mNextFree(0), mNextBatch(0) { }
 
 	///////////////////////////////////////////////////////////////////////////////////////
-	///
+	/// Object lifetime is controlled by the pool
 	///////////////////////////////////////////////////////////////////////////////////////
-	PoolRecord() : mStamp(PoolStamp_Free) { }
+	~ConcurrentPoolRecord() { }
 private:
-	friend class Pool<T>;
-	PoolStamp mStamp;
-	T mObject;
-};
-
-///////////////////////////////////////////////////////////////////////////////////////
-/// Use this class as base to be able to obtain pointer to parent pool in derived class
-///////////////////////////////////////////////////////////////////////////////////////
-template<class T>
-class Poolable
-{
-public:
-	Pool<T>* ParentPool()
+	template<typename, size_t, typename>
+	friend class ConcurrentPool;
+	std::atomic<uint32_t> mStamp;
+	std::atomic<uint32_t> mNextFree;
+	/// Link to next batch, used only by first record of a batch
+	std::atomic<uint32_t> mNextBatch;
+	union
 	{
-		return mOwner;
-	}
-private:
-	friend class Pool<T>;
-	Pool<T>* mOwner { nullptr };
+		T mObject;
+	};
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////
-/// See description in the beginning of this file
+/// Thread-safe pool with the same handle semantics as Pool. Spawn, Return, IsValid
+/// and At can be called from any thread without external locking.
+///
+/// Free records form a lock-free stack; its head is tagged with a counter to be safe
+/// against ABA problem. Batches of free records given back by ConcurrentPoolCache are
+/// kept in a second stack of chains, so a batch moves with one compare-exchange.
+/// Stamps are generations of records, so there is no shared stamp counter to contend on.
+///
+/// Growth policy: records live in chunks of ChunkSize records, pointers to chunks
+/// live in a table which is allocated once in constructor for 'maxCapacity' records.
+/// Growth only installs new chunk into the table, so records are never moved and
+/// readers are never blocked or invalidated by concurrent growth. Spawn throws
+/// std::bad_alloc when 'maxCapacity' is exhausted.
+///
+/// Chunks and the table are taken from 'Allocator', see PoolHeapAllocator. It is called
+/// from any thread that grows the pool, so it must be thread-safe.
+///
+/// Poolable<T> is not supported, use handles or pointers to the pool instead.
+/// Constructor, destructor and Clear are not thread-safe.
 ///////////////////////////////////////////////////////////////////////////////////////
-template<typename T>
-class Pool final
+template<typename T, size_t ChunkSize = 4096, typename Allocator = PoolFunctionAllocator>
+class ConcurrentPool final
 {
 public:
+	static_assert(ChunkSize > 0 && (ChunkSize & (ChunkSize - 1)) == 0,
+		"Chunk size must be power of two");
+
 	typedef void* (*MemoryAllocFunc)(size_t size);
 	typedef void (*MemoryFreeFunc)(void* ptr);
+	using Handle = PoolHandle<T, 32, 32>;
+
+	/// Indices are packed into 32 bits of tagged free list head
+	static constexpr size_t MaxCapacityLimit = UINT32_MAX - ChunkSize;
 
 	///////////////////////////////////////////////////////////////////////////////////////
 	/// @param baseSize - base count of preallocated objects in the pool
-	/// @param memoryAlloc Memory allocation function. malloc by default
-	/// @param memoryFree Memory deallocation function. free by default
+	/// @param maxCapacity - max count of objects in the pool, defines size of chunk table
+	/// @param allocator - allocator of chunks and the table, see PoolHeapAllocator
 	///////////////////////////////////////////////////////////////////////////////////////
-	Pool(size_t baseSize, MemoryAllocFunc memoryAlloc = malloc, MemoryFreeFunc memoryFree = free)
-		: mCapacity(baseSize)
-		, MemoryAlloc(memoryAlloc)
-		, MemoryFree(memoryFree)
+	ConcurrentPool(size_t baseSize, size_t maxCapacity = 1 << 26, const Allocator &allocator = Allocator())
+		: mMaxChunkCount((maxCapacity + ChunkSize - 1) / ChunkSize)
+		, mAllocator(allocator)
 	{
-		AllocMemory();
-		for (PoolIndex i = 0; i < baseSize; ++i)
+		assert(maxCapacity <= MaxCapacityLimit);
+		assert(baseSize <= maxCapacity);
+		mChunks = static_cast<std::atomic<ConcurrentPoolRecord<T> *> *>(
+			mAllocator.Allocate(GetTableSize(), alignof(std::atomic<ConcurrentPoolRecord<T> *>)));
+		for (size_t i = 0; i < mMaxChunkCount; ++i)
+		{
+			new (&mChunks[i]) std::atomic<ConcurrentPoolRecord<T> *>(nullptr);
+		}
+		for (size_t i = 0; i * ChunkSize < baseSize; ++i)
 		{
-			mFreeQueue.push(i);
+			GetChunk(i);
 		}
 	}
 
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// @param baseSize - base count of preallocated objects in the pool
+	/// @param maxCapacity - max count of objects in the pool, defines size of chunk table
+	/// @param memoryAlloc Memory allocation function
+	/// @param memoryFree Memory deallocation function. free by default
+	///
+	/// Available when allocator is PoolFunctionAllocator, default one.
+	///////////////////////////////////////////////////////////////////////////////////////
+	ConcurrentPool(size_t baseSize, size_t maxCapacity, MemoryAllocFunc memoryAlloc, 
+		MemoryFreeFunc memoryFree = free)
+		: ConcurrentPool(baseSize, maxCapacity, Allocator(memoryAlloc, memoryFree))
+	{
+	}
+
+	ConcurrentPool(const ConcurrentPool&) = delete;
+	ConcurrentPool& operator=(const ConcurrentPool&) = delete;
+
 	///////////////////////////////////////////////////////////////////////////////////////
 	/// Destructor
 	///////////////////////////////////////////////////////////////////////////////////////
-	~Pool()
+	~ConcurrentPool()
 	{
 		Clear();
+		mAllocator.Deallocate(mChunks, GetTableSize(), alignof(std::atomic<ConcurrentPoolRecord<T> *>));
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////////
-	/// Returns handle to free object, or if pool is full allocates new object and returns
-	/// handle to it.
+	/// Returns handle to free object, or if pool is full installs new chunk and returns
+	/// handle to object in it.
 	///
-	/// Throws std::bad_alloc when unable to allocate memory.
+	/// Throws std::bad_alloc when unable to allocate memory or when max capacity is
+	/// exhausted.
 	///////////////////////////////////////////////////////////////////////////////////////
 	template <typename... Args>
-	PoolHandle<T> Spawn(Args &&... args)
+	Handle Spawn(Args &&... args)
 	{
-		if (mFreeQueue.empty())
+		PoolIndex index;
+		if (PopFreeIndices(&index, 1) == 0)
 		{
-			// No free objects, grow pool
-			const auto oldCapacity = mCapacity;
-			if (mCapacity == 0)
-			{
-				mCapacity = 1;
-			}
-			else
-			{
-				mCapacity = static_cast<size_t>(ceil(mCapacity * GrowRate));
-			}
-			// Remember old records
-			const auto old = mRecords;
-			// Create new array with larger size
-			AllocMemory();
-			// Register new free indices
-			for (PoolIndex i = oldCapacity; i < mCapacity; ++i)
-			{
-				mFreeQueue.push(i);
-			}
-			for (size_t i = 0; i < oldCapacity; ++i)
-			{
-				if (old[i].mStamp != PoolStamp_NotConstructed)
-				{
-					// Try to invoke move contructor and fallback to copy contructor if no move 
-					// constructor is presented.		
-					new (&mRecords[i]) PoolRecord<T>(std::move(old[i]));
-				}
-			}
-			// Remove old array of records
-			DestroyObjects(old, oldCapacity);
+			throw std::bad_alloc();
 		}
-		const auto index = GetFreeIndex();
-		auto &rec = mRecords[index];
-		// Reconstruct record via placement new.
-		auto element = new (&rec) PoolRecord<T>(MakeStamp(), args...);
-		// For newly constructed object we have to check if it is derived from Poolable<T>
-		// and set pointer to this pool as owner. 
-		if (std::is_base_of<Poolable<T>, T>::value)
+		try
 		{
-			((Poolable<T>*)&element->mObject)->mOwner = this;
+			return Construct(index, std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			PushFreeIndices(&index, 1);
+			throw;
 		}
-		++mSpawnedCount;
-		// Return handle to existing object.
-		return PoolHandle<T>{index, rec.mStamp};
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////////
-	/// Will return object with 'handle' to the pool
-	/// Calls destructor of returnable object
+	/// Will return object with 'handle' to the pool. Calls destructor of returnable
+	/// object. If several threads return same handle, only one of them destroys object.
 	///////////////////////////////////////////////////////////////////////////////////////
-	void Return(const PoolHandle<T> &handle)
+	void Return(const Handle &handle)
 	{
-		assert(handle.mIndex < mCapacity);
-		auto &rec = mRecords[handle.mIndex];
-		if (rec.mStamp != PoolStamp_Free)
+		if (Destruct(handle))
 		{
-			rec.mStamp = PoolStamp_Free;
-			// Destruct
-			rec.mObject.~T();
-			--mSpawnedCount;
-			// Register handle's index as free
-			mFreeQueue.push(handle.mIndex);
+			const auto index = handle.GetIndex();
+			PushFreeIndices(&index, 1);
 		}
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////////
-	/// Destructs every object in pool, frees memory block that holds records. All refs 
-	/// will become invalid!
+	/// Destructs every object in pool, frees every chunk. All handles will become
+	/// invalid! Not thread-safe.
 	///////////////////////////////////////////////////////////////////////////////////////
 	void Clear()
 	{
-		DestroyObjects(mRecords, mCapacity);
-		// Clear free indices queue
-		mFreeQueue = std::queue<PoolIndex>();
-		mRecords = nullptr;
-		mCapacity = 0;
-		mGlobalStamp = PoolStamp_Origin;
-		mSpawnedCount = 0;
+		for (size_t i = 0; i < mMaxChunkCount; ++i)
+		{
+			const auto chunk = mChunks[i].load(std::memory_order_relaxed);
+			if (chunk)
+			{
+				for (size_t k = 0; k < ChunkSize; ++k)
+				{
+					if (IsLivePoolStamp(chunk[k].mStamp.load(std::memory_order_relaxed)))
+					{
+						chunk[k].mObject.~T();
+					}
+					chunk[k].~ConcurrentPoolRecord<T>();
+				}
+				FreeChunk(chunk);
+				mChunks[i].store(nullptr, std::memory_order_relaxed);
+			}
+		}
+		mFreeHead.store(EmptyFreeHead, std::memory_order_relaxed);
+		mBatchHead.store(EmptyFreeHead, std::memory_order_relaxed);
+		mFrontier.store(0, std::memory_order_relaxed);
+		mChunkCount.store(0, std::memory_order_relaxed);
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////////
 	/// Returns true if 'handle' corresponds to object, that handle indexes.
-	///////////////////////////////////////////////////////////////////////////////////////	
-	bool IsValid(const PoolHandle<T> &handle) noexcept
+	///////////////////////////////////////////////////////////////////////////////////////
+	bool IsValid(const Handle &handle) const noexcept
 	{
-		assert(handle.mIndex < mCapacity);
-		return handle.mStamp == mRecords[handle.mIndex].mStamp;
+		const auto chunkIndex = handle.GetIndex() / ChunkSize;
+		if (chunkIndex >= mMaxChunkCount)
+		{
+			return false;
+		}
+		const auto chunk = mChunks[chunkIndex].load(std::memory_order_acquire);
+		return chunk && chunk[handle.GetIndex() % ChunkSize].mStamp.load(std::memory_order_acquire)
+			== handle.GetStamp();
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////////
-	/// Returns reference to object by its handle
-	/// WARNING: You should check handle to validity thru IsValid before pass it to method, 
-	/// otherwise you might get wrong object (destructed, or object that already in use by
-	/// someone other), or even segfault if you pass handle with index out of bounds.
-	/// Checking handle is similar as checking pointer for "non-nullptr" before use it.
+	/// Returns reference to object by its handle. Same rules as for Pool::At are applied.
 	///////////////////////////////////////////////////////////////////////////////////////
-	T &At(const PoolHandle<T> &handle) const
+	T &At(const Handle &handle) const
 	{
-		assert(handle.mIndex < mCapacity);
-		return mRecords[handle.mIndex].mObject;
+		return Record(handle.GetIndex()).mObject;
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////////
 	/// Same as At.
 	///////////////////////////////////////////////////////////////////////////////////////
-	T &operator[](const PoolHandle<T> &handle) const
+	T &operator[](const Handle &handle) const
 	{
 		return At(handle);
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////////
-	/// Returns count of objects that are already spawned.
+	/// Returns count of records in installed chunks.
 	///////////////////////////////////////////////////////////////////////////////////////
-	size_t GetSpawnedCount() const noexcept
+	size_t GetCapacity() const noexcept
 	{
-		return mSpawnedCount;
+		return mChunkCount.load(std::memory_order_relaxed) * ChunkSize;
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////////
-	/// Returns total capacity of this pool. 
+	/// Returns max count of objects, that pool can hold.
 	///////////////////////////////////////////////////////////////////////////////////////
-	size_t GetCapacity() const noexcept
+	size_t GetMaxCapacity() const noexcept
 	{
-		return mCapacity;
+		return mMaxChunkCount * ChunkSize;
 	}
+private:
+	template<typename, size_t, typename>
+	friend class ConcurrentPoolCache;
+
+	/// Lower 32 bits of head is index of first free record, upper 32 bits is a tag
+	/// which is incremented on every change of head.
+	static constexpr uint64_t EmptyFreeHead = UINT32_MAX;
 
 	///////////////////////////////////////////////////////////////////////////////////////
-	/// Returns pointer to memory block that holds every record of this pool.
-	/// You should NEVER store returned pointer: its address may change by calling Spawn.
+	/// Constructs object in free record with 'index' owned by calling thread
 	///////////////////////////////////////////////////////////////////////////////////////
-	PoolRecord<T> *GetRecords() noexcept
+	template <typename... Args>
+	Handle Construct(PoolIndex index, Args &&... args)
 	{
-		return mRecords;
+		auto &rec = Record(index);
+		new (&rec.mObject) T(std::forward<Args>(args)...);
+		// Odd stamp marks busy record, only owner of the record changes it here
+		const auto stamp = rec.mStamp.load(std::memory_order_relaxed) + 1;
+		// Publish object to threads that will check handle validity
+		rec.mStamp.store(stamp, std::memory_order_release);
+		return Handle{index, stamp};
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////////
-	/// begin method for "range-based for".
+	/// Destructs object with 'handle'. Returns true if calling thread won the record and
+	/// now owns it, record must be pushed back to free records then. Record which stamp
+	/// is about to wrap around is retired instead.
 	///////////////////////////////////////////////////////////////////////////////////////
-	PoolRecord<T> *begin()
+	bool Destruct(const Handle &handle)
 	{
-		return mRecords;
+		// Default handles, handles past the table and handles of other pools are ignored,
+		// same as in IsValid
+		const auto chunkIndex = handle.GetIndex() / ChunkSize;
+		auto expected = static_cast<uint32_t>(handle.GetStamp());
+		if (chunkIndex >= mMaxChunkCount || handle.GetStamp() == Handle::InvalidStamp)
+		{
+			return false;
+		}
+		const auto chunk = mChunks[chunkIndex].load(std::memory_order_acquire);
+		if (!chunk)
+		{
+			return false;
+		}
+		auto &rec = chunk[handle.GetIndex() % ChunkSize];
+		if (IsLivePoolStamp(expected) && rec.mStamp.compare_exchange_strong(
+			expected, expected + 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+		{
+			rec.mObject.~T();
+			return expected + 2 != Handle::InvalidStamp;
+		}
+		return false;
+	}
+
+	ConcurrentPoolRecord<T> &Record(PoolIndex index) const noexcept
+	{
+		assert(index / ChunkSize < mMaxChunkCount);
+		const auto chunk = mChunks[index / ChunkSize].load(std::memory_order_acquire);
+		assert(chunk);
+		return chunk[index % ChunkSize];
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////////
-	/// end method for "range-based for".
+	/// Returns chunk with 'chunkIndex', installs new one if it does not exist yet. When
+	/// several threads race to install chunk, losers free their chunks.
 	///////////////////////////////////////////////////////////////////////////////////////
-	PoolRecord<T> *end()
+	ConcurrentPoolRecord<T> *GetChunk(size_t chunkIndex)
+	{
+		auto chunk = mChunks[chunkIndex].load(std::memory_order_acquire);
+		if (chunk)
+		{
+			return chunk;
+		}
+		const auto newChunk = static_cast<ConcurrentPoolRecord<T> *>(mAllocator.Allocate(
+			sizeof(ConcurrentPoolRecord<T>) * ChunkSize, alignof(ConcurrentPoolRecord<T>)));
+		for (size_t i = 0; i < ChunkSize; ++i)
+		{
+			new (&newChunk[i]) ConcurrentPoolRecord<T>();
+		}
+		if (mChunks[chunkIndex].compare_exchange_strong(
+			chunk, newChunk, std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			mChunkCount.fetch_add(1, std::memory_order_relaxed);
+			return newChunk;
+		}
+		FreeChunk(newChunk);
+		return chunk;
+	}
+
+	void FreeChunk(ConcurrentPoolRecord<T> *chunk) noexcept
 	{
-		return mRecords + mCapacity - 1;
+		mAllocator.Deallocate(chunk, sizeof(ConcurrentPoolRecord<T>) * ChunkSize, alignof(ConcurrentPoolRecord<T>));
+	}
+
+	size_t GetTableSize() const noexcept
+	{
+		return sizeof(std::atomic<ConcurrentPoolRecord<T> *>) * mMaxChunkCount;
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////////
-	/// Use this only to obtain handle by 'this' pointer inside class method.
-	/// Note: Do not rely on pointers to objects in pool, they can suddenly become
-	/// invalid. 'this' pointer can be used, because it is always valid.
+	/// Takes up to 'count' free indices. Sources are tried in order: one chain of batches
+	/// stack, single records of free list, records that were never used. Returns count of
+	/// taken indices, which is less than 'count' only when max capacity is exhausted.
+	///
+	/// Throws std::bad_alloc when unable to allocate new chunk, indices taken so far are
+	/// given back then.
+	///////////////////////////////////////////////////////////////////////////////////////
+	size_t PopFreeIndices(PoolIndex *indices, size_t count)
+	{
+		size_t taken = 0;
+		auto first = Pop(mBatchHead, &ConcurrentPoolRecord<T>::mNextBatch);
+		if (first != UINT32_MAX)
+		{
+			// Whole chain is owned by calling thread now
+			auto index = first;
+			while (index != UINT32_MAX && taken < count)
+			{
+				indices[taken++] = index;
+				index = Record(index).mNextFree.load(std::memory_order_relaxed);
+			}
+			if (index != UINT32_MAX)
+			{
+				// Chain is longer than requested, rest goes to free list
+				auto last = index;
+				for (auto next = Record(last).mNextFree.load(std::memory_order_relaxed);
+					next != UINT32_MAX; next = Record(last).mNextFree.load(std::memory_order_relaxed))
+				{
+					last = next;
+				}
+				Push(mFreeHead, &ConcurrentPoolRecord<T>::mNextFree, index, last);
+			}
+		}
+		while (taken < count)
+		{
+			const auto index = Pop(mFreeHead, &ConcurrentPoolRecord<T>::mNextFree);
+			if (index == UINT32_MAX)
+			{
+				break;
+			}
+			indices[taken++] = index;
+		}
+		if (taken < count)
+		{
+			// Take never used records in bulk. Frontier moves only past records whose
+			// chunks are installed and never past max capacity, so no index is lost.
+			const auto maxCapacity = mMaxChunkCount * ChunkSize;
+			auto begin = mFrontier.load(std::memory_order_relaxed);
+			PoolIndex end;
+			do
+			{
+				end = begin + (count - taken) < maxCapacity ? begin + (count - taken) : maxCapacity;
+				if (begin >= end)
+				{
+					return taken;
+				}
+				try
+				{
+					for (auto chunkIndex = begin / ChunkSize; chunkIndex * ChunkSize < end; ++chunkIndex)
+					{
+						GetChunk(chunkIndex);
+					}
+				}
+				catch (...)
+				{
+					PushFreeIndices(indices, taken);
+					throw;
+				}
+			} while (!mFrontier.compare_exchange_weak(begin, end, std::memory_order_relaxed));
+			for (auto index = begin; index < end; ++index)
+			{
+				indices[taken++] = index;
+			}
+		}
+		return taken;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Gives indices of destructed records back. Single index goes to free list, batch 
+	/// is linked into a chain and pushed to batches stack with one compare-exchange.
+	///////////////////////////////////////////////////////////////////////////////////////
+	void PushFreeIndices(const PoolIndex *indices, size_t count) noexcept
+	{
+		if (count == 1)
+		{
+			const auto index = static_cast<uint32_t>(indices[0]);
+			Push(mFreeHead, &ConcurrentPoolRecord<T>::mNextFree, index, index);
+		}
+		else if (count > 1)
+		{
+			for (size_t i = 0; i + 1 < count; ++i)
+			{
+				Record(indices[i]).mNextFree.store(
+					static_cast<uint32_t>(indices[i + 1]), std::memory_order_relaxed);
+			}
+			const auto last = static_cast<uint32_t>(indices[count - 1]);
+			Record(last).mNextFree.store(UINT32_MAX, std::memory_order_relaxed);
+			const auto first = static_cast<uint32_t>(indices[0]);
+			Push(mBatchHead, &ConcurrentPoolRecord<T>::mNextBatch, first, first);
+		}
+	}
+
 	///////////////////////////////////////////////////////////////////////////////////////
-	PoolHandle<T> HandleByPointer(T * const ptr)
+	/// Pops first record from lock-free stack with 'head' linked through 'link', returns
+	/// UINT32_MAX if stack is empty. Records are never freed while pool is alive, so
+	/// reading link of record that was concurrently popped is safe - tag makes
+	/// compare-exchange fail in this case.
+	///////////////////////////////////////////////////////////////////////////////////////
+	uint32_t Pop(std::atomic<uint64_t> &head,
+		std::atomic<uint32_t> ConcurrentPoolRecord<T>::*link) noexcept
 	{
-		// Pointer must be in bounds
-		if (ptr < &mRecords[0].mObject || ptr >= &mRecords[mCapacity - 1].mObject)
+		auto value = head.load(std::memory_order_acquire);
+		for (;;)
 		{
-			return PoolHandle<T>();
+			const auto index = static_cast<uint32_t>(value);
+			if (index == UINT32_MAX)
+			{
+				return UINT32_MAX;
+			}
+			const uint64_t next = (Record(index).*link).load(std::memory_order_relaxed);
+			const uint64_t newValue = (((value >> 32) + 1) << 32) | next;
+			if (head.compare_exchange_weak(
+				value, newValue, std::memory_order_acquire, std::memory_order_acquire))
+			{
+				return index;
+			}
 		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Pushes records from 'first' to 'last', already linked through 'link', to 
+	/// lock-free stack with 'head'
+	///////////////////////////////////////////////////////////////////////////////////////
+	void Push(std::atomic<uint64_t> &head, std::atomic<uint32_t> ConcurrentPoolRecord<T>::*link,
+		uint32_t first, uint32_t last) noexcept
+	{
+		auto &tail = Record(last).*link;
+		auto value = head.load(std::memory_order_relaxed);
+		uint64_t newValue;
+		do
+		{
+			tail.store(static_cast<uint32_t>(value), std::memory_order_relaxed);
+			newValue = (((value >> 32) + 1) << 32) | first;
+		} while (!head.compare_exchange_weak(
+			value, newValue, std::memory_order_release, std::memory_order_relaxed));
+	}
 
-		// Offset ptr to get record
-		const auto record = reinterpret_cast<const PoolRecord<T> *>(
-			reinterpret_cast<const char *>(ptr) - sizeof(PoolStamp));
+	///////////////////////////////////////////////////////////////////////////////////////
+	// Internals
+	///////////////////////////////////////////////////////////////////////////////////////
 
-		const auto p0 = reinterpret_cast<const intptr_t>(&mRecords[0]);
-		const auto pn = reinterpret_cast<const intptr_t>(record);
+	/// Hot shared counters are kept on separate cache lines
+	alignas(64) std::atomic<uint64_t> mFreeHead { EmptyFreeHead };
+	alignas(64) std::atomic<uint64_t> mBatchHead { EmptyFreeHead };
+	alignas(64) std::atomic<PoolIndex> mFrontier { 0 };
+	alignas(64) std::atomic<size_t> mChunkCount { 0 };
+	std::atomic<ConcurrentPoolRecord<T> *> *mChunks { nullptr };
+	size_t mMaxChunkCount;
+	Allocator mAllocator;
+};
 
-		// Calculate index
-		const intptr_t distance = pn - p0;
-		const intptr_t index = distance / sizeof(PoolRecord<T>);
+///////////////////////////////////////////////////////////////////////////////////////
+/// Counters of ConcurrentPoolCache
+///////////////////////////////////////////////////////////////////////////////////////
+struct PoolCacheStats
+{
+	uint64_t mSpawnCount { 0 };
+	uint64_t mReturnCount { 0 };
+	/// Count of batches taken from shared pool
+	uint64_t mRefillCount { 0 };
+	/// Count of batches given back to shared pool
+	uint64_t mFlushCount { 0 };
+};
 
-		return PoolHandle<T>(index, record->mStamp);
+///////////////////////////////////////////////////////////////////////////////////////
+/// Per-thread cache of free records (magazine) in front of a shared ConcurrentPool.
+/// Cache holds up to two batches of free indices, so almost every Spawn and Return
+/// touches only memory of the calling thread. When cache is empty, Spawn refills one
+/// batch from the pool, when cache is full, Return flushes one batch back to the pool.
+/// Either operation costs one compare-exchange on shared state for the whole batch.
+///
+/// Every thread must use its own cache; handles are interchangeable between caches
+/// and the pool itself. Remaining indices are flushed to the pool on destruction.
+///////////////////////////////////////////////////////////////////////////////////////
+template<typename T, size_t ChunkSize = 4096, typename Allocator = PoolFunctionAllocator>
+class ConcurrentPoolCache final
+{
+public:
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// @param pool - shared pool
+	/// @param batchSize - count of indices moved between cache and pool at once
+	///////////////////////////////////////////////////////////////////////////////////////
+	ConcurrentPoolCache(ConcurrentPool<T, ChunkSize, Allocator> &pool, size_t batchSize = 64)
+		: mPool(pool)
+		, mBatchSize(batchSize)
+		, mIndices(new PoolIndex[batchSize * 2])
+	{
+		assert(batchSize > 0);
 	}
-private:
-	friend class PoolHandle<T>;
+
+	ConcurrentPoolCache(const ConcurrentPoolCache&) = delete;
+	ConcurrentPoolCache& operator=(const ConcurrentPoolCache&) = delete;
 
 	///////////////////////////////////////////////////////////////////////////////////////
-	/// Returns unique global stamp
+	/// Destructor. Gives every cached index back to the pool.
 	///////////////////////////////////////////////////////////////////////////////////////
-	PoolStamp MakeStamp() noexcept
+	~ConcurrentPoolCache()
 	{
-		return mGlobalStamp++;
+		Flush();
+		delete[] mIndices;
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////////
-	/// Calls destructors for every spawned object and then frees memory block
+	/// Same as ConcurrentPool::Spawn, but takes free record from the cache
+	///
+	/// Throws std::bad_alloc when unable to allocate memory or when max capacity of the
+	/// pool is exhausted.
 	///////////////////////////////////////////////////////////////////////////////////////
-	void DestroyObjects(PoolRecord<T> *ptr, size_t count)
+	template <typename... Args>
+	PoolHandle<T> Spawn(Args &&... args)
 	{
-		for (size_t i = 0; i < count; ++i)
+		if (mCount == 0)
 		{
-			// Destruct only busy objects, not the free ones (they are already destructed)
-			if (ptr[i].mStamp != PoolStamp_Free && ptr[i].mStamp != PoolStamp_NotConstructed)
+			mCount = mPool.PopFreeIndices(mIndices, mBatchSize);
+			if (mCount == 0)
 			{
-				ptr[i].mObject.~T();
+				throw std::bad_alloc();
 			}
+			++mStats.mRefillCount;
 		}
-		MemoryFree(ptr);
+		// Index stays in the cache if constructor throws
+		const auto handle = mPool.Construct(mIndices[mCount - 1], std::forward<Args>(args)...);
+		--mCount;
+		++mStats.mSpawnCount;
+		return handle;
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////////
-	/// Allocates new memory block
+	/// Same as ConcurrentPool::Return, but keeps free record in the cache
 	///////////////////////////////////////////////////////////////////////////////////////
-	void AllocMemory()
+	void Return(const PoolHandle<T> &handle)
 	{
-		const size_t sizeBytes = sizeof(PoolRecord<T>) * mCapacity;
-		mRecords = reinterpret_cast<PoolRecord<T> *>(MemoryAlloc(sizeBytes));
-		if (!mRecords)
+		if (mPool.Destruct(handle))
 		{
-			throw std::bad_alloc();
+			if (mCount == mBatchSize * 2)
+			{
+				// Give back the oldest batch, recently freed records are cache-hot
+				mPool.PushFreeIndices(mIndices, mBatchSize);
+				memmove(mIndices, mIndices + mBatchSize, sizeof(PoolIndex) * mBatchSize);
+				mCount -= mBatchSize;
+				++mStats.mFlushCount;
+			}
+			mIndices[mCount++] = handle.GetIndex();
+			++mStats.mReturnCount;
 		}
-		memset(mRecords, PoolStamp_NotConstructed, sizeBytes);
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////////
-	/// Returns index of next free record
+	/// Gives every cached index back to the pool
 	///////////////////////////////////////////////////////////////////////////////////////
-	PoolIndex GetFreeIndex()
+	void Flush() noexcept
 	{
-		const auto index = mFreeQueue.front();
-		mFreeQueue.pop();
-		return index;
+		if (mCount != 0)
+		{
+			mPool.PushFreeIndices(mIndices, mCount);
+			mCount = 0;
+			++mStats.mFlushCount;
+		}
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////////
-	// Internals
+	/// Returns count of free indices in the cache
 	///////////////////////////////////////////////////////////////////////////////////////
+	size_t GetCachedCount() const noexcept
+	{
+		return mCount;
+	}
 
-	/// By default, grow rate is golden ratio
-	static constexpr float GrowRate = 1.618f;
-	static_assert(GrowRate > 1.0f, "Grow rate must be greater than 1");
-
-	size_t mSpawnedCount { 0 };
-	PoolStamp mGlobalStamp { PoolStamp_Origin };
-	PoolRecord<T> *mRecords { nullptr };
-	size_t mCapacity { 0 };
-	std::queue<PoolIndex> mFreeQueue;
-	MemoryAllocFunc MemoryAlloc;
-	MemoryFreeFunc MemoryFree;
+	///////////////////////////////////////////////////////////////////////////////////////
+	/// Returns counters of this cache
+	///////////////////////////////////////////////////////////////////////////////////////
+	const PoolCacheStats &GetStats() const noexcept
+	{
+		return mStats;
+	}
+private:
+	ConcurrentPool<T, ChunkSize, Allocator> &mPool;
+	size_t mBatchSize;
+	size_t mCount { 0 };
+	PoolIndex *mIndices;
+	PoolCacheStats mStats;
 };
 
-#endif
\ No newline at end of file
+#endif
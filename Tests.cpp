@@ -1,10 +1,20 @@
 #include "Pool.h"
+#include "PerfCounters.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <list>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #define ONLY_POOL_TESTS 0
@@ -14,6 +24,9 @@ using namespace std;
 // Performance test
 constexpr int ObjectCountPerTest = 2000000;
 
+// Hardware counters for performance tests, enabled by --perf
+bool CollectPerfCounters = false;
+
 class Vec3
 {
 public:
@@ -252,276 +265,3170 @@ public:
 	}
 };
 
-void RunSanityTests()
+// 4-byte handles
+struct TinyTraits : PoolTraits
 {
-	cout << endl << endl;
-	cout << "Running sanity tests" << endl;
-	{
-		Pool<PoolableNode> pool(1);
-		auto a = pool.Spawn();
-		pool[a].SetName("A");
-		auto b = pool.Spawn();
-		pool[b].SetName("B");
-		auto c = pool.Spawn();
-		pool[c].SetName("C");
-		pool.Return(a);
-		pool.Return(b);
-		pool.Return(c);
-		a = pool.Spawn();
-		pool[a].SetName("A");
-	}
+	static constexpr unsigned IndexBits = 24;
+	static constexpr unsigned StampBits = 8;
+};
 
-	{
-		Pool<PoolableNode> pool(1024);
+struct StatsTraits : PoolTraits
+{
+	static constexpr bool CollectStats = true;
+};
 
-		auto handle = pool.Spawn();
-		assert(pool.IsValid(handle));
-		pool.Return(handle);
+struct FixedGrowthTraits : PoolTraits
+{
+	using Growth = FixedPoolGrowth<10>;
+};
 
-		assert(!pool.IsValid(handle));
-		assert(pool.GetSpawnedCount() == 0);
+struct CappedTraits : PoolTraits
+{
+	using Growth = CappedPoolGrowth<100, PowerOfTwoPoolGrowth>;
+};
 
-		auto newHandle = pool.Spawn();
-		assert(pool.IsValid(newHandle));
-		assert(pool.GetSpawnedCount() == 1);
-		pool.Return(newHandle);
-	}
+struct LifoTraits : PoolTraits
+{
+	static constexpr PoolReuse Reuse = PoolReuse::Lifo;
+};
 
-	cout << "Passed" << endl;
-}
+struct LowestIndexTraits : PoolTraits
+{
+	static constexpr PoolReuse Reuse = PoolReuse::LowestIndex;
+};
 
-void RunRandomObjectPerformanceTest()
+struct DeferredTraits : VirtualPoolTraits<1 << 20>
 {
-	cout << endl << endl;
-	cout << "Running random object performance test" << endl;
-	cout << "Object count: " << ObjectCountPerTest << endl;
+	static constexpr bool DeferredReturn = true;
+};
 
-	// PoolableNode
-	{
-		Pool<PoolableNode> pool(1024);
+struct NoPrefetchTraits : PoolTraits
+{
+	static constexpr size_t PrefetchDistance = 0;
+};
 
-		auto lastTime = chrono::high_resolution_clock::now();
-		for (int i = 0; i < ObjectCountPerTest; ++i)
-		{
-			auto parent = pool.Spawn();
-			pool[parent].SetName("Parent");
-			auto child = pool.Spawn();
-			pool[child].SetName("Child");
-			pool[child].AttachTo(parent);
-			pool.Return(parent);
-		}
+struct NearPrefetchTraits : PoolTraits
+{
+	static constexpr size_t PrefetchDistance = 8;
+};
 
-		cout << "Pool<Node>: "
-			<< chrono::duration_cast<chrono::microseconds>(
-				chrono::high_resolution_clock::now() - lastTime)
-			.count()
-			<< " microseconds" << endl;
-		// cout << "Pool size: " << pool.GetSize() << endl;
+// Resolves live, returned and released handles in shuffled order
+template<typename PoolType>
+void CheckResolve()
+{
+	PoolType pool(1);
+	vector<typename PoolType::Handle> handles;
+	for (int i = 0; i < 1000; ++i)
+	{
+		handles.push_back(pool.Spawn(i));
 	}
-
-#if !ONLY_POOL_TESTS
-	// OrdinaryNode
+	for (int i = 0; i < 1000; i += 3)
 	{
-		auto lastTime = chrono::high_resolution_clock::now();
-
-		for (int i = 0; i < ObjectCountPerTest; ++i)
-		{
-			auto parent = make_shared<OrdinaryNode>();
-			parent->SetName("Parent");
-			auto child = make_shared<OrdinaryNode>();
-			child->SetName("Child");
-			child->AttachTo(parent);
-			parent.reset();
-		}
-
-		cout << "shared_ptr<Node>: "
-			<< chrono::duration_cast<chrono::microseconds>(
-				chrono::high_resolution_clock::now() - lastTime)
-			.count()
-			<< " microseconds" << endl;
+		pool.Return(handles[i]);
 	}
-#endif
-	cout << "Passed" << endl;
+	// Handles past the last live record are released
+	for (int i = 990; i < 1000; ++i)
+	{
+		pool.Return(handles[i]);
+	}
+	pool.Trim();
+	handles.push_back(typename PoolType::Handle());
+	reverse(handles.begin(), handles.end());
+	vector<int *> objects(handles.size());
+	const auto validCount = pool.Resolve(handles.data(), handles.size(), objects.data());
+	assert(validCount == pool.GetSpawnedCount());
+	for (size_t i = 0; i < handles.size(); ++i)
+	{
+		assert(pool.IsValid(handles[i]) == (objects[i] != nullptr));
+		assert(!objects[i] || objects[i] == &pool[handles[i]]);
+	}
+	int sum = 0;
+	size_t visited = 0;
+	pool.ForEachHandle(handles.data(), handles.size(), [&](int &value)
+	{
+		sum += value;
+		++visited;
+	});
+	int expected = 0;
+	for (auto &value : pool)
+	{
+		expected += value;
+	}
+	assert(visited == validCount && sum == expected);
 }
 
-void RunHugeAmountOfObjectsPerformanceTest()
+// Owner of heap memory, moved by move constructor and destructor per object
+struct OwnedBuffer
 {
-	class Foo
+	unique_ptr<int> mData;
+
+	OwnedBuffer() = default;
+	explicit OwnedBuffer(int value) : mData(new int(value))
 	{
-	private:
-		int mBar;
-		string mBaz;
+	}
+};
 
-	public:
-		Foo()
-		{
-		}
-		Foo(int bar) : mBar(bar)
-		{
-		}
-	};
+// Same, but relocated as raw bytes
+struct RelocatableBuffer : OwnedBuffer
+{
+	using OwnedBuffer::OwnedBuffer;
+};
 
+template<>
+struct PoolTriviallyRelocatable<RelocatableBuffer> : std::true_type
+{
+};
 
+// Relocated as raw bytes only, has neither move nor copy constructor
+struct PinnedBuffer : OwnedBuffer
+{
+	using OwnedBuffer::OwnedBuffer;
+	PinnedBuffer(PinnedBuffer &&) = delete;
+};
 
-	cout << endl << endl;
-	cout << "Running huge amount of objects performance test" << endl;
-	cout << "Object count: " << ObjectCountPerTest << endl;
+template<>
+struct PoolTriviallyRelocatable<PinnedBuffer> : std::true_type
+{
+};
 
-	{
-		auto lastTime = chrono::high_resolution_clock::now();
+static_assert(PoolTriviallyRelocatable<Vec3>::value && !PoolTriviallyRelocatable<OwnedBuffer>::value,
+	"Trivially copyable types are trivially relocatable by default");
 
-		vector<PoolHandle<Foo>> handles;
-		handles.reserve(ObjectCountPerTest);
-		Pool<Foo> pool(ObjectCountPerTest);
+// Allocator that is not malloc, pool must not realloc its blocks
+size_t AllocationCount = 0;
 
-		for (int i = 0; i < ObjectCountPerTest; ++i)
-		{
-			handles.push_back(pool.Spawn(1234));
-		}
+void *CountingAlloc(size_t size)
+{
+	++AllocationCount;
+	return malloc(size);
+}
 
-		for (const auto &handle : handles)
-		{
-			pool.Return(handle);
-		}
+// Allocator that fails on demand
+bool FailAllocations = false;
 
-		cout << "Pool<Foo>: "
-			<< chrono::duration_cast<chrono::microseconds>(
-				chrono::high_resolution_clock::now() - lastTime)
-			.count()
-			<< " microseconds" << endl;
-	}
+void *FailingAlloc(size_t size)
+{
+	return FailAllocations ? nullptr : malloc(size);
+}
 
-#if !ONLY_POOL_TESTS
+// Grows and shrinks pool of unique owners, every object must survive with its value
+template<typename PoolType>
+void CheckRelocation()
+{
+	PoolType pool(1);
+	vector<typename PoolType::Handle> handles;
+	for (int i = 0; i < 1000; ++i)
 	{
-		auto lastTime = chrono::high_resolution_clock::now();
-
-		vector<unique_ptr<Foo>> pointers;
-		pointers.reserve(ObjectCountPerTest);
-		for (int i = 0; i < ObjectCountPerTest; ++i)
-		{
-			pointers.push_back(make_unique<Foo>(1234));
-		}
-
-		for (auto &ptr : pointers)
-		{
-			ptr.reset();
-		}
-
-		cout << "unique_ptr<Foo>: "
-			<< chrono::duration_cast<chrono::microseconds>(
-				chrono::high_resolution_clock::now() - lastTime)
-			.count()
-			<< " microseconds" << endl;
+		handles.push_back(pool.Spawn(i));
+	}
+	for (int i = 500; i < 1000; ++i)
+	{
+		pool.Return(handles[i]);
+	}
+	pool.Trim();
+	for (int i = 0; i < 2000; ++i)
+	{
+		pool.Spawn(-1);
+	}
+	for (int i = 0; i < 500; ++i)
+	{
+		assert(*pool[handles[i]].mData == i);
 	}
-#endif
-	cout << "Passed" << endl;
 }
 
-void RunDataLocalityPerformanceTest()
+// Object whose copy and move throw on demand
+struct ThrowingCopy
 {
-	class Foo
+	static bool Fail;
+	static int LiveCount;
+
+	ThrowingCopy(int value) : mValue(value)
 	{
-	private:
-		Matrix mA;
-		Matrix mB;
-		Matrix mResult;
-	public:
-		Foo()
+		++LiveCount;
+	}
+
+	ThrowingCopy(const ThrowingCopy &other) : mValue(other.mValue)
+	{
+		if (Fail)
 		{
-			mA.FromRotationScaleTranslation({ 0, 0, 0, 1 }, { 1, 1, 1 }, { 1, 0, 0 });
-			mB.FromRotationScaleTranslation({ 1, 0, 0, 1 }, { 1, 1, 1 }, { 1, 1, 0 });
+			throw runtime_error("copy");
 		}
+		++LiveCount;
+	}
 
-		void Calculate()
+	ThrowingCopy(ThrowingCopy &&other) : mValue(other.mValue)
+	{
+		if (Fail)
 		{
-			mResult = mA * mB;
+			throw runtime_error("move");
 		}
-	};
+		++LiveCount;
+	}
 
-	// Performance test
-	constexpr int iterCount = 20;
+	~ThrowingCopy()
+	{
+		--LiveCount;
+	}
 
-	cout << endl << endl;
-	cout << "Running data locality performance test" << endl;
-	cout << "Object count: " << ObjectCountPerTest << endl;
+	int mValue;
+};
 
-	long long totalTime = 0;
+bool ThrowingCopy::Fail = false;
+int ThrowingCopy::LiveCount = 0;
 
-#if !ONLY_POOL_TESTS
+// Growth that throws in the middle of relocation keeps every object in place
+template<typename PoolType>
+void CheckThrowingRelocation()
+{
 	{
-		vector<unique_ptr<Foo>> pointers;
-		pointers.reserve(ObjectCountPerTest);
-		for (int i = 0; i < ObjectCountPerTest; ++i)
+		PoolType pool(1);
+		vector<typename PoolType::Handle> handles;
+		while (handles.size() < 10 || pool.GetSpawnedCount() < pool.GetCapacity())
 		{
-			pointers.push_back(make_unique<Foo>());
+			handles.push_back(pool.Spawn(static_cast<int>(handles.size())));
 		}
-
-		for (int k = 0; k < iterCount; ++k)
+		const auto capacity = pool.GetCapacity();
+		ThrowingCopy::Fail = true;
+		bool thrown = false;
+		try
 		{
-			auto lastTime = chrono::high_resolution_clock::now();
-			for (const auto &ptr : pointers)
-			{
-				ptr->Calculate();
-			}
-
-			totalTime += chrono::duration_cast<chrono::microseconds>(
-				chrono::high_resolution_clock::now() - lastTime)
-				.count();
+			pool.Spawn(-1);
 		}
-
-		for (auto &ptr : pointers)
+		catch (const runtime_error &)
 		{
-			ptr.reset();
+			thrown = true;
+		}
+		ThrowingCopy::Fail = false;
+		assert(thrown && pool.GetCapacity() == capacity && ThrowingCopy::LiveCount == static_cast<int>(handles.size()));
+		for (size_t i = 0; i < handles.size(); ++i)
+		{
+			assert(pool.IsValid(handles[i]) && pool[handles[i]].mValue == static_cast<int>(i));
 		}
+		handles.push_back(pool.Spawn(-1));
+		assert(pool.GetCapacity() > capacity && pool[handles[0]].mValue == 0);
 	}
+	assert(ThrowingCopy::LiveCount == 0);
+}
 
-	cout << "unique_ptr<Foo>: " << totalTime / iterCount << " microseconds" << endl;
-#endif
+// Allocator state that checks size and alignment of every freed block
+struct TrackingHeap
+{
+	void *Allocate(size_t bytes, size_t alignment)
+	{
+		const auto memory = PoolHeapAllocator::Allocate(bytes, alignment);
+		assert(reinterpret_cast<uintptr_t>(memory) % alignment == 0);
+		mBlocks[memory] = make_pair(bytes, alignment);
+		return memory;
+	}
 
+	void Deallocate(void *ptr, size_t bytes, size_t alignment) noexcept
+	{
+		const auto block = mBlocks.find(ptr);
+		assert(block != mBlocks.end() && block->second == make_pair(bytes, alignment));
+		mBlocks.erase(block);
+		PoolHeapAllocator::Deallocate(ptr, bytes, alignment);
+	}
 
+	unordered_map<void *, pair<size_t, size_t>> mBlocks;
+};
 
-	{
-		vector<PoolHandle<Foo>> handles;
-		handles.reserve(ObjectCountPerTest);
-		Pool<Foo> pool(ObjectCountPerTest);
+template<typename Base>
+struct TrackedTraits : Base
+{
+	using Allocator = PoolAllocatorRef<TrackingHeap>;
+};
 
-		for (int i = 0; i < ObjectCountPerTest; ++i)
-		{
-			handles.push_back(pool.Spawn());
-		}
+struct HeapAllocatorTraits : PoolTraits
+{
+	using Allocator = PoolHeapAllocator;
+};
 
-		totalTime = 0;
-		for (int k = 0; k < iterCount; ++k)
-		{
-			auto lastTime = chrono::high_resolution_clock::now();
+struct ArenaAllocatorTraits : PoolTraits
+{
+	using Allocator = PoolAllocatorRef<PoolMemoryArena<>>;
+};
+
+struct alignas(64) AlignedVec
+{
+	AlignedVec(int id) : mValues { 0, 0, 0, 0 }, mId(id)
+	{
+	}
+
+	float mValues[4];
+	int mId;
+};
+
+// Grows and churns pool of over-aligned objects, every object must stay aligned
+template<typename PoolType, typename... Args>
+void CheckAlignment(Args &&... args)
+{
+	PoolType pool(1, std::forward<Args>(args)...);
+	vector<typename PoolType::Handle> handles;
+	for (int i = 0; i < 1000; ++i)
+	{
+		handles.push_back(pool.Spawn(i));
+	}
+	for (int i = 0; i < 1000; i += 2)
+	{
+		pool.Return(handles[i]);
+	}
+	for (int i = 0; i < 1000; ++i)
+	{
+		handles.push_back(pool.Spawn(-i));
+	}
+	for (size_t i = 1; i < handles.size(); i += i < 1000 ? 2 : 1)
+	{
+		const auto &object = pool[handles[i]];
+		assert(reinterpret_cast<uintptr_t>(&object) % alignof(AlignedVec) == 0);
+		assert(object.mId == (i < 1000 ? static_cast<int>(i) : 1000 - static_cast<int>(i)));
+	}
+}
+
+// Same as CheckAlignment, but every block must go back to the allocator with its size
+template<typename PoolType>
+void CheckAllocator()
+{
+	TrackingHeap heap;
+	CheckAlignment<PoolType>(typename PoolType::Allocator(heap));
+	assert(heap.mBlocks.empty());
+}
+
+// Column pools, concurrent pool and memory resource take every block from the 
+// allocator and give it back with its size and alignment
+void CheckColumnAllocators()
+{
+	using Allocator = PoolAllocatorRef<TrackingHeap>;
+	TrackingHeap heap;
+	{
+		BasicSoaPool<Allocator, Vec3, float, int> soa(1, heap);
+		BasicMultiPool<Allocator, AlignedVec, string> multi(1, heap);
+		ConcurrentPool<AlignedVec, 64, Allocator> concurrent(1, 1 << 16, heap);
+		vector<decltype(multi)::Handle> handles;
+		for (int i = 0; i < 1000; ++i)
+		{
+			soa.Spawn(Vec3(), float(i), i);
+			handles.push_back(multi.Spawn(AlignedVec(i), to_string(i)));
+			concurrent.Return(concurrent.Spawn(i));
+		}
+		assert(reinterpret_cast<uintptr_t>(soa.GetColumn<0>().GetData()) % decltype(soa)::ColumnAlignment == 0);
+		for (int i = 0; i < 1000; ++i)
+		{
+			assert(reinterpret_cast<uintptr_t>(&multi.Get<AlignedVec>(handles[i])) % alignof(AlignedVec) == 0);
+			assert(multi.Get<AlignedVec>(handles[i]).mId == i && multi.Get<string>(handles[i]) == to_string(i));
+		}
+		assert(!heap.mBlocks.empty());
+	}
+#if SMART_POOL_HAS_PMR
+	{
+		PoolMemoryResource<Allocator> resource(heap);
+		// Over-aligned block goes to the allocator
+		const auto memory = resource.allocate(100, 256);
+		assert(heap.mBlocks.count(memory) == 1);
+		resource.deallocate(memory, 100, 256);
+	}
+#endif
+	assert(heap.mBlocks.empty());
+}
+
+// Keeps first 'kept' of 'count' objects, trims the rest and grows back over them
+template<typename PoolType>
+void CheckTrim(size_t count, size_t kept)
+{
+	PoolType pool(0);
+	vector<typename PoolType::Handle> handles;
+	for (size_t i = 0; i < count; ++i)
+	{
+		handles.push_back(pool.Spawn(static_cast<int>(i)));
+	}
+	for (size_t i = kept; i < count; ++i)
+	{
+		pool.Return(handles[i]);
+	}
+	// Free record below the last live one stays in the pool
+	pool.Return(handles[0]);
+	const auto capacity = pool.GetCapacity();
+	const auto released = pool.Trim();
+	assert(released > 0 && pool.GetCapacity() == capacity - released);
+	assert(pool.GetCapacity() >= kept && pool.GetCapacity() < count);
+	assert(pool.Trim() == 0);
+	assert(pool.GetSpawnedCount() == kept - 1);
+	for (size_t i = 1; i < kept; ++i)
+	{
+		assert(pool.IsValid(handles[i]) && pool[handles[i]] == static_cast<int>(i));
+	}
+	vector<typename PoolType::Handle> spawned;
+	for (size_t i = 0; i < count; ++i)
+	{
+		spawned.push_back(pool.Spawn(-1));
+	}
+	for (size_t i = kept; i < count; ++i)
+	{
+		assert(!pool.IsValid(handles[i]));
+	}
+	assert(!pool.IsValid(handles[0]));
+	for (const auto &handle : spawned)
+	{
+		assert(pool.IsValid(handle) && pool[handle] == -1);
+	}
+	assert(pool.GetSpawnedCount() == count + kept - 1);
+}
+
+void RunSanityTests()
+{
+	cout << endl << endl;
+	cout << "Running sanity tests" << endl;
+	{
+		Pool<PoolableNode> pool(1);
+		auto a = pool.Spawn();
+		pool[a].SetName("A");
+		auto b = pool.Spawn();
+		pool[b].SetName("B");
+		auto c = pool.Spawn();
+		pool[c].SetName("C");
+		pool.Return(a);
+		pool.Return(b);
+		pool.Return(c);
+		a = pool.Spawn();
+		pool[a].SetName("A");
+	}
+
+	{
+		Pool<PoolableNode> pool(1024);
+
+		auto handle = pool.Spawn();
+		assert(pool.IsValid(handle));
+		pool.Return(handle);
+
+		assert(!pool.IsValid(handle));
+		assert(pool.GetSpawnedCount() == 0);
+
+		auto newHandle = pool.Spawn();
+		assert(pool.IsValid(newHandle));
+		assert(pool.GetSpawnedCount() == 1);
+		pool.Return(newHandle);
+	}
+
+	{
+		// Returned records are reused without growth
+		Pool<PoolableNode> pool(2);
+		auto a = pool.Spawn();
+		auto b = pool.Spawn();
+		pool.Return(a);
+		auto c = pool.Spawn();
+		assert(pool.GetCapacity() == 2);
+		assert(!pool.IsValid(a) && pool.IsValid(b) && pool.IsValid(c));
+		pool.Return(b);
+		pool.Return(c);
+		a = pool.Spawn();
+		b = pool.Spawn();
+		assert(pool.GetCapacity() == 2);
+		assert(pool.GetSpawnedCount() == 2);
+	}
+
+	{
+		// Destructor of pool skips objects returned by destructors of other objects
+		Pool<PoolableNode> pool(16);
+		auto root = pool.Spawn();
+		for (int i = 0; i < 8; ++i)
+		{
+			pool[pool.Spawn()].AttachTo(root);
+		}
+	}
+
+	{
+		// Handles are compact, stamps are tracked per record
+		static_assert(sizeof(PoolHandle<PoolableNode>) == 8, "Default handle must be 8 bytes");
+		static_assert(sizeof(PoolHandle<PoolableNode, 24, 8>) == 4, "24/8 handle must be 4 bytes");
+
+		Pool<int, TinyTraits> pool(1);
+		PoolHandle<int, 24, 8> handle = pool.Spawn(1);
+		const auto stale = handle;
+		pool.Return(handle);
+		// Record is reused 127 times, then it is retired
+		for (int i = 0; i < 126; ++i)
+		{
+			handle = pool.Spawn(i);
+			assert(handle.GetIndex() == 0 && pool.IsValid(handle) && !pool.IsValid(stale));
+			pool.Return(handle);
+			assert(!pool.IsValid(handle));
+		}
+		assert(pool.GetRetiredCount() == 1 && pool.GetCapacity() == 1);
+		handle = pool.Spawn(42);
+		assert(handle.GetIndex() == 1 && pool.GetCapacity() == 2);
+		// Returning stale handle must not destroy object
+		pool.Return(stale);
+		assert(pool.IsValid(handle) && pool.GetSpawnedCount() == 1);
+		assert(!pool.IsValid(PoolHandle<int, 24, 8>()));
+	}
+
+	{
+		// Iteration must visit every live object exactly once, including the last record
+		Pool<int> pool(130);
+		vector<PoolHandle<int>> handles;
+		for (int i = 0; i < 130; ++i)
+		{
+			handles.push_back(pool.Spawn(i));
+		}
+		for (int i = 0; i < 130; ++i)
+		{
+			if (i % 3 != 0 && i != 128)
+			{
+				pool.Return(handles[i]);
+			}
+		}
+		int sum = 0, count = 0;
+		pool.ForEach([&](int &value) { sum += value; ++count; });
+		assert(count == 45 && count == static_cast<int>(pool.GetSpawnedCount()));
+		int iteratedSum = 0;
+		for (auto it = pool.begin(); it != pool.end(); ++it)
+		{
+			assert(pool.IsValid(it.GetHandle()));
+			iteratedSum += *it;
+		}
+		assert(sum == iteratedSum);
+		assert(*pool.begin() == 0);
+		// Objects may be returned while visited
+		pool.ForEach([&](int &value) { pool.Return(pool.HandleByPointer(&value)); });
+		assert(pool.GetSpawnedCount() == 0 && pool.begin() == pool.end());
+	}
+
+	{
+		// Segmented storage must never move live objects
+		using Traits = SegmentedPoolTraits<4>;
+		struct Segmented : public Poolable<Segmented, Traits>
+		{
+			string mName { "Segmented" };
+		};
+		Pool<Segmented, Traits> pool(1);
+		assert(pool.GetCapacity() == 4);
+
+		auto first = pool.Spawn();
+		Segmented *firstPtr = &pool[first];
+		vector<PoolHandle<Segmented>> handles;
+		for (int i = 0; i < 100; ++i)
+		{
+			handles.push_back(pool.Spawn());
+		}
+		assert(pool.GetCapacity() >= 101);
+		assert(&pool[first] == firstPtr);
+		assert(firstPtr->ParentPool() == &pool);
+
+		auto byPointer = pool.HandleByPointer(&pool[handles[57]]);
+		assert(pool.IsValid(byPointer));
+		assert(&pool[byPointer] == &pool[handles[57]]);
+
+		Segmented *freedPtr = &pool[handles[58]];
+		for (const auto &handle : handles)
+		{
+			pool.Return(handle);
+		}
+		assert(pool.GetSpawnedCount() == 1);
+
+		// Memory of a free record has no handle, returning it twice changes nothing
+		const auto freed = pool.HandleByPointer(freedPtr);
+		assert(freed == PoolHandle<Segmented>() && !pool.IsValid(freed));
+		pool.Return(freed);
+		pool.ReturnN(&freed, 1);
+		assert(pool.GetSpawnedCount() == 1);
+		vector<Segmented *> reused;
+		for (int i = 0; i < 100; ++i)
+		{
+			reused.push_back(&pool[pool.Spawn()]);
+		}
+		sort(reused.begin(), reused.end());
+		assert(unique(reused.begin(), reused.end()) == reused.end() && pool.GetSpawnedCount() == 101);
+	}
+
+	{
+		// Stats are collected only when enabled, disabled stats take no space
+		static_assert(sizeof(Pool<int>) < sizeof(Pool<int, StatsTraits>), "Stats must be opt-in");
+		Pool<int, StatsTraits> pool(2);
+		vector<PoolHandle<int>> handles;
+		for (int i = 0; i < 10; ++i)
+		{
+			handles.push_back(pool.Spawn(i));
+		}
+		pool.Return(handles[0]);
+		pool.Return(handles[0]);
+		pool.ReturnN(handles.data() + 1, 4);
+		assert(pool.IsValid(handles[9]) && !pool.IsValid(handles[0]) && !pool.IsValid(handles[1]));
+
+		auto stats = pool.GetStats();
+		assert(stats.mSpawnCount == 10 && stats.mReturnCount == 5 && stats.mHighWaterMark == 10);
+		assert(stats.mGrowthCount > 0 && stats.mGrowthBytesMoved > 0);
+		assert(stats.mValidationCount == 3 && stats.mStaleHandleCount == 2);
+		assert(stats.mLiveCount == 5 && stats.mCapacity == pool.GetCapacity());
+		assert(stats.GetOccupancy() > 0.0 && stats.GetOccupancy() <= 1.0);
+		pool.ResetStats();
+		assert(pool.GetStats().mSpawnCount == 0 && pool.GetStats().mLiveCount == 5);
+
+		Pool<int> plain(2);
+		plain.Spawn();
+		assert(plain.GetStats().mSpawnCount == 0 && plain.GetStats().mLiveCount == 1);
+	}
+
+	{
+		// Snapshot keeps every handle valid after restore, mapped pages are private
+		struct Body
+		{
+			float mPosition[3];
+			int mId;
+		};
+		const char *path = "pool_snapshot_test.bin";
+		Pool<Body> pool(16);
+		vector<PoolHandle<Body>> handles;
+		for (int i = 0; i < 1000; ++i)
+		{
+			handles.push_back(pool.Spawn(Body { { 0, 1, 2 }, i }));
+		}
+		for (int i = 0; i < 1000; i += 5)
+		{
+			pool.Return(handles[i]);
+		}
+		assert(pool.SaveSnapshot(path));
+
+		Pool<Body> restored(1);
+		assert(restored.MapSnapshot(path));
+		assert(restored.GetCapacity() == pool.GetCapacity() && restored.GetSpawnedCount() == 800);
+		for (int i = 0; i < 1000; ++i)
+		{
+			assert(restored.IsValid(handles[i]) == (i % 5 != 0));
+			if (i % 5 != 0)
+			{
+				assert(restored[handles[i]].mId == i);
+				restored[handles[i]].mId = -1;
+			}
+		}
+		// Free list is restored: returned records are reused in the same order
+		assert(restored.Spawn().GetIndex() == pool.Spawn().GetIndex());
+		int liveCount = 0;
+		restored.ForEach([&](Body &) { ++liveCount; });
+		assert(liveCount == 801);
+		// Growth moves records off the mapping
+		while (restored.GetSpawnedCount() < 3000)
+		{
+			restored.Spawn(Body { { 0, 0, 0 }, 7 });
+		}
+		assert(restored[handles[1]].mId == -1);
+
+		Pool<Body> again(1);
+		assert(again.MapSnapshot(path) && again[handles[1]].mId == 1);
+		Pool<int> other(1);
+		assert(!other.MapSnapshot(path) && !other.MapSnapshot("missing_snapshot.bin"));
+
+		// Truncated or damaged file is rejected, pool keeps its content
+		vector<char> bytes;
+		{
+			ifstream input(path, ios::binary);
+			bytes.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+		}
+		const char *tamperedPath = "pool_snapshot_tampered.bin";
+		auto isRejected = [&](const vector<char> &content)
+		{
+			{
+				ofstream output(tamperedPath, ios::binary);
+				output.write(content.data(), static_cast<streamsize>(content.size()));
+			}
+			const bool mapped = again.MapSnapshot(tamperedPath);
+			assert(again.IsValid(handles[1]) && again[handles[1]].mId == 1);
+			return !mapped;
+		};
+		auto tampered = [&](size_t offset, uint64_t value)
+		{
+			auto content = bytes;
+			memcpy(content.data() + offset, &value, sizeof(value));
+			return content;
+		};
+		assert(isRejected(vector<char>(bytes.begin(), bytes.end() - 8)));
+		assert(isRejected(vector<char>(bytes.begin(), bytes.begin() + bytes.size() / 2)));
+		assert(isRejected(tampered(offsetof(PoolSnapshotHeader, mBitmapWordCount), 1 << 20)));
+		assert(isRejected(tampered(offsetof(PoolSnapshotHeader, mBitmapOffset), ~uint64_t(0) - 7)));
+		assert(isRejected(tampered(offsetof(PoolSnapshotHeader, mRecordsOffset), ~uint64_t(0) - 63)));
+		assert(isRejected(tampered(offsetof(PoolSnapshotHeader, mRecordsOffset), 65)));
+		assert(isRejected(tampered(offsetof(PoolSnapshotHeader, mFrontier), pool.GetCapacity() + 1)));
+		assert(isRejected(tampered(offsetof(PoolSnapshotHeader, mFreeHead), pool.GetCapacity())));
+		assert(isRejected(tampered(offsetof(PoolSnapshotHeader, mFreeTail), pool.GetCapacity())));
+		assert(isRejected(tampered(offsetof(PoolSnapshotHeader, mSpawnedCount), ~uint64_t(0))));
+		assert(isRejected(tampered(offsetof(PoolSnapshotHeader, mRetiredCount), pool.GetCapacity())));
+		// Occupancy and free list must agree with header
+		assert(isRejected(tampered(offsetof(PoolSnapshotHeader, mSpawnedCount), 799)));
+		assert(isRejected(tampered(offsetof(PoolSnapshotHeader, mFreeHead), handles[1].GetIndex())));
+		assert(isRejected(tampered(offsetof(PoolSnapshotHeader, mFreeTail), handles[5].GetIndex())));
+		PoolSnapshotHeader header;
+		memcpy(&header, bytes.data(), sizeof(header));
+		const auto firstFreeLink = static_cast<size_t>(header.mRecordsOffset)
+			+ sizeof(Pool<Body>::Record) - sizeof(Body);
+		assert(isRejected(tampered(firstFreeLink, pool.GetCapacity())));
+		assert(isRejected(tampered(firstFreeLink, 0)));
+		assert(!isRejected(bytes));
+		remove(tamperedPath);
+		remove(path);
+	}
+
+	{
+		// Virtual storage grows in place up to its max capacity
+		using Traits = VirtualPoolTraits<1000>;
+		Pool<string, Traits> pool(1);
+		auto first = pool.Spawn("first");
+		string *firstPtr = &pool[first];
+		for (int i = 1; i < 1000; ++i)
+		{
+			pool.Spawn(to_string(i));
+		}
+		assert(pool.GetCapacity() == 1000 && &pool[first] == firstPtr && *firstPtr == "first");
+		bool thrown = false;
+		try
+		{
+			pool.Spawn();
+		}
+		catch (const bad_alloc &)
+		{
+			thrown = true;
+		}
+		assert(thrown && pool.GetSpawnedCount() == 1000);
+		pool.Return(first);
+		assert(pool.Spawn("reused").GetIndex() == first.GetIndex());
+	}
+
+	{
+		// Split storage keeps objects aligned across growth, stamps apart from objects
+		using Traits = SplitPoolTraits<64>;
+		Pool<string, Traits> pool(1);
+		vector<PoolHandle<string>> handles;
+		for (int i = 0; i < 100; ++i)
+		{
+			handles.push_back(pool.Spawn(to_string(i)));
+			assert(reinterpret_cast<uintptr_t>(&pool[handles.back()]) % 64 == 0);
+		}
+		for (int i = 0; i < 100; i += 2)
+		{
+			pool.Return(handles[i]);
+		}
+		for (int i = 1; i < 100; i += 2)
+		{
+			assert(pool[handles[i]] == to_string(i));
+			assert(pool.IsValid(pool.HandleByPointer(&pool[handles[i]])));
+		}
+
+		unique_ptr<bool[]> valid(new bool[handles.size()]);
+		assert(pool.IsValid(handles.data(), handles.size(), valid.get()) == 50);
+		for (size_t i = 0; i < handles.size(); ++i)
+		{
+			assert(valid[i] == (i % 2 == 1));
+		}
+	}
+
+	{
+		// Batched spawn and return behave as loops of single calls
+		Pool<string> pool(8);
+		vector<PoolHandle<string>> handles(100);
+		pool.SpawnN(handles.size(), handles.data(), "batch");
+		assert(pool.GetSpawnedCount() == 100 && pool.GetCapacity() >= 100);
+		for (const auto &handle : handles)
+		{
+			assert(pool.IsValid(handle) && pool[handle] == "batch");
+		}
+		pool.ReturnN(handles.data(), 50);
+		pool.ReturnN(handles.data(), 50);
+		assert(pool.GetSpawnedCount() == 50 && !pool.IsValid(handles[0]));
+		const auto capacity = pool.GetCapacity();
+		pool.SpawnN(50, handles.data(), 3, 'x');
+		assert(pool.GetCapacity() == capacity && pool[handles[49]] == "xxx");
+
+		// Objects spawned before throwing constructor are returned
+		struct Fragile
+		{
+			Fragile(int &budget)
+			{
+				if (--budget < 0)
+				{
+					throw runtime_error("out of budget");
+				}
+			}
+		};
+		Pool<Fragile> fragilePool(4);
+		vector<PoolHandle<Fragile>> fragileHandles(10);
+		int budget = 6;
+		try
+		{
+			fragilePool.SpawnN(fragileHandles.size(), fragileHandles.data(), budget);
+			assert(false);
+		}
+		catch (const runtime_error &)
+		{
+		}
+		assert(fragilePool.GetSpawnedCount() == 0);
+		budget = 10;
+		fragilePool.SpawnN(fragileHandles.size(), fragileHandles.data(), budget);
+		assert(fragilePool.GetSpawnedCount() == 10);
+	}
+
+	{
+		// Parallel iteration visits every live object exactly once
+		Pool<int> pool(10000);
+		vector<PoolHandle<int>> handles;
+		for (int i = 0; i < 10000; ++i)
+		{
+			handles.push_back(pool.Spawn(i));
+		}
+		for (int i = 0; i < 10000; i += 3)
+		{
+			pool.Return(handles[i]);
+		}
+		PoolThreadPool threadPool(3);
+		assert(threadPool.GetThreadCount() == 4);
+		pool.ParallelForEach([](int &value) { value += 100000; }, 100, threadPool);
+		pool.ParallelForEach([](int &value) { value += 100000; }, 1);
+		// Any executor that runs every chunk will do
+		size_t chunkCount = 0;
+		pool.ParallelForEach([](int &value) { value += 100000; }, 1000, [&](size_t count, auto task)
+		{
+			chunkCount = count;
+			for (size_t chunk = 0; chunk < count; ++chunk)
+			{
+				task(chunk);
+			}
+		});
+		assert(chunkCount == (pool.GetCapacity() + 1023) / 1024);
+		for (int i = 0; i < 10000; ++i)
+		{
+			assert(i % 3 == 0 ? !pool.IsValid(handles[i]) : pool[handles[i]] == i + 300000);
+		}
+	}
+
+	{
+		// Dense pool keeps objects packed, handles survive moves
+		DensePool<string> pool(4);
+		vector<PoolHandle<string>> handles;
+		for (int i = 0; i < 100; ++i)
+		{
+			handles.push_back(pool.Spawn(to_string(i)));
+		}
+		// Handles past capacity of other pool are invalid
+		DensePool<string> empty(0);
+		assert(!empty.IsValid(PoolHandle<string>()) && !empty.IsValid(handles[99]));
+		empty.Return(PoolHandle<string>());
+		empty.Return(handles[99]);
+		assert(empty.GetSpawnedCount() == 0);
+		for (int i = 0; i < 100; ++i)
+		{
+			if (i % 4 != 0)
+			{
+				pool.Return(handles[i]);
+			}
+		}
+		assert(pool.GetSpawnedCount() == 25 && pool.end() - pool.begin() == 25);
+		for (int i = 0; i < 100; ++i)
+		{
+			assert(pool.IsValid(handles[i]) == (i % 4 == 0));
+			if (i % 4 == 0)
+			{
+				assert(pool[handles[i]] == to_string(i));
+				assert(pool.HandleByPointer(&pool[handles[i]]) == handles[i]);
+			}
+		}
+
+		pool.ShrinkToFit();
+		assert(pool.GetDenseCapacity() == 25);
+		pool.Compact();
+		for (size_t i = 1; i < pool.GetSpawnedCount(); ++i)
+		{
+			assert(pool.GetHandle(i - 1).GetIndex() < pool.GetHandle(i).GetIndex());
+		}
+		for (int i = 0; i < 100; i += 4)
+		{
+			assert(pool[handles[i]] == to_string(i));
+		}
+		// Dense array grows again, slot table does not
+		const auto capacity = pool.GetCapacity();
+		auto reused = pool.Spawn("reused");
+		assert(pool.GetCapacity() == capacity && pool[reused] == "reused");
+		assert(pool.GetObjects()[pool.GetSpawnedCount() - 1] == "reused");
+	}
+
+	{
+		// Batch resolution gives nulls for invalid handles in every storage
+		CheckResolve<Pool<int>>();
+		CheckResolve<Pool<int, SplitPoolTraits<>>>();
+		CheckResolve<Pool<int, SegmentedPoolTraits<64>>>();
+		CheckResolve<Pool<int, VirtualPoolTraits<4096>>>();
+		CheckResolve<Pool<int, NoPrefetchTraits>>();
+		CheckResolve<Pool<int, NearPrefetchTraits>>();
+	}
+
+	{
+		// Trivially relocatable objects are moved as raw bytes, custom allocators are kept
+		CheckRelocation<Pool<RelocatableBuffer>>();
+		CheckRelocation<Pool<OwnedBuffer>>();
+		CheckRelocation<Pool<RelocatableBuffer, SplitPoolTraits<>>>();
+		CheckRelocation<Pool<OwnedBuffer, SplitPoolTraits<>>>();
+		CheckRelocation<Pool<PinnedBuffer>>();
+		CheckRelocation<Pool<PinnedBuffer, SplitPoolTraits<>>>();
+		CheckThrowingRelocation<Pool<ThrowingCopy>>();
+		CheckThrowingRelocation<Pool<ThrowingCopy, SplitPoolTraits<>>>();
+		const auto allocationCount = AllocationCount;
+		{
+			Pool<RelocatableBuffer> pool(1, CountingAlloc, free);
+			for (int i = 0; i < 100; ++i)
+			{
+				pool.Spawn(i);
+			}
+		}
+		assert(AllocationCount > allocationCount);
+
+		DensePool<RelocatableBuffer> dense(1);
+		HierarchyPool<RelocatableBuffer> hierarchy(1);
+		MultiPool<RelocatableBuffer, OwnedBuffer> multi(1);
+		vector<DensePool<RelocatableBuffer>::Handle> denseHandles;
+		vector<HierarchyPool<RelocatableBuffer>::Handle> hierarchyHandles;
+		vector<MultiPool<RelocatableBuffer, OwnedBuffer>::Handle> multiHandles;
+		for (int i = 0; i < 1000; ++i)
+		{
+			denseHandles.push_back(dense.Spawn(i));
+			hierarchyHandles.push_back(hierarchy.Spawn(i));
+			multiHandles.push_back(multi.Spawn(RelocatableBuffer(i), OwnedBuffer(-i)));
+		}
+		for (int i = 0; i < 1000; ++i)
+		{
+			assert(*dense[denseHandles[i]].mData == i && *hierarchy[hierarchyHandles[i]].mData == i);
+			assert(*multi.Get<RelocatableBuffer>(multiHandles[i]).mData == i);
+			assert(*multi.Get<OwnedBuffer>(multiHandles[i]).mData == -i);
+		}
+		MultiPool<PinnedBuffer, int> pinned(1);
+		vector<MultiPool<PinnedBuffer, int>::Handle> pinnedHandles;
+		for (int i = 0; i < 1000; ++i)
+		{
+			pinnedHandles.push_back(pinned.Spawn(i, i));
+		}
+		for (int i = 0; i < 1000; ++i)
+		{
+			assert(*pinned.Get<PinnedBuffer>(pinnedHandles[i]).mData == pinned.Get<int>(pinnedHandles[i]));
+		}
+	}
+	{
+		// Standard containers take nodes and small arrays from pools of size classes
+		PoolMemoryArena<> arena;
+		{
+			PoolAllocator<int> allocator(arena);
+			list<int, PoolAllocator<int>> numbers(allocator);
+			map<int, string, less<int>, PoolAllocator<pair<const int, string>>> names(allocator);
+			unordered_map<int, int, hash<int>, equal_to<int>, PoolAllocator<pair<const int, int>>> 
+				squares(16, hash<int>(), equal_to<int>(), allocator);
+			vector<int, PoolAllocator<int>> values(allocator);
+			for (int i = 0; i < 1000; ++i)
+			{
+				numbers.push_back(i);
+				names.emplace(i, to_string(i));
+				squares.emplace(i, i * i);
+				values.push_back(i);
+			}
+			assert(arena.GetBlockCount() >= 3000 && arena.GetLargeCount() >= 2);
+			numbers.remove_if([](int i) { return i % 2 != 0; });
+			for (int i = 0; i < 1000; i += 2)
+			{
+				names.erase(i);
+			}
+			assert(numbers.size() == 500 && names.size() == 500 && names[501] == "501");
+			assert(squares[999] == 999 * 999 && values[999] == 999);
+			auto copy = names;
+			assert(copy.get_allocator() == names.get_allocator() && copy == names);
+		}
+		assert(arena.GetBlockCount() == 0 && arena.GetLargeCount() == 0);
+
+		// Over-aligned and large blocks come from the allocator
+		void *aligned = arena.Allocate(100, 64);
+		assert(reinterpret_cast<uintptr_t>(aligned) % 64 == 0 && arena.GetLargeCount() == 1);
+		memset(aligned, 1, 100);
+		arena.Deallocate(aligned, 100, 64);
+		void *small = arena.Allocate(9, 8);
+		assert(reinterpret_cast<uintptr_t>(small) % 8 == 0 && arena.GetBlockCount() == 1);
+		arena.Deallocate(small, 9, 8);
+		assert(arena.GetBlockCount() == 0 && arena.GetLargeCount() == 0);
+	}
+
+	{
+		// Allocators get size and alignment of every block back, over-aligned objects
+		// are aligned in every storage
+		CheckAllocator<Pool<AlignedVec, TrackedTraits<PoolTraits>>>();
+		CheckAllocator<Pool<AlignedVec, TrackedTraits<SegmentedPoolTraits<64>>>>();
+		CheckAllocator<Pool<AlignedVec, TrackedTraits<SplitPoolTraits<>>>>();
+		CheckAllocator<Pool<AlignedVec, TrackedTraits<LowestIndexTraits>>>();
+		CheckAllocator<DensePool<AlignedVec, TrackedTraits<PoolTraits>>>();
+		CheckAllocator<HierarchyPool<AlignedVec, TrackedTraits<PoolTraits>>>();
+		CheckColumnAllocators();
+		CheckAlignment<Pool<AlignedVec>>();
+		CheckAlignment<Pool<AlignedVec>>(CountingAlloc, free);
+		CheckAlignment<Pool<AlignedVec, HeapAllocatorTraits>>();
+		CheckAlignment<DensePool<AlignedVec>>();
+		CheckAlignment<HierarchyPool<AlignedVec>>();
+		ConcurrentPool<AlignedVec, 64> concurrent(1);
+		for (int i = 0; i < 100; ++i)
+		{
+			const auto handle = concurrent.Spawn(i);
+			assert(reinterpret_cast<uintptr_t>(&concurrent.At(handle)) % alignof(AlignedVec) == 0);
+		}
+
+		// Trim gives blocks back with their sizes
+		TrackingHeap heap;
+		{
+			Pool<int, TrackedTraits<PoolTraits>> pool(0, heap);
+			vector<Pool<int, TrackedTraits<PoolTraits>>::Handle> handles;
+			for (int i = 0; i < 1000; ++i)
+			{
+				handles.push_back(pool.Spawn(i));
+			}
+			for (int i = 10; i < 1000; ++i)
+			{
+				pool.Return(handles[i]);
+			}
+			assert(pool.Trim() > 0 && pool[handles[9]] == 9);
+			pool.Spawn(10);
+		}
+		assert(heap.mBlocks.empty());
+
+		// Pool memory may come from an arena: small blocks from its size classes
+		PoolMemoryArena<> arena;
+		{
+			Pool<int, ArenaAllocatorTraits> pool(4, arena);
+			auto handle = pool.Spawn(1);
+			assert(arena.GetBlockCount() > 0 && arena.GetLargeCount() == 0);
+			for (int i = 0; i < 1000; ++i)
+			{
+				pool.Spawn(i);
+			}
+			assert(pool[handle] == 1 && arena.GetLargeCount() > 0);
+		}
+		assert(arena.GetBlockCount() == 0 && arena.GetLargeCount() == 0);
+	}
+
+	{
+		// Hierarchy pool keeps parents before children through reparenting and returns
+		HierarchyPool<string> pool(2);
+		using Handle = HierarchyPool<string>::Handle;
+		const auto checkOrder = [&pool]
+		{
+			for (size_t i = 0; i < pool.GetSpawnedCount(); ++i)
+			{
+				const auto parent = pool.GetParents()[i];
+				assert(parent == HierarchyPool<string>::NoParent || parent < i);
+			}
+		};
+		auto root = pool.Spawn("root");
+		auto a = pool.SpawnChild(root, "a");
+		auto b = pool.SpawnChild(root, "b");
+		auto a1 = pool.SpawnChild(a, "a1");
+		auto other = pool.Spawn("other");
+		auto a2 = pool.SpawnChild(a, "a2");
+		auto a11 = pool.SpawnChild(a1, "a11");
+		auto b1 = pool.SpawnChild(b, "b1");
+		checkOrder();
+		assert(pool.GetParent(a11) == a1 && pool.GetParent(root) == Handle());
+
+		// Subtree of 'a' moves after its new parent that was spawned later
+		assert(pool.SetParent(a, b1));
+		checkOrder();
+		assert(pool.GetParent(a) == b1 && pool.GetParent(a1) == a && pool.GetParent(a11) == a1);
+		assert(pool[a] == "a" && pool[a2] == "a2" && pool[a11] == "a11" && pool[other] == "other");
+		assert(pool.GetObjects()[0] == "root" && pool.GetObjects()[1] == "b");
+		// Cycles are refused
+		assert(!pool.SetParent(b, a11) && !pool.SetParent(a, a) && pool.GetParent(b) == root);
+		assert(pool.SetParent(other, a2) && pool.SetParent(b1, Handle()));
+		checkOrder();
+
+		// Sweep sees every parent before its children
+		vector<string> paths;
+		pool.ForEachWithParent([&](string &name, string *parent)
+		{
+			if (parent)
+			{
+				name = *parent + "/" + name;
+			}
+			paths.push_back(name);
+		});
+		assert(pool[other] == "b1/a/a2/other" && pool[a11] == "b1/a/a1/a11");
+		assert(paths.size() == 8);
+
+		// Return destroys whole subtree, the rest stays packed
+		pool.Return(a);
+		checkOrder();
+		assert(pool.GetSpawnedCount() == 3);
+		for (const auto &handle : { a, a1, a2, a11, other })
+		{
+			assert(!pool.IsValid(handle));
+		}
+		assert(pool[root] == "root" && pool[b] == "root/b" && pool[b1] == "b1");
+		assert(pool.GetParent(b) == root && pool.GetParent(b1) == Handle());
+		auto reused = pool.SpawnChild(b, "reused");
+		assert(pool.GetParent(reused) == b && pool.GetSpawnedCount() == 4);
+
+		// Handles past capacity and stale handles are invalid, invalid parent makes a root
+		HierarchyPool<string> small(1);
+		assert(!small.IsValid(reused) && !small.IsValid(Handle()));
+		small.Return(reused);
+		assert(!small.SetParent(reused, Handle()) && small.GetSpawnedCount() == 0);
+		const auto orphan = small.SpawnChild(reused, "orphan");
+		assert(small.GetParent(orphan) == Handle() && small.SpawnChild(a, "stale") != orphan);
+		assert(small.GetSpawnedCount() == 2 && !pool.SetParent(a, root));
+
+		// Random reparenting keeps topological order
+		vector<Handle> nodes { root, b, b1, reused };
+		uint64_t state = 7;
+		auto random = [&state](size_t range)
+		{
+			state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+			return static_cast<size_t>(state >> 33) % range;
+		};
+		for (int i = 0; i < 300; ++i)
+		{
+			nodes.push_back(pool.SpawnChild(nodes[random(nodes.size())], to_string(i)));
+		}
+		for (int i = 0; i < 1000; ++i)
+		{
+			pool.SetParent(nodes[random(nodes.size())], nodes[random(nodes.size())]);
+		}
+		checkOrder();
+		for (int i = 0; i < 300; ++i)
+		{
+			assert(pool[nodes[i + 4]] == to_string(i));
+		}
+	}
+
+	{
+		// SoA pool keeps every field in its own aligned column
+		SoaPool<Vec3, float, int> pool(1);
+		vector<SoaPool<Vec3, float, int>::Handle> handles;
+		for (int i = 0; i < 100; ++i)
+		{
+			handles.push_back(pool.Spawn(Vec3(float(i), 0, 0), float(i) * 2, i));
+		}
+		// Handles past capacity of other pool are invalid
+		SoaPool<Vec3, float, int> empty(0);
+		assert(!empty.IsValid(SoaPool<Vec3, float, int>::Handle()) && !empty.IsValid(handles[99]));
+		empty.Return(handles[99]);
+		assert(empty.GetSpawnedCount() == 0);
+		assert(reinterpret_cast<uintptr_t>(pool.GetColumn<0>().GetData()) % 64 == 0);
+		assert(reinterpret_cast<uintptr_t>(pool.GetColumn<2>().GetData()) % 64 == 0);
+		assert(pool.GetColumn<1>().GetSize() == 100);
+		for (int i = 0; i < 100; i += 2)
+		{
+			pool.Return(handles[i]);
+			assert(!pool.IsValid(handles[i]));
+		}
+		for (int i = 1; i < 100; i += 2)
+		{
+			assert(pool.IsValid(handles[i]));
+			assert(pool.Get<0>(handles[i]).x == float(i) && pool.Get<2>(handles[i]) == i);
+			assert(pool.GetColumn<1>()[handles[i].GetIndex()] == float(i) * 2);
+		}
+		// Freed records are reused without growth
+		const auto capacity = pool.GetCapacity();
+		auto reused = pool.Spawn();
+		assert(pool.GetCapacity() == capacity && pool.Get<2>(reused) == 0);
+
+		int liveCount = 0;
+		pool.ForEach([&](Vec3 &, float &, int &) { ++liveCount; });
+		assert(liveCount == 51 && pool.GetSpawnedCount() == 51);
+	}
+
+	{
+		// Multi pool keeps components of any type under one handle
+		struct Fragile
+		{
+			Fragile() { }
+			Fragile(bool fail)
+			{
+				if (fail)
+				{
+					throw runtime_error("fragile");
+				}
+			}
+		};
+		auto body = make_shared<int>(7);
+		MultiPool<Vec3, string, shared_ptr<int>, Fragile> pool(1);
+		vector<decltype(pool)::Handle> handles;
+		for (int i = 0; i < 100; ++i)
+		{
+			handles.push_back(pool.Spawn(Vec3(float(i), 0, 0), to_string(i), body, false));
+		}
+		assert(body.use_count() == 101 && pool.GetCapacity() >= 100);
+		// Handles past capacity of other pool are invalid
+		decltype(pool) empty(0);
+		assert(!empty.IsValid(decltype(pool)::Handle()) && !empty.IsValid(handles[99]));
+		empty.Return(handles[99]);
+		assert(empty.GetSpawnedCount() == 0 && body.use_count() == 101);
+		for (int i = 0; i < 100; i += 2)
+		{
+			pool.Return(handles[i]);
+			assert(!pool.IsValid(handles[i]));
+		}
+		assert(body.use_count() == 51);
+		for (int i = 1; i < 100; i += 2)
+		{
+			assert(pool.IsValid(handles[i]));
+			assert(pool.Get<Vec3>(handles[i]).x == float(i) && pool.Get<string>(handles[i]) == to_string(i));
+		}
+		// Throwing component leaves no record and no leaked component behind
+		bool thrown = false;
+		try
+		{
+			pool.Spawn(Vec3(), string("x"), body, true);
+		}
+		catch (const runtime_error &)
+		{
+			thrown = true;
+		}
+		assert(thrown && body.use_count() == 51 && pool.GetSpawnedCount() == 50);
+		// Growth moves components
+		for (int i = 0; i < 200; ++i)
+		{
+			pool.Spawn(Vec3(), string(100, 'a'), body, false);
+		}
+		assert(pool.Get<string>(handles[99]) == "99" && body.use_count() == 251);
+
+		size_t count = 0;
+		pool.ForEach<string>([&](string &name) { count += name.size() == 100; });
+		assert(count == 200);
+		count = 0;
+		pool.ForEach<shared_ptr<int>, Vec3>([&](shared_ptr<int> &ptr, Vec3 &) { count += *ptr == 7; });
+		assert(count == 250);
+		count = 0;
+		pool.ForEach([&](Vec3 &, string &, shared_ptr<int> &, Fragile &) { ++count; });
+		assert(count == 250);
+		pool.Clear();
+		assert(body.use_count() == 1);
+	}
+
+	{
+		// Concurrent pool must hand out every record to exactly one thread
+		ConcurrentPool<int, 64> pool(16, 4096);
+		vector<thread> threads;
+		vector<vector<PoolHandle<int>>> handles(4);
+		for (int t = 0; t < 4; ++t)
+		{
+			threads.emplace_back([&pool, &handles, t]
+			{
+				for (int round = 0; round < 100; ++round)
+				{
+					for (int i = 0; i < 200; ++i)
+					{
+						handles[t].push_back(pool.Spawn(t));
+					}
+					for (const auto &handle : handles[t])
+					{
+						assert(pool.IsValid(handle) && pool[handle] == t);
+						pool.Return(handle);
+						assert(!pool.IsValid(handle));
+					}
+					handles[t].clear();
+				}
+				for (int i = 0; i < 200; ++i)
+				{
+					handles[t].push_back(pool.Spawn(t));
+				}
+			});
+		}
+		for (auto &thread : threads)
+		{
+			thread.join();
+		}
+		vector<int *> objects;
+		for (int t = 0; t < 4; ++t)
+		{
+			for (const auto &handle : handles[t])
+			{
+				assert(pool.IsValid(handle) && pool[handle] == t);
+				objects.push_back(&pool[handle]);
+			}
+		}
+		sort(objects.begin(), objects.end());
+		assert(unique(objects.begin(), objects.end()) == objects.end());
+		assert(pool.GetCapacity() <= 1024);
+	}
+
+	{
+		// Per-thread caches must move free records in batches
+		ConcurrentPool<int, 64> pool(0, 4096);
+		vector<thread> threads;
+		for (int t = 0; t < 4; ++t)
+		{
+			threads.emplace_back([&pool, t]
+			{
+				ConcurrentPoolCache<int, 64> cache(pool, 16);
+				vector<PoolHandle<int>> handles;
+				for (int round = 0; round < 100; ++round)
+				{
+					for (int i = 0; i < 100; ++i)
+					{
+						handles.push_back(cache.Spawn(t));
+					}
+					for (const auto &handle : handles)
+					{
+						assert(pool.IsValid(handle) && pool[handle] == t);
+						cache.Return(handle);
+						assert(!pool.IsValid(handle));
+					}
+					handles.clear();
+					assert(cache.GetCachedCount() <= 32);
+				}
+				const auto &stats = cache.GetStats();
+				assert(stats.mSpawnCount == 10000 && stats.mReturnCount == 10000);
+				assert(stats.mRefillCount > 0 && stats.mRefillCount < stats.mSpawnCount / 4);
+				assert(stats.mFlushCount > 0 && stats.mFlushCount < stats.mReturnCount / 4);
+			});
+		}
+		for (auto &thread : threads)
+		{
+			thread.join();
+		}
+		// Every thread had at most 132 records at once
+		assert(pool.GetCapacity() <= 640);
+		// Flushed records are reusable through the pool itself
+		vector<PoolHandle<int>> handles;
+		for (int i = 0; i < 400; ++i)
+		{
+			handles.push_back(pool.Spawn(i));
+		}
+		assert(pool.GetCapacity() <= 640);
+	}
+
+	{
+		// Failed chunk allocation and exhausted capacity do not lose free records
+		ConcurrentPool<int, 64> pool(0, 256, FailingAlloc, free);
+		vector<PoolHandle<int>> handles;
+		for (int i = 0; i < 10; ++i)
+		{
+			handles.push_back(pool.Spawn(i));
+		}
+		for (const auto &handle : handles)
+		{
+			pool.Return(handle);
+		}
+		handles.clear();
+		FailAllocations = true;
+		{
+			ConcurrentPoolCache<int, 64> cache(pool, 100);
+			bool thrown = false;
+			try
+			{
+				cache.Spawn(0);
+			}
+			catch (const std::bad_alloc &)
+			{
+				thrown = true;
+			}
+			assert(thrown && cache.GetCachedCount() == 0 && cache.GetStats().mRefillCount == 0);
+		}
+		FailAllocations = false;
+		{
+			ConcurrentPoolCache<int, 64> cache(pool, 100);
+			for (int i = 0; i < 256; ++i)
+			{
+				handles.push_back(cache.Spawn(i));
+			}
+			bool thrown = false;
+			try
+			{
+				cache.Spawn(0);
+			}
+			catch (const std::bad_alloc &)
+			{
+				thrown = true;
+			}
+			assert(thrown);
+			for (const auto &handle : handles)
+			{
+				cache.Return(handle);
+			}
+		}
+		handles.clear();
+		for (int i = 0; i < 256; ++i)
+		{
+			handles.push_back(pool.Spawn(i));
+		}
+	}
+
+	{
+		// Default, stale and foreign handles are ignored by Return of pool and cache
+		using Handle = ConcurrentPool<int, 64>::Handle;
+		ConcurrentPool<int, 64> empty(0);
+		empty.Return(Handle());
+		ConcurrentPool<int, 64> pool(0, 1024);
+		ConcurrentPool<int, 64> big(0, 1 << 16);
+		vector<Handle> foreign;
+		for (int i = 0; i < 2000; ++i)
+		{
+			foreign.push_back(big.Spawn(i));
+		}
+		const auto live = pool.Spawn(1);
+		const auto stale = pool.Spawn(2);
+		pool.Return(stale);
+		// Index in missing chunk and index past the table
+		const Handle invalid[] = { Handle(), stale, foreign[199], foreign[1999] };
+		for (const auto &handle : invalid)
+		{
+			assert(!pool.IsValid(handle));
+			pool.Return(handle);
+		}
+		{
+			ConcurrentPoolCache<int, 64> cache(pool, 16);
+			for (const auto &handle : invalid)
+			{
+				cache.Return(handle);
+			}
+			assert(cache.GetCachedCount() == 0);
+		}
+		assert(pool.IsValid(live) && pool.At(live) == 1 && pool.Spawn(3).GetIndex() == stale.GetIndex());
+	}
+
+	{
+		// Growth policies
+		assert(GeometricPoolGrowth<>::GetNextCapacity(0) == 1);
+		assert(GeometricPoolGrowth<>::GetNextCapacity(1) == 2);
+		assert(GeometricPoolGrowth<>::GetNextCapacity(100) == 162);
+		assert((GeometricPoolGrowth<3, 2>::GetNextCapacity(10) == 15));
+		assert(FixedPoolGrowth<10>::GetNextCapacity(5) == 15);
+		assert(PowerOfTwoPoolGrowth::GetNextCapacity(0) == 1);
+		assert(PowerOfTwoPoolGrowth::GetNextCapacity(5) == 8);
+		assert(PowerOfTwoPoolGrowth::GetNextCapacity(8) == 16);
+		assert((CappedPoolGrowth<100, PowerOfTwoPoolGrowth>::GetNextCapacity(64) == 100));
+
+		Pool<int, FixedGrowthTraits> fixed(0);
+		for (int i = 0; i < 25; ++i)
+		{
+			fixed.Spawn(i);
+		}
+		assert(fixed.GetCapacity() == 30);
+
+		// Capped pool fails instead of growing
+		Pool<int, CappedTraits> capped(1);
+		vector<Pool<int, CappedTraits>::Handle> handles;
+		for (int i = 0; i < 100; ++i)
+		{
+			handles.push_back(capped.Spawn(i));
+		}
+		assert(capped.GetCapacity() == 100);
+		bool thrown = false;
+		try
+		{
+			capped.Spawn(100);
+		}
+		catch (const std::bad_alloc &)
+		{
+			thrown = true;
+		}
+		assert(thrown && capped.GetSpawnedCount() == 100);
+		capped.Return(handles[50]);
+		assert(capped.IsValid(capped.Spawn(100)));
+	}
+
+	{
+		// Trim releases free tail of every storage
+		CheckTrim<Pool<int>>(1000, 100);
+		CheckTrim<Pool<int, SplitPoolTraits<>>>(1000, 100);
+		CheckTrim<Pool<int, SegmentedPoolTraits<64>>>(1000, 100);
+		CheckTrim<Pool<int, VirtualPoolTraits<1 << 20>>>(100000, 100);
+		CheckTrim<Pool<int, LifoTraits>>(1000, 100);
+		CheckTrim<Pool<int, LowestIndexTraits>>(1000, 100);
+
+		Pool<int> pool(16);
+		assert(pool.Trim() == 16 && pool.GetCapacity() == 0);
+		pool.Spawn(1);
+		assert(pool.GetCapacity() == 1);
+	}
+
+	{
+		// Batch growth keeps records of free list
+		Pool<int> pool(8);
+		vector<Pool<int>::Handle> handles(8);
+		pool.SpawnN(8, handles.data(), 1);
+		pool.ReturnN(handles.data(), 4);
+		vector<Pool<int>::Handle> spawned(20);
+		pool.SpawnN(20, spawned.data(), 2);
+		for (int i = 0; i < 20; ++i)
+		{
+			spawned.push_back(pool.Spawn(3));
+		}
+		vector<int *> objects;
+		for (const auto &handle : spawned)
+		{
+			assert(pool.IsValid(handle));
+			objects.push_back(&pool[handle]);
+		}
+		sort(objects.begin(), objects.end());
+		assert(unique(objects.begin(), objects.end()) == objects.end());
+		assert(pool.GetSpawnedCount() == 44);
+	}
+
+	{
+		// Reuse policies
+		Pool<int> fifo(8);
+		Pool<int, LifoTraits> lifo(8);
+		Pool<int, LowestIndexTraits> lowest(8);
+		vector<Pool<int>::Handle> handles(8);
+		fifo.SpawnN(8, handles.data(), 0);
+		lifo.SpawnN(8, handles.data(), 0);
+		lowest.SpawnN(8, handles.data(), 0);
+		for (PoolIndex index : { 5, 2, 7 })
+		{
+			fifo.Return(handles[index]);
+			lifo.Return(handles[index]);
+			lowest.Return(handles[index]);
+		}
+		for (PoolIndex index : { 5, 2, 7 })
+		{
+			assert(fifo.Spawn(1).GetIndex() == index);
+		}
+		for (PoolIndex index : { 7, 2, 5 })
+		{
+			assert(lifo.Spawn(1).GetIndex() == index);
+		}
+		for (PoolIndex index : { 2, 5, 7, 8 })
+		{
+			assert(lowest.Spawn(1).GetIndex() == index);
+		}
+
+		// Lowest index first keeps live set at the front after churn
+		Pool<int, LowestIndexTraits> pool(0);
+		vector<Pool<int>::Handle> live(1000);
+		pool.SpawnN(1000, live.data(), 0);
+		pool.ReturnN(live.data(), 1000);
+		for (int i = 999; i >= 0; i -= 2)
+		{
+			live[i] = pool.Spawn(i);
+		}
+		int maxIndex = 0;
+		for (auto it = pool.begin(); it != pool.end(); ++it)
+		{
+			maxIndex = max(maxIndex, static_cast<int>(it.GetHandle().GetIndex()));
+		}
+		assert(maxIndex == 499 && pool.GetSpawnedCount() == 500);
+		vector<Pool<int>::Handle> batch(600);
+		pool.SpawnN(600, batch.data(), 0);
+		assert(batch[0].GetIndex() == 500 && batch[599].GetIndex() == 1099);
+
+		// Free records of lowest index pool are restored from snapshot
+		const char *path = "pool_reuse_snapshot_test.bin";
+		pool.Return(live[999]);
+		pool.Return(batch[10]);
+		assert(pool.SaveSnapshot(path));
+		Pool<int, LowestIndexTraits> restored(1);
+		assert(restored.MapSnapshot(path));
+		assert(restored.Spawn(1).GetIndex() == live[999].GetIndex());
+		assert(restored.Spawn(1).GetIndex() == 510);
+		Pool<int> other(1);
+		assert(!other.MapSnapshot(path));
+		remove(path);
+	}
+
+	{
+		// Deferred return keeps objects alive until readers leave their read sections
+		Pool<shared_ptr<int>, DeferredTraits> pool(1);
+		auto &epochs = pool.GetEpochs();
+		const auto reader = epochs.RegisterReader();
+		auto value = make_shared<int>(42);
+		auto handle = pool.Spawn(value);
+		{
+			PoolReadGuard guard(epochs, reader);
+			pool.Return(handle);
+			assert(!pool.IsValid(handle) && pool.GetPendingCount() == 1);
+			assert(pool.Reclaim() == 0 && pool.Reclaim() == 0);
+			assert(value.use_count() == 2 && pool[handle] == value);
+		}
+		assert(pool.Reclaim() == 1 && value.use_count() == 1 && pool.GetPendingCount() == 0);
+		handle = pool.Spawn(value);
+		assert(pool.IsValid(handle) && value.use_count() == 2);
+
+		// Idle readers do not hold reclamation, full pool reclaims before growth
+		while (pool.GetSpawnedCount() < 10 || pool.GetSpawnedCount() < pool.GetCapacity())
+		{
+			pool.Spawn(value);
+		}
+		const auto capacity = pool.GetCapacity();
+		pool.Return(handle);
+		handle = pool.Spawn(value);
+		assert(pool.GetCapacity() == capacity && pool.GetPendingCount() == 0);
+		epochs.UnregisterReader(reader);
+
+		// Batch return defers too, pending records survive Trim and are dropped by Clear
+		vector<Pool<shared_ptr<int>, DeferredTraits>::Handle> handles(100);
+		pool.SpawnN(100, handles.data(), value);
+		const auto guarded = epochs.RegisterReader();
+		{
+			PoolReadGuard guard(epochs, guarded);
+			pool.ReturnN(handles.data(), 100);
+			assert(pool.GetPendingCount() > 0 && pool.GetSpawnedCount() == capacity);
+			pool.Trim();
+			assert(pool.GetCapacity() >= handles[99].GetIndex() + 1);
+		}
+		assert(value.use_count() == static_cast<long>(1 + capacity + pool.GetPendingCount()));
+		pool.Clear();
+		assert(value.use_count() == 1 && pool.GetPendingCount() == 0);
+		epochs.UnregisterReader(guarded);
+	}
+
+	{
+		// Reader thread never sees destructed object while writer churns and grows pool
+		Pool<string, DeferredTraits> pool(1);
+		auto current = pool.Spawn("object 0");
+		atomic<Pool<string, DeferredTraits>::Handle> published { current };
+		atomic<bool> done { false };
+		bool intact = true;
+		thread readerThread([&]
+		{
+			auto &epochs = pool.GetEpochs();
+			const auto reader = epochs.RegisterReader();
+			while (!done)
+			{
+				PoolReadGuard guard(epochs, reader);
+				const auto &object = pool[published.load()];
+				intact &= object.compare(0, 7, "object ") == 0;
+			}
+			epochs.UnregisterReader(reader);
+		});
+		for (int i = 1; i < 20000; ++i)
+		{
+			auto next = pool.Spawn("object " + to_string(i));
+			published = next;
+			pool.Return(current);
+			current = next;
+		}
+		done = true;
+		readerThread.join();
+		assert(intact && pool.GetSpawnedCount() == 1);
+	}
+
+	cout << "Passed" << endl;
+}
+
+void RunRandomObjectPerformanceTest()
+{
+	cout << endl << endl;
+	cout << "Running random object performance test" << endl;
+	cout << "Object count: " << ObjectCountPerTest << endl;
+
+	// PoolableNode
+	{
+		Pool<PoolableNode> pool(1024);
+
+		PerfCounters counters(CollectPerfCounters);
+		auto lastTime = chrono::high_resolution_clock::now();
+		counters.Start();
+		for (int i = 0; i < ObjectCountPerTest; ++i)
+		{
+			auto parent = pool.Spawn();
+			pool[parent].SetName("Parent");
+			auto child = pool.Spawn();
+			pool[child].SetName("Child");
+			pool[child].AttachTo(parent);
+			pool.Return(parent);
+		}
+		counters.Stop();
+
+		cout << "Pool<Node>: "
+			<< chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+			.count()
+			<< " microseconds" << endl;
+		counters.Print(cout, "Pool<Node>");
+		// cout << "Pool size: " << pool.GetSize() << endl;
+	}
+
+#if !ONLY_POOL_TESTS
+	// OrdinaryNode
+	{
+		PerfCounters counters(CollectPerfCounters);
+		auto lastTime = chrono::high_resolution_clock::now();
+		counters.Start();
+
+		for (int i = 0; i < ObjectCountPerTest; ++i)
+		{
+			auto parent = make_shared<OrdinaryNode>();
+			parent->SetName("Parent");
+			auto child = make_shared<OrdinaryNode>();
+			child->SetName("Child");
+			child->AttachTo(parent);
+			parent.reset();
+		}
+		counters.Stop();
+
+		cout << "shared_ptr<Node>: "
+			<< chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+			.count()
+			<< " microseconds" << endl;
+		counters.Print(cout, "shared_ptr<Node>");
+	}
+#endif
+	cout << "Passed" << endl;
+}
+
+void RunHugeAmountOfObjectsPerformanceTest()
+{
+	class Foo
+	{
+	private:
+		int mBar;
+		string mBaz;
+
+	public:
+		Foo()
+		{
+		}
+		Foo(int bar) : mBar(bar)
+		{
+		}
+	};
+
+
+
+	cout << endl << endl;
+	cout << "Running huge amount of objects performance test" << endl;
+	cout << "Object count: " << ObjectCountPerTest << endl;
+
+	{
+		PerfCounters counters(CollectPerfCounters);
+		auto lastTime = chrono::high_resolution_clock::now();
+		counters.Start();
+
+		vector<PoolHandle<Foo>> handles;
+		handles.reserve(ObjectCountPerTest);
+		Pool<Foo> pool(ObjectCountPerTest);
+
+		for (int i = 0; i < ObjectCountPerTest; ++i)
+		{
+			handles.push_back(pool.Spawn(1234));
+		}
+
+		for (const auto &handle : handles)
+		{
+			pool.Return(handle);
+		}
+		counters.Stop();
+
+		cout << "Pool<Foo>: "
+			<< chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+			.count()
+			<< " microseconds" << endl;
+		counters.Print(cout, "Pool<Foo>");
+	}
+
+#if !ONLY_POOL_TESTS
+	{
+		PerfCounters counters(CollectPerfCounters);
+		auto lastTime = chrono::high_resolution_clock::now();
+		counters.Start();
+
+		vector<unique_ptr<Foo>> pointers;
+		pointers.reserve(ObjectCountPerTest);
+		for (int i = 0; i < ObjectCountPerTest; ++i)
+		{
+			pointers.push_back(make_unique<Foo>(1234));
+		}
+
+		for (auto &ptr : pointers)
+		{
+			ptr.reset();
+		}
+		counters.Stop();
+
+		cout << "unique_ptr<Foo>: "
+			<< chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+			.count()
+			<< " microseconds" << endl;
+		counters.Print(cout, "unique_ptr<Foo>");
+	}
+#endif
+	cout << "Passed" << endl;
+}
+
+void RunDataLocalityPerformanceTest()
+{
+	class Foo
+	{
+	private:
+		Matrix mA;
+		Matrix mB;
+		Matrix mResult;
+	public:
+		Foo()
+		{
+			mA.FromRotationScaleTranslation({ 0, 0, 0, 1 }, { 1, 1, 1 }, { 1, 0, 0 });
+			mB.FromRotationScaleTranslation({ 1, 0, 0, 1 }, { 1, 1, 1 }, { 1, 1, 0 });
+		}
+
+		void Calculate()
+		{
+			mResult = mA * mB;
+		}
+
+		void Translate(float x)
+		{
+			mA.mElements[12] += x;
+		}
+
+		const Matrix &GetA() const
+		{
+			return mA;
+		}
+
+		const Matrix &GetB() const
+		{
+			return mB;
+		}
+	};
+
+	// Performance test
+	constexpr int iterCount = 20;
+
+	cout << endl << endl;
+	cout << "Running data locality performance test" << endl;
+	cout << "Object count: " << ObjectCountPerTest << endl;
+
+	long long totalTime = 0;
+
+#if !ONLY_POOL_TESTS
+	{
+		vector<unique_ptr<Foo>> pointers;
+		pointers.reserve(ObjectCountPerTest);
+		for (int i = 0; i < ObjectCountPerTest; ++i)
+		{
+			pointers.push_back(make_unique<Foo>());
+		}
+
+		PerfCounters counters(CollectPerfCounters);
+		for (int k = 0; k < iterCount; ++k)
+		{
+			auto lastTime = chrono::high_resolution_clock::now();
+			counters.Start();
+			for (const auto &ptr : pointers)
+			{
+				ptr->Calculate();
+			}
+			counters.Stop();
+
+			totalTime += chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+				.count();
+		}
+
+		for (auto &ptr : pointers)
+		{
+			ptr.reset();
+		}
+
+		cout << "unique_ptr<Foo>: " << totalTime / iterCount << " microseconds" << endl;
+		counters.Print(cout, "unique_ptr<Foo>");
+	}
+#endif
+
+
+
+	{
+		vector<PoolHandle<Foo>> handles;
+		handles.reserve(ObjectCountPerTest);
+		Pool<Foo> pool(ObjectCountPerTest);
+
+		for (int i = 0; i < ObjectCountPerTest; ++i)
+		{
+			handles.push_back(pool.Spawn());
+		}
+
+		totalTime = 0;
+		PerfCounters counters(CollectPerfCounters);
+		for (int k = 0; k < iterCount; ++k)
+		{
+			auto lastTime = chrono::high_resolution_clock::now();
+			counters.Start();
+			for (const auto &handle : handles)
+			{
+				pool.At(handle).Calculate();
+			}
+			counters.Stop();
+
+			totalTime += chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+				.count();
+		}
+
+		for (const auto &handle : handles)
+		{
+			pool.Return(handle);
+		}
+
+		cout << "Pool<Foo>: " << totalTime / iterCount << " microseconds" << endl;
+		counters.Print(cout, "Pool<Foo>");
+	}
+
+	{
+		// Same data with every matrix in its own column
+		SoaPool<Matrix, Matrix, Matrix> pool(ObjectCountPerTest);
+		const Foo prototype;
+		for (int i = 0; i < ObjectCountPerTest; ++i)
+		{
+			pool.Spawn(prototype.GetA(), prototype.GetB(), Matrix());
+		}
+
+		totalTime = 0;
+		PerfCounters counters(CollectPerfCounters);
+		for (int k = 0; k < iterCount; ++k)
+		{
+			auto lastTime = chrono::high_resolution_clock::now();
+			counters.Start();
+			const auto a = pool.GetColumn<0>();
+			const auto b = pool.GetColumn<1>();
+			const auto result = pool.GetColumn<2>();
+			for (size_t i = 0; i < result.GetSize(); ++i)
+			{
+				result[i] = a[i] * b[i];
+			}
+			counters.Stop();
+
+			totalTime += chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+				.count();
+		}
+		cout << "SoaPool<Matrix, Matrix, Matrix>: " << totalTime / iterCount << " microseconds" << endl;
+		counters.Print(cout, "SoaPool<Matrix, Matrix, Matrix>");
+
+		// System that reads one field: AoS strides over whole objects, SoA reads one column
+		long long soaTime = 0;
+		for (int k = 0; k < iterCount; ++k)
+		{
+			auto lastTime = chrono::high_resolution_clock::now();
+			for (auto &matrix : pool.GetColumn<0>())
+			{
+				matrix.mElements[12] += 1.0f;
+			}
+			soaTime += chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+				.count();
+		}
+
+		Pool<Foo> aosPool(ObjectCountPerTest);
+		for (int i = 0; i < ObjectCountPerTest; ++i)
+		{
+			aosPool.Spawn();
+		}
+		long long aosTime = 0;
+		for (int k = 0; k < iterCount; ++k)
+		{
+			auto lastTime = chrono::high_resolution_clock::now();
+			aosPool.ForEach([](Foo &foo) { foo.Translate(1.0f); });
+			aosTime += chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+				.count();
+		}
+		cout << "Single field update: Pool<Foo>: " << aosTime / iterCount 
+			<< " microseconds, SoaPool column: " << soaTime / iterCount << " microseconds" << endl;
+	}
+
+	cout << "Passed" << endl;
+}
+
+void RunChurnPerformanceTest()
+{
+	struct Particle
+	{
+		float mPosition[3];
+		float mLifeTime;
+
+		Particle(float lifeTime) : mPosition { 0, 0, 0 }, mLifeTime(lifeTime)
+		{
+		}
+	};
+
+	constexpr int liveCount = 65536;
+
+	cout << endl << endl;
+	cout << "Running spawn/return churn performance test" << endl;
+	cout << "Live objects: " << liveCount << ", spawn/return pairs: " << ObjectCountPerTest << endl;
+
+	{
+		Pool<Particle> pool(liveCount);
+		vector<PoolHandle<Particle>> handles;
+		handles.reserve(liveCount);
+		for (int i = 0; i < liveCount; ++i)
+		{
+			handles.push_back(pool.Spawn(1.0f));
+		}
+
+		auto lastTime = chrono::high_resolution_clock::now();
+		for (int i = 0; i < ObjectCountPerTest; ++i)
+		{
+			// Scatter returns over the whole live set
+			auto &handle = handles[(static_cast<size_t>(i) * 7919) % liveCount];
+			pool.Return(handle);
+			handle = pool.Spawn(static_cast<float>(i));
+		}
+
+		cout << "Pool<Particle>: "
+			<< chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+			.count()
+			<< " microseconds" << endl;
+	}
+
+	{
+		// Same churn with stats, pool starts small to show growth counters
+		Pool<Particle, StatsTraits> pool(1);
+		vector<PoolHandle<Particle>> handles;
+		handles.reserve(liveCount);
+		for (int i = 0; i < liveCount; ++i)
+		{
+			handles.push_back(pool.Spawn(1.0f));
+		}
+
+		auto lastTime = chrono::high_resolution_clock::now();
+		for (int i = 0; i < ObjectCountPerTest; ++i)
+		{
+			auto &handle = handles[(static_cast<size_t>(i) * 7919) % liveCount];
+			if (pool.IsValid(handle))
+			{
+				pool.Return(handle);
+			}
+			handle = pool.Spawn(static_cast<float>(i));
+		}
+
+		cout << "Pool<Particle> with stats: "
+			<< chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+			.count()
+			<< " microseconds" << endl;
+		pool.GetStats().Dump(stdout);
+	}
+
+	cout << "Passed" << endl;
+}
+
+void RunConcurrentPerformanceTest()
+{
+	struct Particle
+	{
+		float mPosition[3];
+		float mLifeTime;
+
+		Particle(float lifeTime) : mPosition { 0, 0, 0 }, mLifeTime(lifeTime)
+		{
+		}
+	};
+
+	constexpr int batchSize = 256;
+	const int maxThreads = max(1u, thread::hardware_concurrency());
+
+	cout << endl << endl;
+	cout << "Running concurrent spawn/return performance test" << endl;
+	cout << "Spawn/return pairs per thread: " << ObjectCountPerTest << endl;
+
+	// Spawns a batch of objects and returns them back, again and again
+	auto churn = [](auto spawn, auto ret)
+	{
+		PoolHandle<Particle> handles[batchSize];
+		for (int i = 0; i < ObjectCountPerTest; i += batchSize)
+		{
+			for (auto &handle : handles)
+			{
+				handle = spawn(static_cast<float>(i));
+			}
+			for (const auto &handle : handles)
+			{
+				ret(handle);
+			}
+		}
+	};
+
+	// Runs 'worker' on every thread, returns million of spawn/return pairs per second
+	auto run = [](int threadCount, auto worker)
+	{
+		vector<thread> threads;
+		auto lastTime = chrono::high_resolution_clock::now();
+		for (int t = 0; t < threadCount; ++t)
+		{
+			threads.emplace_back(worker);
+		}
+		for (auto &thread : threads)
+		{
+			thread.join();
+		}
+		const auto time = chrono::duration_cast<chrono::microseconds>(
+			chrono::high_resolution_clock::now() - lastTime).count();
+		return static_cast<double>(ObjectCountPerTest) * threadCount / max<long long>(1, time);
+	};
+
+	for (int threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+	{
+		ConcurrentPool<Particle> pool(batchSize * threadCount);
+		const auto concurrentRate = run(threadCount, [&]
+		{
+			churn([&](float lifeTime) { return pool.Spawn(lifeTime); },
+				[&](const PoolHandle<Particle> &handle) { pool.Return(handle); });
+		});
+
+		ConcurrentPool<Particle> cachedPool(batchSize * threadCount * 2);
+		PoolCacheStats cacheStats;
+		mutex statsLock;
+		const auto cachedRate = run(threadCount, [&]
+		{
+			ConcurrentPoolCache<Particle> cache(cachedPool, 64);
+			churn([&](float lifeTime) { return cache.Spawn(lifeTime); },
+				[&](const PoolHandle<Particle> &handle) { cache.Return(handle); });
+			lock_guard<mutex> guard(statsLock);
+			cacheStats.mRefillCount += cache.GetStats().mRefillCount;
+			cacheStats.mFlushCount += cache.GetStats().mFlushCount;
+		});
+
+		Pool<Particle> lockedPool(batchSize * threadCount);
+		mutex lock;
+		const auto lockedRate = run(threadCount, [&]
+		{
+			churn([&](float lifeTime)
+				{
+					lock_guard<mutex> guard(lock);
+					return lockedPool.Spawn(lifeTime);
+				},
+				[&](const PoolHandle<Particle> &handle)
+				{
+					lock_guard<mutex> guard(lock);
+					lockedPool.Return(handle);
+				});
+		});
+
+		cout << threadCount << " thread(s): ConcurrentPool<Particle>: " << concurrentRate
+			<< " Mpairs/s, ConcurrentPoolCache<Particle>: " << cachedRate << " Mpairs/s ("
+			<< cacheStats.mRefillCount << " refills, " << cacheStats.mFlushCount << " flushes)"
+			<< ", mutex + Pool<Particle>: " << lockedRate << " Mpairs/s" << endl;
+	}
+
+	cout << "Passed" << endl;
+}
+
+void RunSparseIterationPerformanceTest()
+{
+	struct Particle
+	{
+		float mPosition[3];
+		float mVelocity[3];
+
+		Particle() : mPosition { 0, 0, 0 }, mVelocity { 1, 1, 1 }
+		{
+		}
+
+		void Integrate(float dt)
+		{
+			for (int i = 0; i < 3; ++i)
+			{
+				mPosition[i] += mVelocity[i] * dt;
+			}
+		}
+	};
+
+	constexpr int iterCount = 20;
+
+	cout << endl << endl;
+	cout << "Running sparse iteration performance test" << endl;
+	cout << "Capacity: " << ObjectCountPerTest << endl;
+
+	for (int occupancy : { 100, 50, 10, 1 })
+	{
+		Pool<Particle> pool(ObjectCountPerTest);
+		vector<PoolHandle<Particle>> handles;
+		handles.reserve(ObjectCountPerTest);
+		for (int i = 0; i < ObjectCountPerTest; ++i)
+		{
+			handles.push_back(pool.Spawn());
+		}
+		// Keep every n-th object alive
+		for (int i = 0; i < ObjectCountPerTest; ++i)
+		{
+			if (i % (100 / occupancy) != 0)
+			{
+				pool.Return(handles[i]);
+			}
+		}
+
+		long long totalTime = 0;
+		for (int k = 0; k < iterCount; ++k)
+		{
+			auto lastTime = chrono::high_resolution_clock::now();
+			pool.ForEach([](Particle &particle) { particle.Integrate(0.016f); });
+			totalTime += chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+				.count();
+		}
+
+		// Handle check per record is what callers had to do before
+		long long handleTime = 0;
+		for (int k = 0; k < iterCount; ++k)
+		{
+			auto lastTime = chrono::high_resolution_clock::now();
+			for (const auto &handle : handles)
+			{
+				if (pool.IsValid(handle))
+				{
+					pool.At(handle).Integrate(0.016f);
+				}
+			}
+			handleTime += chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+				.count();
+		}
+
+		// Same objects packed densely
+		DensePool<Particle> densePool(ObjectCountPerTest);
+		for (int i = 0; i < ObjectCountPerTest; ++i)
+		{
+			handles[i] = densePool.Spawn();
+		}
+		for (int i = 0; i < ObjectCountPerTest; ++i)
+		{
+			if (i % (100 / occupancy) != 0)
+			{
+				densePool.Return(handles[i]);
+			}
+		}
+		densePool.Compact();
+
+		long long denseTime = 0;
+		for (int k = 0; k < iterCount; ++k)
+		{
+			auto lastTime = chrono::high_resolution_clock::now();
+			for (auto &particle : densePool)
+			{
+				particle.Integrate(0.016f);
+			}
+			denseTime += chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+				.count();
+		}
+
+		cout << occupancy << "% live (" << pool.GetSpawnedCount() << " objects): Pool::ForEach: "
+			<< totalTime / iterCount << " microseconds, IsValid + At over every record: "
+			<< handleTime / iterCount << " microseconds, DensePool: "
+			<< denseTime / iterCount << " microseconds" << endl;
+	}
+
+	cout << "Passed" << endl;
+}
+
+// Components of an entity for archetype test
+struct ArchetypeTransform
+{
+	float mPosition[3];
+	float mRotation[4];
+};
+
+struct ArchetypeBody
+{
+	float mVelocity[3];
+	float mMass;
+};
+
+struct ArchetypeProxy
+{
+	int mMesh;
+	int mMaterial;
+	float mBounds[6];
+};
+
+struct HierarchyNode
+{
+	Matrix mLocalTransform;
+	Matrix mGlobalTransform;
+	Vec3 mPosition { 0, 0, 0 };
+	Vec3 mScale { 1, 1, 1 };
+	Quat mRotation { 0, 0, 0, 1 };
+};
+
+// Updates global transforms of tree given as parent of every node in spawn order, 
+// parent always precedes child. Compares recursive PoolableNode update with linear 
+// sweep of HierarchyPool.
+void RunHierarchyScenario(const char *name, const vector<int> &parents)
+{
+	constexpr int iterCount = 20;
+	const Quat rotation { Vec3 { 0, 1, 0 }, 0.1f };
+
+	long long recursiveTime = 0;
+	{
+		Pool<PoolableNode> pool(parents.size());
+		vector<PoolHandle<PoolableNode>> handles;
+		vector<PoolHandle<PoolableNode>> roots;
+		for (size_t i = 0; i < parents.size(); ++i)
+		{
+			handles.push_back(pool.Spawn());
+			if (parents[i] < 0)
+			{
+				roots.push_back(handles.back());
+			}
+			else
+			{
+				pool[handles.back()].AttachTo(handles[parents[i]]);
+			}
+		}
+		PerfCounters counters(CollectPerfCounters);
+		for (int k = 0; k < iterCount; ++k)
+		{
+			for (auto &node : pool)
+			{
+				node.SetRotation(rotation);
+			}
+			counters.Start();
+			const auto lastTime = chrono::high_resolution_clock::now();
+			for (const auto &root : roots)
+			{
+				pool[root].Update();
+			}
+			recursiveTime += chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime).count();
+			counters.Stop();
+		}
+		counters.Print(cout, "PoolableNode");
+	}
+
+	long long sweepTime = 0;
+	{
+		HierarchyPool<HierarchyNode> pool(parents.size());
+		vector<HierarchyPool<HierarchyNode>::Handle> handles;
+		for (size_t i = 0; i < parents.size(); ++i)
+		{
+			handles.push_back(parents[i] < 0 ? pool.Spawn() : pool.SpawnChild(handles[parents[i]]));
+		}
+		PerfCounters counters(CollectPerfCounters);
+		for (int k = 0; k < iterCount; ++k)
+		{
+			for (auto &node : pool)
+			{
+				node.mRotation = rotation;
+			}
+			counters.Start();
+			const auto lastTime = chrono::high_resolution_clock::now();
+			pool.ForEachWithParent([](HierarchyNode &node, HierarchyNode *parent)
+			{
+				node.mLocalTransform.FromRotationScaleTranslation(node.mRotation, node.mScale, node.mPosition);
+				node.mGlobalTransform = parent 
+					? parent->mGlobalTransform * node.mLocalTransform : node.mLocalTransform;
+			});
+			sweepTime += chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime).count();
+			counters.Stop();
+		}
+		counters.Print(cout, "HierarchyPool");
+	}
+
+	cout << name << ": recursive PoolableNode update " << recursiveTime / iterCount 
+		<< " microseconds, HierarchyPool sweep " << sweepTime / iterCount << " microseconds" << endl;
+}
+
+void RunHierarchyPerformanceTest()
+{
+	constexpr int nodeCount = 1 << 17;
+
+	cout << endl << endl;
+	cout << "Running hierarchy performance test" << endl;
+	cout << "Node count: " << nodeCount << endl;
+
+	// Nodes are spawned level by level, so parent and child records are far apart
+	vector<int> parents;
+	constexpr int chainCount = 128;
+	for (int i = 0; i < nodeCount; ++i)
+	{
+		parents.push_back(i < chainCount ? -1 : i - chainCount);
+	}
+	RunHierarchyScenario("Deep (128 chains of 1024 nodes)", parents);
+
+	constexpr int branchCount = 512;
+	parents.assign(1, -1);
+	for (int i = 1; i < nodeCount; ++i)
+	{
+		parents.push_back(i <= branchCount ? 0 : 1 + (i - 1) % branchCount);
+	}
+	RunHierarchyScenario("Wide (512 branches of 255 leaves)", parents);
+
+	cout << "Passed" << endl;
+}
+
+void RunArchetypePerformanceTest()
+{
+	constexpr int entityCount = ObjectCountPerTest / 2;
+	constexpr int iterCount = 20;
+
+	cout << endl << endl;
+	cout << "Running archetype performance test" << endl;
+	cout << "Entities: " << entityCount << endl;
+
+	auto integrate = [](ArchetypeTransform &transform, const ArchetypeBody &body)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			transform.mPosition[j] += body.mVelocity[j] * 0.016f;
+		}
+	};
+
+	{
+		// Entity is three handles, every access checks its own stamp
+		struct Entity
+		{
+			PoolHandle<ArchetypeTransform> mTransform;
+			PoolHandle<ArchetypeBody> mBody;
+			PoolHandle<ArchetypeProxy> mProxy;
+		};
+		Pool<ArchetypeTransform> transforms(entityCount);
+		Pool<ArchetypeBody> bodies(entityCount);
+		Pool<ArchetypeProxy> proxies(entityCount);
+		vector<Entity> entities;
+		entities.reserve(entityCount);
+		auto lastTime = chrono::high_resolution_clock::now();
+		for (int i = 0; i < entityCount; ++i)
+		{
+			entities.push_back(Entity { transforms.Spawn(ArchetypeTransform { { 0, 0, 0 }, { 0, 0, 0, 1 } }), 
+				bodies.Spawn(ArchetypeBody { { 1, 1, 1 }, 1 }), proxies.Spawn(ArchetypeProxy { 0, 0, { } }) });
+		}
+		const auto spawnTime = chrono::duration_cast<chrono::microseconds>(
+			chrono::high_resolution_clock::now() - lastTime).count();
+
+		long long totalTime = 0;
+		for (int k = 0; k < iterCount; ++k)
+		{
+			lastTime = chrono::high_resolution_clock::now();
+			for (const auto &entity : entities)
+			{
+				if (transforms.IsValid(entity.mTransform) && bodies.IsValid(entity.mBody))
+				{
+					integrate(transforms[entity.mTransform], bodies[entity.mBody]);
+				}
+			}
+			totalTime += chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime).count();
+		}
+		cout << "Three Pools, spawn: " << spawnTime << " microseconds, update by handle: " 
+			<< totalTime / iterCount << " microseconds" << endl;
+	}
+
+	{
+		MultiPool<ArchetypeTransform, ArchetypeBody, ArchetypeProxy> pool(entityCount);
+		vector<decltype(pool)::Handle> entities;
+		entities.reserve(entityCount);
+		auto lastTime = chrono::high_resolution_clock::now();
+		for (int i = 0; i < entityCount; ++i)
+		{
+			entities.push_back(pool.Spawn(ArchetypeTransform { { 0, 0, 0 }, { 0, 0, 0, 1 } }, 
+				ArchetypeBody { { 1, 1, 1 }, 1 }, ArchetypeProxy { 0, 0, { } }));
+		}
+		const auto spawnTime = chrono::duration_cast<chrono::microseconds>(
+			chrono::high_resolution_clock::now() - lastTime).count();
+
+		long long totalTime = 0;
+		for (int k = 0; k < iterCount; ++k)
+		{
+			lastTime = chrono::high_resolution_clock::now();
+			for (const auto &entity : entities)
+			{
+				if (pool.IsValid(entity))
+				{
+					integrate(pool.Get<ArchetypeTransform>(entity), pool.Get<ArchetypeBody>(entity));
+				}
+			}
+			totalTime += chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime).count();
+		}
+
+		// Loop over two of three columns
+		long long iterationTime = 0;
+		for (int k = 0; k < iterCount; ++k)
+		{
+			lastTime = chrono::high_resolution_clock::now();
+			pool.ForEach<ArchetypeTransform, ArchetypeBody>(integrate);
+			iterationTime += chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime).count();
+		}
+		cout << "MultiPool, spawn: " << spawnTime << " microseconds, update by handle: " 
+			<< totalTime / iterCount << " microseconds, ForEach<Transform, Body>: " 
+			<< iterationTime / iterCount << " microseconds" << endl;
+	}
+
+	cout << "Passed" << endl;
+}
+
+// Particle for reuse policy test, 32 bytes
+struct ReuseParticle
+{
+	float mPosition[3];
+	float mVelocity[3];
+	float mLifeTime;
+	float mMass;
+
+	ReuseParticle(float lifeTime) 
+		: mPosition { 0, 0, 0 }, mVelocity { 1, 1, 1 }, mLifeTime(lifeTime), mMass(1)
+	{
+	}
+};
+
+// Random churn over a quarter of peak live count, then iteration over survivors
+template<typename Traits>
+void RunReuseScenario(const char *name)
+{
+	constexpr size_t peakCount = 1 << 18;
+	constexpr int iterCount = 50;
+
+	// Deterministic pseudo-random sequence, same for every policy
+	uint64_t state = 12345;
+	auto random = [&state](size_t range)
+	{
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return static_cast<size_t>(state >> 33) % range;
+	};
+
+	Pool<ReuseParticle, Traits> pool(peakCount);
+	vector<PoolHandle<ReuseParticle>> handles;
+	handles.reserve(peakCount);
+	for (size_t i = 0; i < peakCount; ++i)
+	{
+		handles.push_back(pool.Spawn(1.0f));
+	}
+	vector<PoolHandle<ReuseParticle>> live;
+	for (const auto &handle : handles)
+	{
+		if (random(4) == 0)
+		{
+			live.push_back(handle);
+		}
+		else
+		{
+			pool.Return(handle);
+		}
+	}
+
+	auto lastTime = chrono::high_resolution_clock::now();
+	for (int i = 0; i < ObjectCountPerTest; ++i)
+	{
+		auto &handle = live[random(live.size())];
+		pool.Return(handle);
+		handle = pool.Spawn(static_cast<float>(i));
+	}
+	const auto churnTime = chrono::duration_cast<chrono::nanoseconds>(
+		chrono::high_resolution_clock::now() - lastTime).count();
+
+	// Records up to the last live one are what iteration has to walk over
+	size_t span = 0;
+	for (auto it = pool.begin(); it != pool.end(); ++it)
+	{
+		span = it.GetHandle().GetIndex() + 1;
+	}
+
+	PerfCounters counters(CollectPerfCounters);
+	long long iterationTime = 0;
+	for (int k = 0; k < iterCount; ++k)
+	{
+		counters.Start();
+		lastTime = chrono::high_resolution_clock::now();
+		pool.ForEach([](ReuseParticle &particle)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				particle.mPosition[j] += particle.mVelocity[j] * 0.016f;
+			}
+		});
+		iterationTime += chrono::duration_cast<chrono::microseconds>(
+			chrono::high_resolution_clock::now() - lastTime).count();
+		counters.Stop();
+	}
+
+	cout << name << ": churn " << churnTime / ObjectCountPerTest << " ns per return/spawn pair, "
+		<< "iteration " << iterationTime / iterCount << " microseconds, "
+		<< "live " << live.size() << " in span of " << span << " records" << endl;
+	counters.Print(cout, name);
+}
+
+void RunReusePerformanceTest()
+{
+	cout << endl << endl;
+	cout << "Running reuse policy performance test" << endl;
+	cout << "Peak objects: " << (1 << 18) << ", random return/spawn pairs: " << ObjectCountPerTest << endl;
+
+	RunReuseScenario<PoolTraits>("Fifo");
+	RunReuseScenario<LifoTraits>("Lifo");
+	RunReuseScenario<LowestIndexTraits>("LowestIndex");
+
+	cout << "Passed" << endl;
+}
+
+// Frame loop of reader thread: whole frame is read under mutex or inside read section
+template<bool Deferred>
+struct ReadSection
+{
+	template<typename PoolType, typename Read>
+	static void Run(PoolType &, mutex &lock, atomic<bool> &done, Read &read)
+	{
+		while (!done)
+		{
+			lock_guard<mutex> guard(lock);
+			read();
+		}
+	}
+};
+
+template<>
+struct ReadSection<true>
+{
+	template<typename PoolType, typename Read>
+	static void Run(PoolType &pool, mutex &, atomic<bool> &done, Read &read)
+	{
+		auto &epochs = pool.GetEpochs();
+		const auto reader = epochs.RegisterReader();
+		while (!done)
+		{
+			PoolReadGuard guard(epochs, reader);
+			read();
+		}
+		epochs.UnregisterReader(reader);
+	}
+};
+
+// Writer thread churns objects while reader thread reads every published handle
+// per frame, either under a mutex shared with the writer or inside an epoch read section
+template<bool Deferred>
+void RunReadScenario(const char *name)
+{
+	using Traits = typename conditional<Deferred, DeferredTraits, VirtualPoolTraits<1 << 20>>::type;
+	using PoolType = Pool<ReuseParticle, Traits>;
+	constexpr size_t liveCount = 4096;
+
+	PoolType pool(liveCount * 2);
+	vector<atomic<typename PoolType::Handle>> published(liveCount);
+	for (auto &handle : published)
+	{
+		handle = pool.Spawn(1.0f);
+	}
+	mutex lock;
+	atomic<bool> done { false };
+	size_t frameCount = 0;
+	float sum = 0;
+	thread reader([&]
+	{
+		auto read = [&]
+		{
+			for (const auto &handle : published)
+			{
+				sum += pool[handle.load(memory_order_acquire)].mLifeTime;
+			}
+			++frameCount;
+		};
+		ReadSection<Deferred>::Run(pool, lock, done, read);
+	});
+
+	const auto lastTime = chrono::high_resolution_clock::now();
+	for (int i = 0; i < ObjectCountPerTest; ++i)
+	{
+		auto &slot = published[static_cast<size_t>(i) % liveCount];
+		if (Deferred)
+		{
+			const auto old = slot.load(memory_order_relaxed);
+			slot.store(pool.Spawn(static_cast<float>(i)), memory_order_release);
+			pool.Return(old);
+		}
+		else
+		{
+			lock_guard<mutex> guard(lock);
+			const auto old = slot.load(memory_order_relaxed);
+			slot.store(pool.Spawn(static_cast<float>(i)), memory_order_release);
+			pool.Return(old);
+		}
+	}
+	const auto writeTime = chrono::duration_cast<chrono::nanoseconds>(
+		chrono::high_resolution_clock::now() - lastTime).count();
+	done = true;
+	reader.join();
+
+	cout << name << ": writer " << writeTime / ObjectCountPerTest << " ns per return/spawn pair, "
+		<< "reader " << frameCount << " frames of " << liveCount << " objects (checksum " 
+		<< (sum > 0) << ")" << endl;
+}
+
+void RunDeferredReturnPerformanceTest()
+{
+	cout << endl << endl;
+	cout << "Running deferred return performance test" << endl;
+	cout << "Published objects: 4096, return/spawn pairs: " << ObjectCountPerTest << endl;
+
+	RunReadScenario<false>("Mutex");
+	RunReadScenario<true>("Epochs");
+
+	cout << "Passed" << endl;
+}
+
+// Sliding window over map and list: the oldest node is erased, new one is appended,
+// so time goes mostly to allocation of nodes
+template<typename Allocator>
+long long RunContainerChurn(const Allocator &allocator)
+{
+	constexpr int liveCount = 1 << 16;
+	using MapAllocator = typename allocator_traits<Allocator>::template rebind_alloc<pair<const int, int>>;
+	using ListAllocator = typename allocator_traits<Allocator>::template rebind_alloc<int>;
+	map<int, int, less<int>, MapAllocator> window { MapAllocator(allocator) };
+	list<int, ListAllocator> queue { ListAllocator(allocator) };
+	for (int i = 0; i < liveCount; ++i)
+	{
+		window.emplace_hint(window.end(), i, i);
+		queue.push_back(i);
+	}
+	const auto lastTime = chrono::high_resolution_clock::now();
+	for (int i = liveCount; i < liveCount + ObjectCountPerTest; ++i)
+	{
+		window.erase(window.begin());
+		window.emplace_hint(window.end(), i, i);
+		queue.pop_front();
+		queue.push_back(i);
+	}
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - lastTime).count();
+}
+
+void RunContainerAllocatorPerformanceTest()
+{
+	cout << endl << endl;
+	cout << "Running container allocator performance test" << endl;
+	cout << "Live map and list nodes: " << (1 << 16) << ", erase/insert pairs: " << ObjectCountPerTest << endl;
+
+	const auto defaultTime = RunContainerChurn(allocator<int>());
+	PoolMemoryArena<> arena;
+	const auto poolTime = RunContainerChurn(PoolAllocator<int>(arena));
+	cout << "std::allocator: " << defaultTime / ObjectCountPerTest << " ns per step, "
+		<< "PoolAllocator: " << poolTime / ObjectCountPerTest << " ns per step" << endl;
+
+	cout << "Passed" << endl;
+}
+
+void RunSnapshotPerformanceTest()
+{
+	struct Body
+	{
+		float mPosition[3];
+		float mVelocity[3];
+		int mId;
+	};
+
+	const char *path = "pool_snapshot_benchmark.bin";
+
+	cout << endl << endl;
+	cout << "Running snapshot performance test" << endl;
+	cout << "Object count: " << ObjectCountPerTest << endl;
+
+	vector<PoolHandle<Body>> handles;
+	handles.reserve(ObjectCountPerTest);
+	{
+		auto lastTime = chrono::high_resolution_clock::now();
+		Pool<Body> pool(ObjectCountPerTest);
+		for (int i = 0; i < ObjectCountPerTest; ++i)
+		{
+			handles.push_back(pool.Spawn(Body { { 0, 0, 0 }, { 1, 1, 1 }, i }));
+		}
+		cout << "Rebuild with Spawn: "
+			<< chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+			.count()
+			<< " microseconds" << endl;
+		pool.SaveSnapshot(path);
+	}
+	{
+		auto lastTime = chrono::high_resolution_clock::now();
+		Pool<Body> pool(0);
+		pool.MapSnapshot(path);
+		cout << "MapSnapshot: "
+			<< chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+			.count()
+			<< " microseconds" << endl;
+		assert(pool[handles.back()].mId == ObjectCountPerTest - 1);
+	}
+	remove(path);
+
+	cout << "Passed" << endl;
+}
+
+void RunGrowthPerformanceTest()
+{
+	struct Particle
+	{
+		float mPosition[3];
+		float mVelocity[3];
+		float mLifeTime;
+
+		Particle() : mPosition { 0, 0, 0 }, mVelocity { 1, 1, 1 }, mLifeTime(1)
+		{
+		}
+	};
+
+	cout << endl << endl;
+	cout << "Running growth performance test" << endl;
+	cout << "Object count: " << ObjectCountPerTest << ", initial capacity: 1" << endl;
+
+	auto run = [](auto &pool, const char *name)
+	{
+		auto lastTime = chrono::high_resolution_clock::now();
+		for (int i = 0; i < ObjectCountPerTest; ++i)
+		{
+			pool.Spawn();
+		}
+		cout << name << ": "
+			<< chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+			.count()
+			<< " microseconds" << endl;
+	};
+
+	{
+		Pool<Particle> pool(1);
+		run(pool, "Contiguous storage");
+	}
+	{
+		Pool<Particle> pool(1, CountingAlloc, free);
+		run(pool, "Contiguous storage, custom allocator (memcpy instead of realloc)");
+	}
+	{
+		Pool<Particle, HeapAllocatorTraits> pool(1);
+		run(pool, "Contiguous storage, stateless heap allocator");
+	}
+	{
+		Pool<OwnedBuffer> pool(1);
+		run(pool, "Contiguous storage of unique owners, move per object");
+	}
+	{
+		Pool<RelocatableBuffer> pool(1);
+		run(pool, "Contiguous storage of unique owners, trivially relocatable");
+	}
+	{
+		Pool<OwnedBuffer, SplitPoolTraits<>> pool(1);
+		run(pool, "Split storage of unique owners, move per object");
+	}
+	{
+		Pool<RelocatableBuffer, SplitPoolTraits<>> pool(1);
+		run(pool, "Split storage of unique owners, trivially relocatable");
+	}
+	{
+		Pool<Particle, SegmentedPoolTraits<>> pool(1);
+		run(pool, "Segmented storage");
+	}
+	{
+		Pool<Particle, VirtualPoolTraits<ObjectCountPerTest>> pool(1);
+		run(pool, "Virtual storage");
+	}
+	{
+		Pool<Particle, VirtualPoolTraits<ObjectCountPerTest, true>> pool(1);
+		run(pool, "Virtual storage with huge pages");
+	}
+
+	cout << "Passed" << endl;
+}
+
+void RunParallelForEachPerformanceTest()
+{
+	struct Foo
+	{
+		Matrix mA;
+		Matrix mB;
+		Matrix mResult;
+
+		Foo()
+		{
+			mA.FromRotationScaleTranslation({ 0, 0, 0, 1 }, { 1, 1, 1 }, { 1, 0, 0 });
+			mB.FromRotationScaleTranslation({ 1, 0, 0, 1 }, { 1, 1, 1 }, { 1, 1, 0 });
+		}
+	};
+
+	constexpr int iterCount = 20;
+	const int maxThreads = max(1u, thread::hardware_concurrency());
+
+	cout << endl << endl;
+	cout << "Running parallel iteration performance test" << endl;
+	cout << "Object count: " << ObjectCountPerTest << endl;
+
+	Pool<Foo, SplitPoolTraits<64>> pool(ObjectCountPerTest);
+	for (int i = 0; i < ObjectCountPerTest; ++i)
+	{
+		pool.Spawn();
+	}
+	const auto calculate = [](Foo &foo) { foo.mResult = foo.mA * foo.mB; };
+
+	long long totalTime = 0;
+	for (int k = 0; k < iterCount; ++k)
+	{
+		auto lastTime = chrono::high_resolution_clock::now();
+		pool.ForEach(calculate);
+		totalTime += chrono::duration_cast<chrono::microseconds>(
+			chrono::high_resolution_clock::now() - lastTime)
+			.count();
+	}
+	cout << "Pool::ForEach: " << totalTime / iterCount << " microseconds" << endl;
+
+	for (int threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+	{
+		PoolThreadPool threadPool(threadCount - 1);
+		totalTime = 0;
+		for (int k = 0; k < iterCount; ++k)
+		{
+			auto lastTime = chrono::high_resolution_clock::now();
+			pool.ParallelForEach(calculate, 16384, threadPool);
+			totalTime += chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+				.count();
+		}
+		cout << threadCount << " thread(s): Pool::ParallelForEach: " << totalTime / iterCount << " microseconds" << endl;
+	}
+
+	cout << "Passed" << endl;
+}
+
+void RunBatchPerformanceTest()
+{
+	struct Particle
+	{
+		float mPosition[3];
+		float mLifeTime;
+
+		Particle(float lifeTime) : mPosition { 0, 0, 0 }, mLifeTime(lifeTime)
+		{
+		}
+	};
+
+	constexpr int batchSize = 1000;
+	constexpr int frameCount = ObjectCountPerTest / batchSize;
+
+	cout << endl << endl;
+	cout << "Running batched spawn/return performance test" << endl;
+	cout << "Frames: " << frameCount << ", objects spawned and returned per frame: " << batchSize << endl;
+
+	vector<PoolHandle<Particle>> handles(batchSize);
+	{
+		Pool<Particle> pool(batchSize);
+		auto lastTime = chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < frameCount; ++frame)
+		{
+			for (auto &handle : handles)
+			{
+				handle = pool.Spawn(1.0f);
+			}
 			for (const auto &handle : handles)
 			{
-				pool.At(handle).Calculate();
+				pool.Return(handle);
 			}
+		}
+		cout << "Spawn/Return loop: "
+			<< chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+			.count()
+			<< " microseconds" << endl;
+	}
+	{
+		Pool<Particle> pool(batchSize);
+		auto lastTime = chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < frameCount; ++frame)
+		{
+			pool.SpawnN(handles.size(), handles.data(), 1.0f);
+			pool.ReturnN(handles.data(), handles.size());
+		}
+		cout << "SpawnN/ReturnN: "
+			<< chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime)
+			.count()
+			<< " microseconds" << endl;
+	}
+
+	cout << "Passed" << endl;
+}
+
+void RunValidationPerformanceTest()
+{
+	struct Particle
+	{
+		float mPosition[3];
+		float mVelocity[3];
+		float mColor[4];
+		float mLifeTime;
+	};
+
+	constexpr int iterCount = 20;
+
+	cout << endl << endl;
+	cout << "Running batched handle validation performance test" << endl;
+	cout << "Handles: " << ObjectCountPerTest << ", half of them stale" << endl;
+
+	auto run = [](auto &pool, const char *name)
+	{
+		using Handle = typename std::remove_reference<decltype(pool)>::type::Handle;
+		vector<Handle> handles;
+		handles.reserve(ObjectCountPerTest);
+		for (int i = 0; i < ObjectCountPerTest; ++i)
+		{
+			handles.push_back(pool.Spawn());
+		}
+		for (int i = 0; i < ObjectCountPerTest; i += 2)
+		{
+			pool.Return(handles[i]);
+		}
+		unique_ptr<bool[]> valid(new bool[handles.size()]);
 
+		size_t validCount = 0;
+		long long totalTime = 0;
+		for (int k = 0; k < iterCount; ++k)
+		{
+			auto lastTime = chrono::high_resolution_clock::now();
+			validCount += pool.IsValid(handles.data(), handles.size(), valid.get());
 			totalTime += chrono::duration_cast<chrono::microseconds>(
 				chrono::high_resolution_clock::now() - lastTime)
 				.count();
 		}
+		assert(validCount == static_cast<size_t>(iterCount * ObjectCountPerTest / 2));
+		cout << name << ": " << totalTime / iterCount << " microseconds" << endl;
+	};
 
-		for (const auto &handle : handles)
+	{
+		Pool<Particle> pool(ObjectCountPerTest);
+		run(pool, "Records (stamp next to object)");
+	}
+	{
+		Pool<Particle, SplitPoolTraits<>> pool(ObjectCountPerTest);
+		run(pool, "Split (dense stamps)");
+	}
+
+	cout << "Passed" << endl;
+}
+
+void RunResolvePerformanceTest()
+{
+	struct Particle
+	{
+		float mPosition[3];
+		float mVelocity[3];
+		float mColor[4];
+		float mLifeTime;
+	};
+
+	constexpr int iterCount = 20;
+
+	cout << endl << endl;
+	cout << "Running shuffled handle resolution performance test" << endl;
+	cout << "Handles: " << ObjectCountPerTest << " in random order, a quarter of them stale" << endl;
+
+	auto run = [](auto &pool, const char *name)
+	{
+		using Handle = typename std::remove_reference<decltype(pool)>::type::Handle;
+		vector<Handle> handles;
+		handles.reserve(ObjectCountPerTest);
+		for (int i = 0; i < ObjectCountPerTest; ++i)
 		{
-			pool.Return(handle);
+			handles.push_back(pool.Spawn());
 		}
-	}
+		for (int i = 0; i < ObjectCountPerTest; i += 4)
+		{
+			pool.Return(handles[i]);
+		}
+		// Deterministic Fisher-Yates shuffle, same order for every pool
+		uint64_t state = 12345;
+		for (size_t i = handles.size() - 1; i > 0; --i)
+		{
+			state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+			swap(handles[i], handles[static_cast<size_t>(state >> 33) % (i + 1)]);
+		}
+		vector<Particle *> objects(handles.size());
+
+		long long lookupTime = 0;
+		long long resolveTime = 0;
+		long long forEachTime = 0;
+		float sum = 0;
+		for (int k = 0; k < iterCount; ++k)
+		{
+			auto lastTime = chrono::high_resolution_clock::now();
+			for (const auto &handle : handles)
+			{
+				if (pool.IsValid(handle))
+				{
+					pool[handle].mLifeTime += 1.0f;
+				}
+			}
+			lookupTime += chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime).count();
+
+			lastTime = chrono::high_resolution_clock::now();
+			pool.Resolve(handles.data(), handles.size(), objects.data());
+			for (auto object : objects)
+			{
+				if (object)
+				{
+					object->mLifeTime += 1.0f;
+				}
+			}
+			resolveTime += chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime).count();
+
+			lastTime = chrono::high_resolution_clock::now();
+			pool.ForEachHandle(handles.data(), handles.size(), [](Particle &particle)
+			{
+				particle.mLifeTime += 1.0f;
+			});
+			forEachTime += chrono::duration_cast<chrono::microseconds>(
+				chrono::high_resolution_clock::now() - lastTime).count();
+		}
+		for (auto &particle : pool)
+		{
+			sum += particle.mLifeTime;
+		}
+		cout << name << ": IsValid + At " << lookupTime / iterCount << " microseconds, Resolve "
+			<< resolveTime / iterCount << " microseconds, ForEachHandle " << forEachTime / iterCount 
+			<< " microseconds (checksum " << (sum > 0) << ")" << endl;
+	};
 
-	cout << "Pool<Foo>: " << totalTime / iterCount << " microseconds" << endl;
+	{
+		Pool<Particle, NoPrefetchTraits> pool(ObjectCountPerTest);
+		run(pool, "No prefetch");
+	}
+	{
+		Pool<Particle, NearPrefetchTraits> pool(ObjectCountPerTest);
+		run(pool, "Prefetch distance 8");
+	}
+	{
+		Pool<Particle> pool(ObjectCountPerTest);
+		run(pool, "Prefetch distance 32");
+	}
+	{
+		Pool<Particle, SplitPoolTraits<>> pool(ObjectCountPerTest);
+		run(pool, "Split storage, prefetch distance 32");
+	}
 
 	cout << "Passed" << endl;
 }
 
 int main(int argc, char **argv)
 {
+	for (int i = 1; i < argc; ++i)
+	{
+		// Sanity tests only, for quick runs from ctest
+		if (string(argv[i]) == "--sanity")
+		{
+			RunSanityTests();
+			return 0;
+		}
+		if (string(argv[i]) == "--perf")
+		{
+			CollectPerfCounters = true;
+		}
+	}
+
 	RunDataLocalityPerformanceTest();
 	RunSanityTests();
 	RunRandomObjectPerformanceTest();
 	RunHugeAmountOfObjectsPerformanceTest();
-	
-	system("pause");
+	RunChurnPerformanceTest();
+	RunReusePerformanceTest();
+	RunDeferredReturnPerformanceTest();
+	RunHierarchyPerformanceTest();
+	RunContainerAllocatorPerformanceTest();
+	RunArchetypePerformanceTest();
+	RunSparseIterationPerformanceTest();
+	RunConcurrentPerformanceTest();
+	RunValidationPerformanceTest();
+	RunResolvePerformanceTest();
+	RunBatchPerformanceTest();
+	RunParallelForEachPerformanceTest();
+	RunGrowthPerformanceTest();
+	RunSnapshotPerformanceTest();
 	return 0;
 }